@@ -12,6 +12,12 @@
 class mgnMdBitmap;
 class mgnMdTerrainView;
 
+namespace mgn {
+    namespace terrain {
+        class ElevationPyramid;
+    }
+}
+
 class mgnMdTerrainView
 {
 private:
@@ -75,7 +81,9 @@ private:
     int mLod;           //!< Current LOD in Mercator tile system
 
     mgnMdTerrainProvider * mTerrainProvider;
+    const mgn::terrain::ElevationPyramid * mElevationPyramid; //!< queried before terrain provider if set
 
+    double getAltitude(double lat, double lon, float dxm = -1.0f) const;
     bool isViewPathClear(double horz_dist, double tilt, double dxm) const;
     void updateLod();
 
@@ -153,6 +161,8 @@ public:
     float GetMapScaleFactor(int level_of_detail) const;
 
     void setTerrainProvider(mgnMdTerrainProvider * provider);
+    void setElevationPyramid(const mgn::terrain::ElevationPyramid * pyramid);
+    const mgn::terrain::ElevationPyramid * getElevationPyramid() const;
     void setPixelScale(float pixel_scale);
     float getPixelScale() const;
 
@@ -2,6 +2,8 @@
 #ifndef __MGN_TERRAIN_CONSTANTS_H__
 #define __MGN_TERRAIN_CONSTANTS_H__
 
+#include <cstddef>
+
 namespace mgn {
     namespace terrain {
 
@@ -16,6 +18,22 @@ namespace mgn {
     const int GetHeightmapWidth();
     const int GetHeightmapHeight();
 
+    // Default number of Mercator service worker threads, one less than hardware threads within [1, 4]
+    const int GetServiceWorkerCount();
+
+    // Memory budget for Mercator node pool, bytes
+    // It's 1/32 of device physical memory within [32 MB, 256 MB], 64 MB if memory size is unknown.
+    const size_t GetNodePoolMemoryBudget();
+
+    // Default number of Mercator nodes loaded speculatively ahead of camera
+    const int GetPrefetchBudget();
+
+    // Maximum size of persistent Mercator tile store file, bytes
+    const size_t GetTileStoreMaxSize();
+
+    // Default time spent on Mercator tree requests handling per frame, microseconds
+    const int GetRequestTimeBudget();
+
     } // namespace terrain
 } // namespace mgn
 
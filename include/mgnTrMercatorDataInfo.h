@@ -10,6 +10,21 @@
 namespace mgn {
     namespace terrain {
 
+        /*! Cancellation token structure.
+        ** Is set when requested data is no longer needed, provider may poll it
+        ** during long operations and return early.
+        */
+        class CancellationToken {
+        public:
+            CancellationToken() : cancelled_(false) {}
+
+            void Cancel() { cancelled_ = true; }
+            bool IsCancelled() const { return cancelled_; }
+
+        private:
+            volatile bool cancelled_;
+        };
+
         //! Label data structure
         struct LabelData {
             double latitude;
@@ -22,6 +37,8 @@ namespace mgn {
             unsigned int shield_hash;
             std::wstring text;
             std::vector<unsigned char> bitmap_data; // for shield
+            int bitmap_width; //!< size of bitmap data, it's made power of two by labels task
+            int bitmap_height;
         };
 
         //! Icon data structure
@@ -35,6 +52,8 @@ namespace mgn {
             int id; //!< ID of user data object (need for selection)
             mgnMdMapObjectInfo poi_info;
             std::vector<unsigned char> bitmap_data;
+            int bitmap_width; //!< size of bitmap data, it's made power of two by icons task
+            int bitmap_height;
             size_t hash;
             bool is_poi;
             bool centered;
@@ -2,12 +2,14 @@
 #ifndef __MGN_TERRAIN_MERCATOR_PROVIDER_H__
 #define __MGN_TERRAIN_MERCATOR_PROVIDER_H__
 
+#include "mgnTrConstants.h"
 #include "mgnTrMercatorDataInfo.h"
 
 #include "MapDrawing/Graphics/mgnImage.h"
 
 #include "mgnMdWorldPoint.h"
 
+#include <string>
 #include <vector>
 
 class tnCDbTopo;
@@ -16,7 +18,14 @@ class mgnMdIUserDataDrawContext;
 namespace mgn {
     namespace terrain {
 
-        //! Mercator provider class interface
+        /*! Mercator provider class interface.
+        ** Tile data functions (GetTexture, GetHeightmap, GetLabels, GetTextureAndLabels, GetIcons
+        ** and their batch versions) are called from service worker threads. With more than one worker
+        ** they run concurrently with each other, so implementations should be thread safe, or return 1
+        ** from GetServiceWorkerCount to have them called one at a time as with a single service thread.
+        ** Other functions are called from render thread.
+        ** Long calls are advised to poll cancellation_token and return early once it is cancelled.
+        */
         class MercatorProvider {
         public:
             virtual ~MercatorProvider() {}
@@ -24,16 +33,19 @@ namespace mgn {
             struct TextureInfo {
                 int key_x, key_y, key_z; //!< tile coordinates in Mercator projection
                 graphics::Image * image;
+                const CancellationToken * cancellation_token; //!< request may be abandoned if token is cancelled
                 bool errors_occured;
             };
             struct HeightmapInfo {
                 int key_x, key_y, key_z; //!< tile coordinates in Mercator projection
                 graphics::Image * image;
+                const CancellationToken * cancellation_token; //!< request may be abandoned if token is cancelled
                 bool errors_occured;
             };
             struct LabelsInfo {
                 int key_x, key_y, key_z; //!< tile coordinates in Mercator projection
                 std::vector<LabelData> * labels_data;
+                const CancellationToken * cancellation_token; //!< request may be abandoned if token is cancelled
                 bool errors_occured;
             };
             struct TextureLabelsInfo {
@@ -42,11 +54,13 @@ namespace mgn {
                 std::vector<LabelData> * labels_data;
                 bool need_image;
                 bool need_labels;
+                const CancellationToken * cancellation_token; //!< request may be abandoned if token is cancelled
                 bool errors_occured;
             };
             struct IconsInfo {
                 int key_x, key_y, key_z; //!< tile coordinates in Mercator projection
                 std::vector<IconData> * icons_data;
+                const CancellationToken * cancellation_token; //!< request may be abandoned if token is cancelled
                 bool errors_occured;
             };
             /*! Service struct for obtaining maneuver data */
@@ -56,6 +70,16 @@ namespace mgn {
                 float heading;                      //!< [out] heading, radians
             };
 
+            //! Number of service worker threads calling tile data functions, read once by tree on creation
+            virtual int GetServiceWorkerCount() const { return mgn::terrain::GetServiceWorkerCount(); }
+            //! Version of tile data, stored tiles of other versions aren't used
+            virtual unsigned int GetDataVersion() const { return 0U; }
+            //! Path of persistent tile store file, empty path disables the store
+            virtual std::string GetTileStorePath() const { return std::string(); }
+            //! Path of elevation pyramid file (see ElevationPyramidBuilder), empty path disables it
+            // Altitude queries of renderers are served from pyramid, GetAltitude is called where it has no data.
+            virtual std::string GetElevationPyramidPath() const { return std::string(); }
+
             virtual double GetAltitude(double lat, double lng, const tnCDbTopo * topo = 0, float dxm = -1.f) = 0;
 
             virtual void GetTexture(TextureInfo & texture_info) = 0;
@@ -64,6 +88,38 @@ namespace mgn {
             virtual void GetTextureAndLabels(TextureLabelsInfo & tl_info) = 0;
             virtual void GetIcons(IconsInfo & icons_info, const mgnMdIUserDataDrawContext& context) = 0;
 
+            /*! Batch versions of the tile data functions.
+            ** All tiles in a batch have the same LOD (key_z), they are usually neighbours.
+            ** Override them to amortize per call setup cost, default implementations make a call per tile.
+            */
+            virtual void GetTextureBatch(std::vector<TextureInfo> & texture_infos)
+            {
+                for (std::vector<TextureInfo>::iterator it = texture_infos.begin(); it != texture_infos.end(); ++it)
+                    GetTexture(*it);
+            }
+            virtual void GetHeightmapBatch(std::vector<HeightmapInfo> & heightmap_infos)
+            {
+                for (std::vector<HeightmapInfo>::iterator it = heightmap_infos.begin(); it != heightmap_infos.end(); ++it)
+                    GetHeightmap(*it);
+            }
+            virtual void GetLabelsBatch(std::vector<LabelsInfo> & labels_infos)
+            {
+                for (std::vector<LabelsInfo>::iterator it = labels_infos.begin(); it != labels_infos.end(); ++it)
+                    GetLabels(*it);
+            }
+            virtual void GetTextureAndLabelsBatch(std::vector<TextureLabelsInfo> & tl_infos)
+            {
+                for (std::vector<TextureLabelsInfo>::iterator it = tl_infos.begin(); it != tl_infos.end(); ++it)
+                    GetTextureAndLabels(*it);
+            }
+            //! @param contexts is context per tile, has the same size as icons_infos
+            virtual void GetIconsBatch(std::vector<IconsInfo> & icons_infos,
+                const std::vector<const mgnMdIUserDataDrawContext*>& contexts)
+            {
+                for (size_t i = 0; i < icons_infos.size(); ++i)
+                    GetIcons(icons_infos[i], *contexts[i]);
+            }
+
             virtual bool FetchGuidanceArrow(const mgnMdIUserDataDrawContext& context, GuidanceArrow& arrow) = 0;
             virtual bool FetchRouteBegin(std::vector<mgnMdWorldPoint>& route_points) = 0;
             virtual bool FetchRouteEnd(std::vector<mgnMdWorldPoint>& route_points) = 0;
@@ -17,6 +17,8 @@ namespace Mercator
     int GetOptimalLevelOfDetail(double screen_pixel_size_x, int min_lod, int max_lod);
 
     double GetNativeScale(int level_of_detail);
+    //! Ground distance of one pixel at the latitude, meters
+    double GroundResolution(double latitude, int level_of_detail);
 }
 
 #endif
\ No newline at end of file
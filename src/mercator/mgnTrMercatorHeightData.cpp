@@ -0,0 +1,316 @@
+#include "mgnTrMercatorHeightData.h"
+
+#include "../mgnTrElevationPyramid.h"
+
+#include "MapDrawing/Graphics/mgnImage.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+namespace mgn {
+    namespace terrain {
+
+        MercatorHeightData::MercatorHeightData()
+        : width_(0)
+        , height_(0)
+        {
+        }
+        void MercatorHeightData::Build(const graphics::Image& image)
+        {
+            Clear();
+            width_ = image.width();
+            height_ = image.height();
+            heights_.resize(width_ * height_);
+            const unsigned char * pixels = image.pixels();
+            const int bpp = image.bpp();
+            for (int index = 0; index < width_ * height_; ++index)
+                heights_[index] = DecodeHeightmapPixel(pixels + index * bpp);
+
+            if (width_ < 2 || height_ < 2)
+                return;
+
+            // Level 0, each cell spans its four corner samples
+            Level level;
+            level.num_x = width_ - 1;
+            level.num_y = height_ - 1;
+            level.offset = 0;
+            levels_.push_back(level);
+            bounds_.resize(level.num_x * level.num_y);
+            for (int cy = 0; cy < level.num_y; ++cy)
+            {
+                const float * row = &heights_[cy * width_];
+                for (int cx = 0; cx < level.num_x; ++cx)
+                {
+                    const float h00 = row[cx];
+                    const float h10 = row[cx + 1];
+                    const float h01 = row[cx + width_];
+                    const float h11 = row[cx + width_ + 1];
+                    Bounds& bounds = bounds_[cy * level.num_x + cx];
+                    bounds.min = std::min(std::min(h00, h10), std::min(h01, h11));
+                    bounds.max = std::max(std::max(h00, h10), std::max(h01, h11));
+                }
+            }
+
+            // Coarser levels merge 2x2 cells of the previous one
+            while (level.num_x > 1 || level.num_y > 1)
+            {
+                const Level fine = level;
+                level.num_x = (fine.num_x + 1) / 2;
+                level.num_y = (fine.num_y + 1) / 2;
+                level.offset = bounds_.size();
+                levels_.push_back(level);
+                bounds_.resize(level.offset + level.num_x * level.num_y);
+                for (int cy = 0; cy < level.num_y; ++cy)
+                {
+                    for (int cx = 0; cx < level.num_x; ++cx)
+                    {
+                        Bounds& bounds = bounds_[level.offset + cy * level.num_x + cx];
+                        bounds.min = FLT_MAX;
+                        bounds.max = -FLT_MAX;
+                        const int fx1 = std::min(2 * cx + 2, fine.num_x);
+                        const int fy1 = std::min(2 * cy + 2, fine.num_y);
+                        for (int fy = 2 * cy; fy < fy1; ++fy)
+                        {
+                            for (int fx = 2 * cx; fx < fx1; ++fx)
+                            {
+                                const Bounds& child = bounds_[fine.offset + fy * fine.num_x + fx];
+                                bounds.min = std::min(bounds.min, child.min);
+                                bounds.max = std::max(bounds.max, child.max);
+                            }
+                        }
+                    }
+                }
+            }
+        }
+        void MercatorHeightData::Clear()
+        {
+            width_ = 0;
+            height_ = 0;
+            heights_.clear();
+            bounds_.clear();
+            levels_.clear();
+        }
+        void MercatorHeightData::Swap(MercatorHeightData& other)
+        {
+            std::swap(width_, other.width_);
+            std::swap(height_, other.height_);
+            heights_.swap(other.heights_);
+            bounds_.swap(other.bounds_);
+            levels_.swap(other.levels_);
+        }
+        bool MercatorHeightData::IsEmpty() const
+        {
+            return heights_.empty();
+        }
+        int MercatorHeightData::width() const
+        {
+            return width_;
+        }
+        int MercatorHeightData::height() const
+        {
+            return height_;
+        }
+        const float * MercatorHeightData::heights() const
+        {
+            return heights_.empty() ? NULL : &heights_[0];
+        }
+        void MercatorHeightData::GetBounds(int x0, int y0, int x1, int y1, float& min_height, float& max_height) const
+        {
+            if (levels_.empty())
+            {
+                min_height = max_height = heights_.empty() ? 0.0f : heights_[0];
+                return;
+            }
+            min_height = FLT_MAX;
+            max_height = -FLT_MAX;
+            CollectBounds(static_cast<int>(levels_.size()) - 1, 0, 0, x0, y0, x1, y1, min_height, max_height);
+            if (min_height > max_height) // region is out of tile
+                min_height = max_height = 0.0f;
+        }
+        bool MercatorHeightData::IntersectSegment(const math::Vector3& begin, const math::Vector3& end, float& t) const
+        {
+            if (levels_.empty())
+                return false;
+            const math::Vector3 delta = end - begin;
+            const int top = static_cast<int>(levels_.size()) - 1;
+            float t0 = 0.0f;
+            float t1 = 1.0f;
+            if (!ClipToCell(top, 0, 0, begin, delta, t0, t1))
+                return false;
+            return IntersectCell(top, 0, 0, begin, delta, t0, t1, t);
+        }
+        const MercatorHeightData::Bounds& MercatorHeightData::GetCell(int level, int cx, int cy) const
+        {
+            const Level& info = levels_[level];
+            return bounds_[info.offset + cy * info.num_x + cx];
+        }
+        void MercatorHeightData::CollectBounds(int level, int cx, int cy, int x0, int y0, int x1, int y1,
+            float& min_height, float& max_height) const
+        {
+            const int sx0 = cx << level;
+            const int sy0 = cy << level;
+            const int sx1 = std::min((cx + 1) << level, width_ - 1);
+            const int sy1 = std::min((cy + 1) << level, height_ - 1);
+            if (sx1 <= x0 || sx0 >= x1 || sy1 <= y0 || sy0 >= y1)
+                return;
+
+            const Bounds& bounds = GetCell(level, cx, cy);
+            // Cells partially covered by region aren't split further than level 0
+            if (level == 0 || (x0 <= sx0 && sx1 <= x1 && y0 <= sy0 && sy1 <= y1))
+            {
+                min_height = std::min(min_height, bounds.min);
+                max_height = std::max(max_height, bounds.max);
+                return;
+            }
+            // Nothing inside the cell can extend bounds collected so far
+            if (min_height <= bounds.min && bounds.max <= max_height)
+                return;
+
+            const Level& fine = levels_[level - 1];
+            const int fx1 = std::min(2 * cx + 2, fine.num_x);
+            const int fy1 = std::min(2 * cy + 2, fine.num_y);
+            for (int fy = 2 * cy; fy < fy1; ++fy)
+                for (int fx = 2 * cx; fx < fx1; ++fx)
+                    CollectBounds(level - 1, fx, fy, x0, y0, x1, y1, min_height, max_height);
+        }
+        bool MercatorHeightData::IntersectCell(int level, int cx, int cy, const math::Vector3& begin,
+            const math::Vector3& delta, float t0, float t1, float& t) const
+        {
+            const Bounds& bounds = GetCell(level, cx, cy);
+            const float z0 = begin.z + delta.z * t0;
+            const float z1 = begin.z + delta.z * t1;
+            // Segment passes above the whole cell
+            if (std::min(z0, z1) > bounds.max)
+                return false;
+            // Segment enters the cell below its lowest sample
+            if (z0 <= bounds.min)
+            {
+                t = t0;
+                return true;
+            }
+            if (level == 0)
+                return IntersectSamples(cx, cy, begin, delta, t0, t1, t);
+
+            // Children are visited in order of entering, so the first hit is the nearest one
+            int children_x[4];
+            int children_y[4];
+            float children_t0[4];
+            float children_t1[4];
+            int num_children = 0;
+            const Level& fine = levels_[level - 1];
+            const int fx1 = std::min(2 * cx + 2, fine.num_x);
+            const int fy1 = std::min(2 * cy + 2, fine.num_y);
+            for (int fy = 2 * cy; fy < fy1; ++fy)
+            {
+                for (int fx = 2 * cx; fx < fx1; ++fx)
+                {
+                    float ct0 = t0;
+                    float ct1 = t1;
+                    if (!ClipToCell(level - 1, fx, fy, begin, delta, ct0, ct1))
+                        continue;
+                    int i = num_children++;
+                    for (; i > 0 && children_t0[i - 1] > ct0; --i)
+                    {
+                        children_x[i] = children_x[i - 1];
+                        children_y[i] = children_y[i - 1];
+                        children_t0[i] = children_t0[i - 1];
+                        children_t1[i] = children_t1[i - 1];
+                    }
+                    children_x[i] = fx;
+                    children_y[i] = fy;
+                    children_t0[i] = ct0;
+                    children_t1[i] = ct1;
+                }
+            }
+            for (int i = 0; i < num_children; ++i)
+            {
+                if (IntersectCell(level - 1, children_x[i], children_y[i], begin, delta,
+                    children_t0[i], children_t1[i], t))
+                    return true;
+            }
+            return false;
+        }
+        bool MercatorHeightData::IntersectSamples(int cx, int cy, const math::Vector3& begin,
+            const math::Vector3& delta, float t0, float t1, float& t) const
+        {
+            // Bilinear surface H(u,v) = a + b*u + c*v + d*u*v along the segment is quadratic in t
+            const float * row = &heights_[cy * width_ + cx];
+            const float a = row[0];
+            const float b = row[1] - row[0];
+            const float c = row[width_] - row[0];
+            const float d = row[0] - row[1] - row[width_] + row[width_ + 1];
+            const float u0 = begin.x - static_cast<float>(cx);
+            const float v0 = begin.y - static_cast<float>(cy);
+            const float du = delta.x;
+            const float dv = delta.y;
+
+            // f(t) = z(t) - H(t) = A + B*t + C*t^2, looking for the first t where f(t) <= 0
+            const float A = begin.z - (a + b * u0 + c * v0 + d * u0 * v0);
+            const float B = delta.z - (b * du + c * dv + d * (u0 * dv + v0 * du));
+            const float C = -(d * du * dv);
+
+            if (A + (B + C * t0) * t0 <= 0.0f)
+            {
+                t = t0;
+                return true;
+            }
+            float roots[2];
+            int num_roots = 0;
+            if (fabs(C) < 1e-9f)
+            {
+                if (B != 0.0f)
+                    roots[num_roots++] = -A / B;
+            }
+            else
+            {
+                const float discriminant = B * B - 4.0f * A * C;
+                if (discriminant < 0.0f)
+                    return false;
+                const float sqrt_discriminant = sqrtf(discriminant);
+                roots[num_roots++] = (-B - sqrt_discriminant) / (2.0f * C);
+                roots[num_roots++] = (-B + sqrt_discriminant) / (2.0f * C);
+                if (roots[0] > roots[1])
+                    std::swap(roots[0], roots[1]);
+            }
+            for (int i = 0; i < num_roots; ++i)
+            {
+                if (roots[i] >= t0 && roots[i] <= t1)
+                {
+                    t = roots[i];
+                    return true;
+                }
+            }
+            return false;
+        }
+        bool MercatorHeightData::ClipToCell(int level, int cx, int cy, const math::Vector3& begin,
+            const math::Vector3& delta, float& t0, float& t1) const
+        {
+            const float min_x = static_cast<float>(cx << level);
+            const float min_y = static_cast<float>(cy << level);
+            const float max_x = static_cast<float>(std::min((cx + 1) << level, width_ - 1));
+            const float max_y = static_cast<float>(std::min((cy + 1) << level, height_ - 1));
+            const float begins[2] = { begin.x, begin.y };
+            const float deltas[2] = { delta.x, delta.y };
+            const float mins[2] = { min_x, min_y };
+            const float maxs[2] = { max_x, max_y };
+            for (int axis = 0; axis < 2; ++axis)
+            {
+                if (deltas[axis] == 0.0f)
+                {
+                    if (begins[axis] < mins[axis] || begins[axis] > maxs[axis])
+                        return false;
+                    continue;
+                }
+                float ta = (mins[axis] - begins[axis]) / deltas[axis];
+                float tb = (maxs[axis] - begins[axis]) / deltas[axis];
+                if (ta > tb)
+                    std::swap(ta, tb);
+                t0 = std::max(t0, ta);
+                t1 = std::min(t1, tb);
+            }
+            return t0 <= t1;
+        }
+
+    } // namespace terrain
+} // namespace mgn
@@ -0,0 +1,77 @@
+#pragma once
+#ifndef __MGN_TERRAIN_MERCATOR_HEIGHT_DATA_H__
+#define __MGN_TERRAIN_MERCATOR_HEIGHT_DATA_H__
+
+#include "MapDrawing/Graphics/mgnVector.h"
+
+#include <cstddef>
+#include <vector>
+
+namespace mgn {
+    namespace graphics {
+        class Image;
+    }
+
+    namespace terrain {
+
+        /*! Mercator height data class.
+        ** Holds heightmap decoded to meters and min/max pyramid over its cells.
+        ** Level 0 cell spans 2x2 neighbour samples, every next level merges 2x2 cells of previous one,
+        ** the last level is a single cell covering the whole tile.
+        ** Data is built by heightmap task on worker thread and then swapped into map tile.
+        */
+        class MercatorHeightData {
+        public:
+            MercatorHeightData();
+
+            //! Decodes heightmap image and builds min/max pyramid
+            void Build(const graphics::Image& image);
+            void Clear();
+            void Swap(MercatorHeightData& other);
+
+            bool IsEmpty() const;
+            int width() const;
+            int height() const;
+            const float * heights() const; //!< row major samples in meters, NULL if empty
+
+            //! Gets height bounds of samples region, bounds are exact if region is aligned to cells of some level
+            // @param x0,y0,x1,y1 Inclusive sample coordinates, x0 < x1 and y0 < y1.
+            void GetBounds(int x0, int y0, int x1, int y1, float& min_height, float& max_height) const;
+
+            //! Finds first intersection of segment with bilinear surface
+            // Segment points are (x, y) in samples and z in meters.
+            // @param t Segment parameter of intersection in range [0,1].
+            bool IntersectSegment(const math::Vector3& begin, const math::Vector3& end, float& t) const;
+
+        private:
+            struct Bounds {
+                float min;
+                float max;
+            };
+            struct Level {
+                int num_x;
+                int num_y;
+                size_t offset; //!< offset of level cells in bounds array
+            };
+
+            const Bounds& GetCell(int level, int cx, int cy) const;
+            void CollectBounds(int level, int cx, int cy, int x0, int y0, int x1, int y1,
+                float& min_height, float& max_height) const;
+            bool IntersectCell(int level, int cx, int cy, const math::Vector3& begin, const math::Vector3& delta,
+                float t0, float t1, float& t) const;
+            bool IntersectSamples(int cx, int cy, const math::Vector3& begin, const math::Vector3& delta,
+                float t0, float t1, float& t) const;
+            bool ClipToCell(int level, int cx, int cy, const math::Vector3& begin, const math::Vector3& delta,
+                float& t0, float& t1) const;
+
+            int width_;
+            int height_;
+            std::vector<float> heights_;
+            std::vector<Bounds> bounds_;
+            std::vector<Level> levels_;
+        };
+
+    } // namespace terrain
+} // namespace mgn
+
+#endif
@@ -13,14 +13,12 @@ namespace mgn {
 		: node_(NULL)
 		, albedo_texture_(NULL)
         , heightmap_texture_(NULL)
-        , height_data_(NULL)
 		{
 		}
         MercatorMapTile::MercatorMapTile(MercatorNode * node)
         : node_(node)
         , albedo_texture_(NULL)
         , heightmap_texture_(NULL)
-        , height_data_(NULL)
         {
         }
 		MercatorMapTile::~MercatorMapTile()
@@ -44,17 +42,13 @@ namespace mgn {
                 renderer->DeleteTexture(heightmap_texture_);
                 heightmap_texture_ = NULL;
             }
-            if (height_data_)
-            {
-                delete[] height_data_;
-                height_data_ = NULL;
-            }
+            height_data_.Clear();
 		}
 		MercatorNode * MercatorMapTile::GetNode()
 		{
 			return node_;
 		}
-        const float * MercatorMapTile::GetHeightData() const
+        const MercatorHeightData& MercatorMapTile::GetHeightData() const
         {
             return height_data_;
         }
@@ -90,7 +84,7 @@ namespace mgn {
 				renderer->AddTextureFromImage(albedo_texture_, image, graphics::Texture::Wrap::kClampToEdge);
 			}
 		}
-        void MercatorMapTile::SetHeightmapImage(const graphics::Image& image)
+        void MercatorMapTile::SetHeightmapImage(const graphics::Image& image, MercatorHeightData& height_data)
         {
             if (heightmap_texture_)
                 heightmap_texture_->SetData(0, 0, image.width(), image.height(), image.pixels());
@@ -100,31 +94,7 @@ namespace mgn {
                 renderer->AddTextureFromImage(heightmap_texture_, image,
                     graphics::Texture::Wrap::kClampToEdge, graphics::Texture::Filter::kLinear, false);
             }
-            FillHeightData(image);
-        }
-        void MercatorMapTile::FillHeightData(const graphics::Image& image)
-        {
-            const float kHeightMin = mgn::terrain::GetHeightMin();
-            const float kHeightRange = mgn::terrain::GetHeightRange();
-
-            if (height_data_)
-                delete[] height_data_;
-            height_data_ = new float[image.width() * image.height()];
-
-            for (int j = 0; j < image.height(); ++j)
-            {
-                for (int i = 0; i < image.width(); ++i)
-                {
-                    // Unpack float value from two bytes
-                    int index = j * image.width() + i;
-                    const unsigned char * data = image.pixels() + (index * image.bpp());
-                    unsigned int x = static_cast<unsigned int>(data[0]);
-                    unsigned int y = static_cast<unsigned int>(data[1]);
-                    float norm_height = static_cast<float>(255 * x + y) / 65535.0f;
-                    float height = kHeightMin + kHeightRange * norm_height;
-                    height_data_[index] = height;
-                }
-            }
+            height_data_.Swap(height_data);
         }
 
     } // namespace terrain
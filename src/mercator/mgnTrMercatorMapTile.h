@@ -2,6 +2,8 @@
 #ifndef __MGN_TERRAIN_MERCATOR_MAP_TILE_H__
 #define __MGN_TERRAIN_MERCATOR_MAP_TILE_H__
 
+#include "mgnTrMercatorHeightData.h"
+
 namespace mgn {
 	namespace graphics {
 		class Texture;
@@ -26,22 +28,21 @@ namespace mgn {
 			void Destroy();
 
 			MercatorNode * GetNode();
-            const float * GetHeightData() const;
+            const MercatorHeightData& GetHeightData() const;
 			void BindTexture();
 
             bool HasAlbedoTexture() const;
             bool HasHeightmapTexture() const;
 
 			void SetAlbedoImage(const graphics::Image& image);
-            void SetHeightmapImage(const graphics::Image& image);
+            //! Sets heightmap texture, height data is taken from the task that has decoded it
+            void SetHeightmapImage(const graphics::Image& image, MercatorHeightData& height_data);
 
 		private:
-            void FillHeightData(const graphics::Image& image);
-
 			MercatorNode * node_; //!< pointer to owner node
 			graphics::Texture * albedo_texture_;
             graphics::Texture * heightmap_texture_;
-            float * height_data_;
+            MercatorHeightData height_data_;
 		};
 
     } // namespace terrain
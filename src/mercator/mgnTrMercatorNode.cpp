@@ -8,82 +8,25 @@
 #include "mgnTrMercatorService.h"
 
 #include "../mgnTrAtlasLabel.h"
+#include "../mgnTrFontAtlas.h"
 #include "../mgnTrLabel.h"
+#include "../mgnTrLabelGeometry.h"
 #include "../mgnTrIcon.h"
 
 #include "MapDrawing/Graphics/mgnCommonMath.h"
 
 #include <cstddef>
+#include <map>
 #include <assert.h>
 
-static int InterpolateColor(int c1, int c2, float alpha)
-{
-    int a1 = (c1 & 0xff000000) >> 24;
-    int b1 = (c1 & 0xff0000) >> 16;
-    int g1 = (c1 & 0x00ff00) >> 8;
-    int r1 = (c1 & 0x0000ff);
-    int a2 = (c2 & 0xff000000) >> 24;
-    int b2 = (c2 & 0xff0000) >> 16;
-    int g2 = (c2 & 0x00ff00) >> 8;
-    int r2 = (c2 & 0x0000ff);
-    int r = r1 + (int)((r2-r1)*alpha);
-    int g = g1 + (int)((g2-g1)*alpha);
-    int b = b1 + (int)((b2-b1)*alpha);
-    int a = a1 + (int)((a2-a1)*alpha);
-    return (a << 24) | (b << 16) | (g << 8) | r;
-}
-static bool MakePotTextureFromNpot(int width, int height, const std::vector<unsigned char>& vdata,
-    int& out_width, int& out_height, std::vector<unsigned char>& out_data)
-{
-    if (((width & (width-1)) != 0) || ((height & (height-1)) != 0))
-    {
-        // Need to make POT
-        const unsigned int * data = reinterpret_cast<const unsigned int*>(&vdata[0]);
-        int w2 = math::RoundToPowerOfTwo(width);
-        int h2 = math::RoundToPowerOfTwo(height);
-        out_width = w2;
-        out_height = h2;
-
-        // Rescale image to power of 2
-        int new_size = w2 * h2;
-        out_data.resize(new_size*4);
-        unsigned int * new_data = reinterpret_cast<unsigned int*>(&out_data[0]);
-        for (int dh2 = 0; dh2 < h2; ++dh2)
-        {
-            float rh = (float)dh2 / (float)h2;
-            float y = rh * (float)height;
-            int dh = (int)y;
-            int dh1 = std::min<int>(dh+1, height-1);
-            float ry = y - (float)dh; // fract part of y
-            for (int dw2 = 0; dw2 < w2; ++dw2)
-            {
-                float rw = (float)dw2 / (float)w2;
-                float x = rw * (float)width;
-                int dw = (int)x;
-                int dw1 = std::min<int>(dw+1, width-1);
-                float rx = x - (float)dw; // fract part of x
-
-                // We will use bilinear interpolation
-                int sample1 = (int) data[dw +width*dh ];
-                int sample2 = (int) data[dw1+width*dh ];
-                int sample3 = (int) data[dw +width*dh1];
-                int sample4 = (int) data[dw1+width*dh1];
-
-                int color1 = InterpolateColor(sample1, sample2, rx);
-                int color2 = InterpolateColor(sample3, sample4, rx);;
-                int color3 = InterpolateColor(color1, color2, ry);
-                new_data[dw2+w2*dh2] = (unsigned int)color3;
-            }
-        }
-        return true;
-    }
-    else // already a pot texture
-        return false;
-}
-
 namespace mgn {
     namespace terrain {
 
+        namespace {
+            //! Own textures of bitmaps which haven't fit into atlas, by bitmap hash
+            typedef std::map<TextureAtlas::Key, graphics::Texture*> FallbackTextureMap;
+        }
+
         MercatorNode::MercatorNode(MercatorTree * tree)
         : owner_(tree)
         , map_tile_(this)
@@ -91,14 +34,22 @@ namespace mgn {
         , lod_(0)
         , x_(0)
         , y_(0)
+        , generation_(0U)
         , parent_slot_(-1)
         , parent_(NULL)
+        , lru_prev_(NULL)
+        , lru_next_(NULL)
+        , pool_hash_next_(NULL)
+        , open_prev_(NULL)
+        , open_next_(NULL)
         , has_children_(false)
+        , is_open_(false)
         , page_out_(false)
         , has_map_tile_(false)
         , has_renderable_(false)
         , request_page_out_(false)
         , request_map_tile_(false)
+        , wait_map_tile_(false)
         , request_renderable_(false)
         , request_split_(false)
         , request_merge_(false)
@@ -108,14 +59,23 @@ namespace mgn {
         , request_icons_(false)
         , has_labels_(false)
         , has_icons_(false)
+        , in_icon_list_(false)
+        , icon_list_stamp_(0U)
+        , prefetch_(false)
         {
             last_opened_ = last_rendered_ = owner_->GetFrameCounter();
             for (int i = 0; i < 4; ++i)
                 children_[i] = NULL;
+            for (int i = 0; i < kNumMercatorRequestTypes; ++i)
+            {
+                requests_[i].node = this;
+                requests_[i].type = i;
+            }
         }
         MercatorNode::~MercatorNode()
         {
             owner_->Unrequest(this);
+            owner_->UnlinkOpenNode(this);
             if (parent_)
                 parent_->children_[parent_slot_] = NULL;
             DestroyMapTile();
@@ -136,6 +96,14 @@ namespace mgn {
         {
             return y_;
         }
+        unsigned int MercatorNode::generation() const
+        {
+            return generation_;
+        }
+        bool MercatorNode::IsPrefetch() const
+        {
+            return prefetch_;
+        }
         const float MercatorNode::GetPriority() const
         {
             if (!has_renderable_)
@@ -150,6 +118,10 @@ namespace mgn {
         {
             return owner_->terrain_view_;
         }
+        const Font * MercatorNode::font() const
+        {
+            return owner_->font_;
+        }
         bool MercatorNode::IsSplit()
         {
             return children_[0] || children_[1] || children_[2] || children_[3];
@@ -200,6 +172,9 @@ namespace mgn {
             {
                 if (use_pool)
                 {
+                    // Pooled node is no longer bound to this parent
+                    child->parent_ = NULL;
+                    child->parent_slot_ = -1;
                     MercatorNode * dropped_node = owner_->node_pool_->Push(child);
                     if (dropped_node != NULL) // pool is full
                     {
@@ -289,7 +264,8 @@ namespace mgn {
             // Being asked to render ourselves.
             if (!has_renderable_)
             {
-                last_opened_ = last_rendered_ = owner_->GetFrameCounter();
+                MarkOpened();
+                last_rendered_ = owner_->GetFrameCounter();
 
                 if (page_out_ && has_children_)
                     return true;
@@ -303,14 +279,19 @@ namespace mgn {
             }
             return true;
         }
-        int MercatorNode::Render()
+        int MercatorNode::Render(math::CullInfo cull_info)
         {
             // In case of collection grid rendering is much easier
             if (owner_->IsCollection())
             {
                 if (has_renderable_)
                 {
-                    // TODO: add frustum clipping
+                    renderable_.UpdateVisibility(cull_info);
+                    if (renderable_.IsClipped())
+                    {
+                        ++owner_->render_stats_.num_culled;
+                        return 0;
+                    }
                     if (!has_map_tile_ && !request_map_tile_)
                     {
                         // Request a native res map tile.
@@ -337,10 +318,10 @@ namespace mgn {
             if (page_out_)
             {
                 // Recurse down, calculating min recursion level of all children.
-                int min_level = children_[0]->Render();
+                int min_level = children_[0]->Render(cull_info);
                 for (int i = 1; i < 4; ++i)
                 {
-                    int level = children_[i]->Render();
+                    int level = children_[i]->Render(cull_info);
                     if (level < min_level)
                         min_level = level;
                 }
@@ -357,10 +338,14 @@ namespace mgn {
             if (has_renderable_)
             {
                 renderable_.SetFrameOfReference();
+                renderable_.UpdateVisibility(cull_info);
 
                 // If invisible, return immediately.
                 if (renderable_.IsClipped())
+                {
+                    ++owner_->render_stats_.num_culled;
                     return 1;
+                }
 
                 // Whether to recurse down.
                 bool recurse = false;
@@ -430,7 +415,7 @@ namespace mgn {
                 if (recurse)
                 {
                     // Update recursion counter, used to find least recently used nodes to page out.
-                    last_opened_ = owner_->GetFrameCounter();
+                    MarkOpened();
 
                     // And children are available and renderable...
                     if (has_children_)
@@ -438,10 +423,10 @@ namespace mgn {
                         if (will_render_children)
                         {
                             // Recurse down, calculating min recursion level of all children.
-                            int min_level = children_[0]->Render();
+                            int min_level = children_[0]->Render(cull_info);
                             for (int i = 1; i < 4; ++i)
                             {
-                                int level = children_[i]->Render();
+                                int level = children_[i]->Render(cull_info);
                                 if (level < min_level)
                                     min_level = level;
                             }
@@ -482,6 +467,7 @@ namespace mgn {
 
                 owner_->rendered_nodes_.push_back(this);
             }
+            ++owner_->render_stats_.num_drawn;
 
             graphics::Shader * shader = owner_->shader_;
 
@@ -497,45 +483,35 @@ namespace mgn {
         }
         void MercatorNode::RenderLabels()
         {
-            MercatorTree::UsedLabelsSet & used_labels = owner_->used_labels_;
-            std::vector<math::Rect> & bboxes = owner_->label_bounding_boxes_;
+            LabelIdSet & used_labels = owner_->used_labels_;
+            ScreenGrid & label_grid = owner_->label_grid_;
 
             for (std::vector<Label*>::iterator it = label_meshes_.begin();
                 it != label_meshes_.end(); ++it)
             {
                 Label * label = *it;
-                if(used_labels.find(label->text()) == used_labels.end())
-                {
+                if (used_labels.Insert(label->text_id()))
                     label->render();
-                    used_labels.insert(label->text());
-                }
             }
 
+            if (atlas_label_meshes_.empty())
+                return;
             const math::Matrix4& view = owner_->renderer_->view_matrix();
+            owner_->font_->SetupShader(owner_->billboard_shader_);
             for (std::vector<AtlasLabel*>::iterator it = atlas_label_meshes_.begin();
                 it != atlas_label_meshes_.end(); ++it)
             {
                 AtlasLabel * label = *it;
                 math::Rect bbox;
                 label->GetBoundingBox(view, bbox);
-                bool intersection_found = false;
-                for (std::vector<math::Rect>::const_iterator itb = bboxes.begin();
-                    itb != bboxes.end(); ++itb)
-                {
-                    const math::Rect& checked_bbox = *itb;
-                    if (math::RectRectIntersection2D(bbox, checked_bbox))
-                    {
-                        intersection_found = true;
-                        break;
-                    }
-                }
-                if(!intersection_found && used_labels.find(label->text()) == used_labels.end())
+                if (!used_labels.Contains(label->text_id()) && !label_grid.Intersects(bbox))
                 {
                     label->render();
-                    used_labels.insert(label->text());
-                    bboxes.push_back(bbox);
+                    used_labels.Insert(label->text_id());
+                    label_grid.Insert(bbox, static_cast<int>(label_grid.size()));
                 }
             }
+            Font::ResetShader(owner_->billboard_shader_);
         }
         void MercatorNode::OnTextureTaskCompleted(const graphics::Image& image, bool has_errors)
         {
@@ -554,140 +530,127 @@ namespace mgn {
 
             if (has_errors) // repeat request
                 owner_->RequestTexture(this);
+
+            OnMapTileDataArrived();
         }
-        void MercatorNode::OnHeightmapTaskCompleted(const graphics::Image& image, bool has_errors)
+        void MercatorNode::OnHeightmapTaskCompleted(const graphics::Image& image,
+            MercatorHeightData& height_data, bool has_errors)
         {
             request_heightmap_ = false;
-            map_tile_.SetHeightmapImage(image);
+            map_tile_.SetHeightmapImage(image, height_data);
 
             if (has_errors)
                 owner_->RequestHeightmap(this);
 
+            OnMapTileDataArrived();
+
             LoadData();
         }
-        void MercatorNode::OnLabelsTaskCompleted(const std::vector<LabelData>& labels_data, bool has_errors)
+        void MercatorNode::OnLabelsTaskCompleted(const std::vector<LabelData>& labels_data,
+            const std::vector<LabelGeometry>& geometries, bool has_errors)
         {
-            // Build label meshes
-            for (std::vector<LabelData>::const_iterator it = labels_data.begin();
-                it != labels_data.end(); ++it)
+            // Geometry and shield bitmaps are prepared by labels task, only upload is left here
+            assert(labels_data.size() == geometries.size());
+            FallbackTextureMap fallback_textures;
+            for (size_t i = 0; i < labels_data.size(); ++i)
             {
                 // Recognize type of billboard (label or shield)
-                const LabelData& data = *it;
+                const LabelData& data = labels_data[i];
                 if (data.centered) // shield
                 {
-                    graphics::Texture * texture;
-                    MercatorTree::ShieldTextureCache::iterator it_shield =
-                        owner_->shield_texture_cache_.find(data.shield_hash);
-                    if (it_shield == owner_->shield_texture_cache_.end())
+                    TextureAtlas * atlas = owner_->shield_atlas_;
+                    TextureRegion region;
+                    graphics::Texture * texture = NULL;
+                    bool owns_texture = true;
+                    FallbackTextureMap::const_iterator fallback = fallback_textures.find(data.shield_hash);
+                    if (fallback != fallback_textures.end())
                     {
-                        int new_width, new_height;
-                        std::vector<unsigned char> new_data;
-                        // This shield doesn't exist in texture cache, make a new texture from bitmap
-                        if (MakePotTextureFromNpot(data.width, data.height, data.bitmap_data,
-                                                   new_width, new_height, new_data))
-                        {
-                            // Texture data has been converted to power of two
-                            owner_->renderer_->CreateTextureFromData(texture, new_width, new_height,
-                                graphics::Image::Format::kRGBA8, graphics::Texture::Filter::kTrilinear,
-                                &new_data[0]);
-                        }
-                        else
+                        // Shields of tile are deleted together, so the first one owns shared texture
+                        texture = fallback->second;
+                        owns_texture = false;
+                    }
+                    else if (!atlas->Acquire(data.shield_hash, region))
+                    {
+                        // Bitmap is dropped by task if some previous shield of this tile has the same hash
+                        if (data.bitmap_data.empty())
+                            continue;
+                        if (!atlas->Insert(data.shield_hash, data.bitmap_width, data.bitmap_height,
+                            &data.bitmap_data[0], region))
                         {
-                            // Texture already has power of two sizes
-                            owner_->renderer_->CreateTextureFromData(texture, data.width, data.height,
-                                graphics::Image::Format::kRGBA8, graphics::Texture::Filter::kTrilinear,
+                            // Atlas is full of used shields, this one gets its own texture
+                            owner_->renderer_->CreateTextureFromData(texture, data.bitmap_width, data.bitmap_height,
+                                graphics::Image::Format::kRGBA8, graphics::Texture::Filter::kLinear,
                                 &data.bitmap_data[0]);
+                            region = TextureRegion();
+                            fallback_textures[data.shield_hash] = texture;
                         }
-                        // Also insert texture into cache
-                        owner_->shield_texture_cache_.insert(std::make_pair(data.shield_hash, texture));
-                    }
-                    else
-                    {
-                        // This shield exists in texture cache, so obtain it texture from cache
-                        texture = it_shield->second;
                     }
 
                     Label *label = new Label(owner_->renderer_, owner_->terrain_view_,
-                        owner_->billboard_shader_, data, lod_);
-                    label->setTexture(texture, false); // shield texture cache owns the texture
+                        owner_->billboard_shader_, data, geometries[i], region);
+                    if (texture)
+                        label->setTexture(texture, owns_texture);
+                    else
+                        label->setTexture(atlas, data.shield_hash, region);
                     label_meshes_.push_back(label);
                 }
                 else // atlas-based label
                 {
                     AtlasLabel *label = new AtlasLabel(owner_->renderer_, owner_->terrain_view_,
-                        owner_->billboard_shader_, owner_->font_, data, lod_);
+                        owner_->billboard_shader_, owner_->font_, data, geometries[i]);
                     atlas_label_meshes_.push_back(label);
                 }
             }
             has_labels_ = true;
         }
         void MercatorNode::OnTextureLabelsTaskCompleted(const graphics::Image& image,
-            const std::vector<LabelData>& labels_data, bool has_errors)
+            const std::vector<LabelData>& labels_data, const std::vector<LabelGeometry>& geometries,
+            bool has_errors)
         {
             OnTextureTaskCompleted(image, has_errors);
-            OnLabelsTaskCompleted(labels_data, has_errors);
+            OnLabelsTaskCompleted(labels_data, geometries, has_errors);
         }
         void MercatorNode::OnIconsTaskCompleted(const std::vector<IconData>& icons_data, bool has_errors)
         {
-            // Precision is equal to 2 pixels in chosen LOD (in degrees)
-            const double kPrecision = 2.0 * 360.0 / static_cast<double>(256 << lod_);
+            // Icons are filtered by icons task, only upload is left here
+            TextureAtlas * atlas = owner_->icon_atlas_;
+            FallbackTextureMap fallback_textures;
             for (std::vector<IconData>::const_iterator it = icons_data.begin(); it != icons_data.end(); ++it)
             {
                 const IconData & data = *it;
 
-                // Filter out duplicates (POIs that stand in the same position)
-                bool has_duplicate = false;
-                std::vector<IconData>::const_iterator dit = it; ++dit;
-                for (; dit != icons_data.end(); ++dit)
-                {
-                    const IconData & other_data = *dit;
-                    if (fabs(data.latitude - other_data.latitude) < kPrecision &&
-                        fabs(data.longitude - other_data.longitude) < kPrecision) // the same position
-                    {
-                        has_duplicate = true;
-                        break;
-                    }
-                }
-                if (has_duplicate)
-                    continue;
-
-                size_t bitmap_hash = data.hash;
-
-                MercatorTree::IconTextureCache::iterator it_cache = owner_->icon_texture_cache_.find(bitmap_hash);
-                if (it_cache != owner_->icon_texture_cache_.end()) // texture with this ID exists in cache
-                {
-                    graphics::Texture * texture = it_cache->second;
-                    Icon *icon = new Icon(owner_->renderer_, owner_->terrain_view_,
-                        owner_->billboard_shader_, data, lod_);
-                    icon->setTexture(texture, false);
-                    point_user_meshes_.push_back(icon);
-                    continue;
-                }
-
-                // Rescale image if it's not power of two 
-                // (thus generateMipmaps isn't working on iOS devices with NPOT textures)
+                TextureRegion region;
                 graphics::Texture * texture = NULL;
-                int new_width, new_height;
-                std::vector<unsigned char> new_data;
-                if (MakePotTextureFromNpot(data.width, data.height, data.bitmap_data,
-                                           new_width, new_height, new_data))
+                bool owns_texture = true;
+                FallbackTextureMap::const_iterator fallback = fallback_textures.find(data.hash);
+                if (fallback != fallback_textures.end())
                 {
-                    const unsigned char * udata = & new_data[0];
-                    owner_->renderer_->CreateTextureFromData(texture, new_width, new_height,
-                        graphics::Image::Format::kRGBA8, graphics::Texture::Filter::kTrilinear, udata);
+                    // Icons of tile are deleted together, so the first one owns shared texture
+                    texture = fallback->second;
+                    owns_texture = false;
                 }
-                else
+                else if (!atlas->Acquire(data.hash, region))
                 {
-                    const unsigned char * udata = & data.bitmap_data[0];
-                    owner_->renderer_->CreateTextureFromData(texture, data.width, data.height,
-                        graphics::Image::Format::kRGBA8, graphics::Texture::Filter::kTrilinear, udata);
+                    // Bitmap is dropped by task if some previous icon of this tile has the same hash
+                    if (data.bitmap_data.empty())
+                        continue;
+                    if (!atlas->Insert(data.hash, data.bitmap_width, data.bitmap_height, &data.bitmap_data[0], region))
+                    {
+                        // Atlas is full of used icons, this one gets its own texture
+                        owner_->renderer_->CreateTextureFromData(texture, data.bitmap_width, data.bitmap_height,
+                            graphics::Image::Format::kRGBA8, graphics::Texture::Filter::kLinear,
+                            &data.bitmap_data[0]);
+                        region = TextureRegion();
+                        fallback_textures[data.hash] = texture;
+                    }
                 }
-                
-                owner_->icon_texture_cache_.insert(std::make_pair<size_t, graphics::Texture*>(bitmap_hash, texture));
-                
+
                 Icon *icon = new Icon(owner_->renderer_, owner_->terrain_view_,
-                    owner_->billboard_shader_, data, lod_);
-                icon->setTexture(texture, false); // cache owns texture
+                    owner_->billboard_shader_, data, lod_, region);
+                if (texture)
+                    icon->setTexture(texture, owns_texture);
+                else
+                    icon->setTexture(atlas, data.hash, region);
                 point_user_meshes_.push_back(icon);
             }
             has_icons_ = true;
@@ -705,6 +668,24 @@ namespace mgn {
             // Unload data on detach
             //UnloadData();
         }
+        void MercatorNode::MarkOpened()
+        {
+            last_opened_ = owner_->GetFrameCounter();
+            if (is_open_)
+            {
+                owner_->UnlinkOpenNode(this);
+                owner_->LinkOpenNode(this);
+            }
+        }
+        void MercatorNode::OnMapTileDataArrived()
+        {
+            // Map tile request parked by the tree is put back exactly once
+            if (wait_map_tile_)
+            {
+                wait_map_tile_ = false;
+                owner_->Request(this, MercatorTree::REQUEST_MAPTILE);
+            }
+        }
         void MercatorNode::LoadData()
         {
             // Request labels load
@@ -731,13 +712,13 @@ namespace mgn {
             }
             if (has_icons_)
             {
+                // Icons should leave icons list before deletion
+                owner_->RemoveIcons(this);
                 for (std::vector<Icon*>::iterator it = point_user_meshes_.begin();
                     it != point_user_meshes_.end(); ++it)
                     delete *it;
                 point_user_meshes_.clear();
                 has_icons_ = false;
-                // Need to flush icons list
-                owner_->UpdateIconList();
             }
         }
 
@@ -6,6 +6,7 @@
 
 #include "mgnTrMercatorMapTile.h"
 #include "mgnTrMercatorRenderable.h"
+#include "mgnTrMercatorRequestQueue.h"
 
 #include "../mgnTrMesh.h"
 
@@ -19,13 +20,16 @@ namespace mgn {
         class Label;
         class AtlasLabel;
         class Icon;
+        class Font;
+        struct LabelGeometry;
 
         //! Mercator tree node class
         class MercatorNode {
             friend class MercatorTree;
             friend class MercatorRenderable;
             friend class MercatorMapTile;
-            friend class MercatorNodeCompareLastOpened;
+            friend class MercatorNodePool;
+            friend class MercatorNodeCache;
         public:
             enum Slot { TOP_LEFT, TOP_RIGHT, BOTTOM_LEFT, BOTTOM_RIGHT };
 
@@ -35,9 +39,12 @@ namespace mgn {
             int lod() const;
             int x() const;
             int y() const;
+            unsigned int generation() const;
+            bool IsPrefetch() const;
 
             const float GetPriority() const;
             const mgnMdTerrainView * terrain_view() const;
+            const Font * font() const;
 
             bool IsSplit();
 
@@ -54,20 +61,30 @@ namespace mgn {
             void RefreshRenderable(MercatorMapTile * map_tile);
 
             bool WillRender();
-            int Render();
+            //! Renders node or its children, planes accepted by ancestors aren't tested again
+            int Render(math::CullInfo cull_info);
 
             // Task functions
             void OnTextureTaskCompleted(const graphics::Image& image, bool has_errors);
-            void OnHeightmapTaskCompleted(const graphics::Image& image, bool has_errors);
-            void OnLabelsTaskCompleted(const std::vector<LabelData>& labels_data, bool has_errors);
+            void OnHeightmapTaskCompleted(const graphics::Image& image,
+                MercatorHeightData& height_data, bool has_errors);
+            void OnLabelsTaskCompleted(const std::vector<LabelData>& labels_data,
+                const std::vector<LabelGeometry>& geometries, bool has_errors);
             void OnTextureLabelsTaskCompleted(const graphics::Image& image,
-                const std::vector<LabelData>& labels_data, bool has_errors);
+                const std::vector<LabelData>& labels_data, const std::vector<LabelGeometry>& geometries,
+                bool has_errors);
             void OnIconsTaskCompleted(const std::vector<IconData>& icons_data, bool has_errors);
 
         protected:
             void RenderSelf();
             void RenderLabels();
 
+            //! Re-enqueues map tile request waiting for task data
+            void OnMapTileDataArrived();
+
+            //! Updates last opened frame, open node is moved to the back of tree's open nodes list
+            void MarkOpened();
+
             // Node data functions
             void OnAttach();
             void OnDetach();
@@ -85,6 +102,8 @@ namespace mgn {
             int x_;
             int y_;
 
+            unsigned int generation_; //!< incremented when node's pending tasks become obsolete
+
             int last_rendered_;
             int last_opened_;
 
@@ -92,13 +111,26 @@ namespace mgn {
             MercatorNode * parent_;
             MercatorNode * children_[4];
 
+            // LRU list hooks, node is owned either by node pool or by node cache
+            MercatorNode * lru_prev_;
+            MercatorNode * lru_next_;
+            MercatorNode * pool_hash_next_;
+
+            // Open nodes list hooks, list is ordered by last opened frame
+            MercatorNode * open_prev_;
+            MercatorNode * open_next_;
+
+            MercatorRequest requests_[kNumMercatorRequestTypes]; //!< tree request queue hooks, one per request type
+
             bool has_children_;
+            bool is_open_;  //!< node is split, but none of its children is
             bool page_out_;
             bool has_map_tile_;
             bool has_renderable_;
 
             bool request_page_out_;
             bool request_map_tile_;
+            bool wait_map_tile_;    //!< map tile request is parked until texture or heightmap arrives
             bool request_renderable_;
             bool request_split_;
             bool request_merge_;
@@ -112,20 +144,16 @@ namespace mgn {
             // Node data load flags
             bool has_labels_;
             bool has_icons_;
+            bool in_icon_list_;             //!< icons are in tree's icon depth list
+            unsigned int icon_list_stamp_;  //!< last icon list update which has found node rendered
+
+            bool prefetch_; //!< node is loaded speculatively ahead of camera
 
             std::vector<Label*>         label_meshes_;
             std::vector<AtlasLabel*>    atlas_label_meshes_;
             std::vector<Icon*>          point_user_meshes_;
         };
 
-        // Quad tree node comparison for LOD age.
-        class MercatorNodeCompareLastOpened {
-        public:
-            bool operator()(const MercatorNode* a, const MercatorNode* b) const {
-                return (a->last_opened_ > b->last_opened_);
-            }
-        };
-
     } // namespace terrain
 } // namespace mgn
 
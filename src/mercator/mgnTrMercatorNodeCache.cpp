@@ -0,0 +1,141 @@
+#include "mgnTrMercatorNodeCache.h"
+
+#include "mgnTrMercatorNode.h"
+
+#include <cstring>
+#include <assert.h>
+
+namespace mgn {
+    namespace terrain {
+
+        MercatorNodeCache::MercatorNodeCache(int capacity)
+        : capacity_(capacity)
+        , size_(0)
+        , head_(NULL)
+        , tail_(NULL)
+        {
+            // Keep load factor under 0.5 for short probe sequences
+            size_t table_size = 2;
+            while (table_size < 2 * static_cast<size_t>(capacity))
+                table_size <<= 1;
+            table_mask_ = table_size - 1;
+            table_ = new Entry[table_size];
+            memset(table_, 0, table_size * sizeof(Entry));
+        }
+        MercatorNodeCache::~MercatorNodeCache()
+        {
+            Clear();
+            delete[] table_;
+        }
+        MercatorNode * MercatorNodeCache::Find(const MercatorNodeKey& key)
+        {
+            const PackedTileKey packed_key = key;
+            for (size_t slot = GetSlot(packed_key); table_[slot].node; slot = (slot + 1) & table_mask_)
+            {
+                if (table_[slot].key == packed_key)
+                {
+                    MercatorNode * node = table_[slot].node;
+                    if (node != head_)
+                    {
+                        Unlink(node);
+                        LinkFront(node);
+                    }
+                    return node;
+                }
+            }
+            return NULL;
+        }
+        MercatorNode * MercatorNodeCache::Insert(MercatorNode * node)
+        {
+            MercatorNode * evicted_node = NULL;
+            if (size_ == capacity_)
+            {
+                // Evict the least recently used one
+                evicted_node = tail_;
+                Erase(evicted_node);
+            }
+            const PackedTileKey packed_key(node->lod_, node->x_, node->y_);
+            size_t slot = GetSlot(packed_key);
+            while (table_[slot].node)
+            {
+                assert(table_[slot].key != packed_key);
+                slot = (slot + 1) & table_mask_;
+            }
+            table_[slot].key = packed_key;
+            table_[slot].node = node;
+            LinkFront(node);
+            ++size_;
+            return evicted_node;
+        }
+        void MercatorNodeCache::Clear()
+        {
+            while (tail_)
+            {
+                MercatorNode * node = tail_;
+                Erase(node);
+                delete node;
+            }
+        }
+        int MercatorNodeCache::capacity() const
+        {
+            return capacity_;
+        }
+        int MercatorNodeCache::size() const
+        {
+            return size_;
+        }
+        size_t MercatorNodeCache::GetSlot(const PackedTileKey& key) const
+        {
+            return hash_value(key) & table_mask_;
+        }
+        void MercatorNodeCache::Erase(MercatorNode * node)
+        {
+            Unlink(node);
+            --size_;
+
+            const PackedTileKey packed_key(node->lod_, node->x_, node->y_);
+            size_t slot = GetSlot(packed_key);
+            while (table_[slot].node != node)
+                slot = (slot + 1) & table_mask_;
+
+            // Backward shift deletion, keeps probe sequences valid without tombstones
+            size_t hole = slot;
+            for (size_t next = (hole + 1) & table_mask_; table_[next].node; next = (next + 1) & table_mask_)
+            {
+                size_t home = GetSlot(table_[next].key);
+                // Move entry if its home slot isn't in cyclic range (hole, next]
+                bool in_range = (hole <= next) ? (hole < home && home <= next) : (hole < home || home <= next);
+                if (!in_range)
+                {
+                    table_[hole] = table_[next];
+                    hole = next;
+                }
+            }
+            table_[hole].node = NULL;
+        }
+        void MercatorNodeCache::LinkFront(MercatorNode * node)
+        {
+            node->lru_prev_ = NULL;
+            node->lru_next_ = head_;
+            if (head_)
+                head_->lru_prev_ = node;
+            else
+                tail_ = node;
+            head_ = node;
+        }
+        void MercatorNodeCache::Unlink(MercatorNode * node)
+        {
+            if (node->lru_prev_)
+                node->lru_prev_->lru_next_ = node->lru_next_;
+            else
+                head_ = node->lru_next_;
+            if (node->lru_next_)
+                node->lru_next_->lru_prev_ = node->lru_prev_;
+            else
+                tail_ = node->lru_prev_;
+            node->lru_prev_ = NULL;
+            node->lru_next_ = NULL;
+        }
+
+    } // namespace terrain
+} // namespace mgn
@@ -0,0 +1,66 @@
+#pragma once
+#ifndef __MGN_TERRAIN_MERCATOR_NODE_CACHE_H__
+#define __MGN_TERRAIN_MERCATOR_NODE_CACHE_H__
+
+#include "mgnTrMercatorNodeKey.h"
+
+#include <cstddef>
+
+namespace mgn {
+    namespace terrain {
+
+        // Forward declarations
+        class MercatorNode;
+
+        /*! Mercator node cache class.
+        ** Bounded storage of nodes for collection mode. Nodes are stored in open addressing
+        ** hash table keyed by packed tile key and linked into LRU list.
+        ** Lookups don't allocate memory, the least recently used node is evicted when cache is full.
+        */
+        class MercatorNodeCache {
+        public:
+            explicit MercatorNodeCache(int capacity);
+            ~MercatorNodeCache();
+
+            //! Finds node and marks it as the most recently used.
+            // @return Returns node if key exists and NULL otherwise.
+            MercatorNode * Find(const MercatorNodeKey& key);
+
+            //! Inserts node into cache.
+            // @return Returns NULL if cache isn't full and NOT NULL if storage
+            //         is full and the least recently used node has been evicted.
+            //         Evicted node should be deleted by caller.
+            MercatorNode * Insert(MercatorNode * node);
+
+            //! Deletes all nodes in cache
+            void Clear();
+
+            int capacity() const;
+            int size() const;
+
+        private:
+            MercatorNodeCache(const MercatorNodeCache&);
+            MercatorNodeCache& operator=(const MercatorNodeCache&);
+
+            struct Entry {
+                PackedTileKey key;
+                MercatorNode * node; //!< NULL for empty slot
+            };
+
+            size_t GetSlot(const PackedTileKey& key) const;
+            void Erase(MercatorNode * node);
+            void LinkFront(MercatorNode * node);
+            void Unlink(MercatorNode * node);
+
+            int capacity_;
+            int size_;
+            Entry * table_;
+            size_t table_mask_;         //!< table size minus one
+            MercatorNode * head_;       //!< the most recently used node
+            MercatorNode * tail_;       //!< the least recently used node
+        };
+
+    } // namespace terrain
+} // namespace mgn
+
+#endif
@@ -10,7 +10,14 @@ namespace mgn {
         {
 
         }
-        bool MercatorNodeKey::operator < (const MercatorNodeKey& other)
+        MercatorNodeKey::MercatorNodeKey(const PackedTileKey& key)
+        : lod(key.level())
+        , x(key.x())
+        , y(key.y())
+        {
+
+        }
+        bool MercatorNodeKey::operator < (const MercatorNodeKey& other) const
         {
             if (lod != other.lod)
                 return lod < other.lod;
@@ -19,19 +26,18 @@ namespace mgn {
             else
                 return y < other.y;
         }
-        bool operator < (const MercatorNodeKey& lhs, const MercatorNodeKey& rhs)
+        bool MercatorNodeKey::operator ==(const MercatorNodeKey& other) const
         {
-            if (lhs.lod != rhs.lod)
-                return lhs.lod < rhs.lod;
-            else if (lhs.x != rhs.x)
-                return lhs.x < rhs.x;
-            else
-                return lhs.y < rhs.y;
+            return lod == other.lod && x == other.x && y == other.y;
         }
-        bool MercatorNodeKey::operator ==(const MercatorNodeKey& other)
+        MercatorNodeKey::operator PackedTileKey() const
         {
-            return lod == other.lod && x == other.x && y == other.y;
+            return PackedTileKey(lod, x, y);
+        }
+        std::size_t hash_value(const MercatorNodeKey& key)
+        {
+            return hash_value(PackedTileKey(key));
         }
 
     } // namespace terrain
-} // namespace mgn
\ No newline at end of file
+} // namespace mgn
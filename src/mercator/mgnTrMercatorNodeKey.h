@@ -2,6 +2,10 @@
 #ifndef __MGN_TERRAIN_MERCATOR_NODE_KEY_H__
 #define __MGN_TERRAIN_MERCATOR_NODE_KEY_H__
 
+#include "../mgnTrPackedTileKey.h"
+
+#include <cstddef>
+
 namespace mgn {
     namespace terrain {
 
@@ -12,13 +16,17 @@ namespace mgn {
             int y;
 
             MercatorNodeKey(int lod, int x, int y);
+            explicit MercatorNodeKey(const PackedTileKey& key);
 
-            bool operator < (const MercatorNodeKey& other);
-            friend bool operator < (const MercatorNodeKey& lhs, const MercatorNodeKey& rhs);
-            bool operator ==(const MercatorNodeKey& other);
+            bool operator < (const MercatorNodeKey& other) const;
+            bool operator ==(const MercatorNodeKey& other) const;
+
+            operator PackedTileKey() const;
         };
 
+        std::size_t hash_value(const MercatorNodeKey& key);
+
     } // namespace terrain
 } // namespace mgn
 
-#endif
\ No newline at end of file
+#endif
@@ -2,53 +2,134 @@
 
 #include "mgnTrMercatorNode.h"
 
+#include "mgnTrConstants.h"
+
+#include <cstring>
+
 namespace mgn {
     namespace terrain {
 
         MercatorNodePool::MercatorNodePool(int capacity)
         : capacity_(capacity)
         , size_(0)
+        , head_(NULL)
+        , tail_(NULL)
         {
-            nodes_ = new MercatorNode*[capacity];
+            // Keep load factor under 1
+            size_t num_buckets = 1;
+            while (num_buckets < static_cast<size_t>(capacity))
+                num_buckets <<= 1;
+            bucket_mask_ = num_buckets - 1;
+            buckets_ = new MercatorNode*[num_buckets];
+            memset(buckets_, 0, num_buckets * sizeof(MercatorNode*));
         }
         MercatorNodePool::~MercatorNodePool()
         {
-            delete[] nodes_;
+            Clear();
+            delete[] buckets_;
+        }
+        int MercatorNodePool::CapacityForMemory(size_t memory_budget)
+        {
+            // Estimated memory used by single node with loaded data
+            const size_t kTileResolution = static_cast<size_t>(GetTileResolution());
+            const size_t kHeightmapSize = static_cast<size_t>(GetHeightmapWidth() * GetHeightmapHeight());
+            const size_t kDataSize = 16 * 1024; // labels and icons, rough approximation
+            const size_t kNodeSize = sizeof(MercatorNode)
+                + kTileResolution * kTileResolution * 3 // albedo texture
+                + kHeightmapSize * 3                    // heightmap texture
+                + kHeightmapSize * sizeof(float)        // height data
+                + kDataSize;
+            size_t capacity = memory_budget / kNodeSize;
+            return (capacity > 0) ? static_cast<int>(capacity) : 1;
         }
         MercatorNode * MercatorNodePool::Pull(const MercatorNodeKey& key)
         {
-            for (int i = 0; i < size_; ++i)
+            MercatorNode * node = buckets_[GetBucket(key)];
+            while (node)
             {
-                MercatorNode * node = nodes_[i];
-                if (node->x() == key.x && node->y() == key.y && node->lod() == key.lod)
+                if (node->x_ == key.x && node->y_ == key.y && node->lod_ == key.lod)
                 {
-                    --size_;
-                    if (i < size_)
-                    {
-                        memmove(nodes_ + i, nodes_ + i + 1, (size_ - i) * sizeof(MercatorNode*));
-                        nodes_[size_] = NULL;
-                    }
-                    else
-                        nodes_[i] = NULL;
+                    Erase(node);
                     return node;
                 }
+                node = node->pool_hash_next_;
             }
             return NULL;
         }
         MercatorNode * MercatorNodePool::Push(MercatorNode * node)
         {
+            MercatorNode * erased_node = NULL;
             if (size_ == capacity_)
             {
-                // Erase the oldest one
-                MercatorNode * erased_node = nodes_[0];
-                --size_;
-                memmove(nodes_, nodes_ + 1, size_ * sizeof(MercatorNode*));
-                return erased_node;
+                // Erase the least recently used one
+                erased_node = tail_;
+                Erase(erased_node);
+            }
+            Insert(node);
+            return erased_node;
+        }
+        void MercatorNodePool::Clear()
+        {
+            while (tail_)
+            {
+                MercatorNode * node = tail_;
+                Erase(node);
+                delete node;
             }
-            nodes_[size_] = node;
+        }
+        int MercatorNodePool::capacity() const
+        {
+            return capacity_;
+        }
+        int MercatorNodePool::size() const
+        {
+            return size_;
+        }
+        size_t MercatorNodePool::GetBucket(const MercatorNodeKey& key) const
+        {
+            return hash_value(key) & bucket_mask_;
+        }
+        void MercatorNodePool::Insert(MercatorNode * node)
+        {
+            // Put to the front of LRU list
+            node->lru_prev_ = NULL;
+            node->lru_next_ = head_;
+            if (head_)
+                head_->lru_prev_ = node;
+            else
+                tail_ = node;
+            head_ = node;
+
+            // Put to the front of hash chain
+            MercatorNode* &bucket = buckets_[GetBucket(MercatorNodeKey(node->lod_, node->x_, node->y_))];
+            node->pool_hash_next_ = bucket;
+            bucket = node;
+
             ++size_;
-            return NULL;
+        }
+        void MercatorNodePool::Erase(MercatorNode * node)
+        {
+            // Remove from LRU list
+            if (node->lru_prev_)
+                node->lru_prev_->lru_next_ = node->lru_next_;
+            else
+                head_ = node->lru_next_;
+            if (node->lru_next_)
+                node->lru_next_->lru_prev_ = node->lru_prev_;
+            else
+                tail_ = node->lru_prev_;
+            node->lru_prev_ = NULL;
+            node->lru_next_ = NULL;
+
+            // Remove from hash chain
+            MercatorNode* *link = &buckets_[GetBucket(MercatorNodeKey(node->lod_, node->x_, node->y_))];
+            while (*link != node)
+                link = &(*link)->pool_hash_next_;
+            *link = node->pool_hash_next_;
+            node->pool_hash_next_ = NULL;
+
+            --size_;
         }
 
     } // namespace terrain
-} // namespace mgn
\ No newline at end of file
+} // namespace mgn
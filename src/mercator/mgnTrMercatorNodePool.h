@@ -4,6 +4,8 @@
 
 #include "mgnTrMercatorNodeKey.h"
 
+#include <cstddef>
+
 namespace mgn {
     namespace terrain {
 
@@ -12,29 +14,50 @@ namespace mgn {
 
         /*! Mercator node pool class.
         ** The main proposal of such a pool class is not to destroy nodes on detach.
-        ** This class has been made as LRU cache analog without memory allocations.
+        ** This class has been made as LRU cache analog without memory allocations:
+        ** nodes are linked into intrusive LRU list and intrusive hash chains,
+        ** so all operations are O(1).
         */
         class MercatorNodePool {
         public:
-            MercatorNodePool(int capacity);
+            explicit MercatorNodePool(int capacity);
             ~MercatorNodePool();
 
+            //! Returns pool capacity that fits into given memory budget (in bytes)
+            static int CapacityForMemory(size_t memory_budget);
+
             //! Pulls node from pool.
             // @return Returns node if key exists and NULL otherwise.
             MercatorNode * Pull(const MercatorNodeKey& key);
 
             //! Pushes node to pull
             // @return Returns NULL if cache isn't full and NOT NULL if
-            //         storage is full and one node has been moved out.
+            //         storage is full and the least recently used node has been moved out.
             MercatorNode * Push(MercatorNode * node);
 
+            //! Deletes all nodes in pool
+            void Clear();
+
+            int capacity() const;
+            int size() const;
+
         private:
+            MercatorNodePool(const MercatorNodePool&);
+            MercatorNodePool& operator=(const MercatorNodePool&);
+
+            size_t GetBucket(const MercatorNodeKey& key) const;
+            void Insert(MercatorNode * node);
+            void Erase(MercatorNode * node);
+
             int capacity_;
             int size_;
-            MercatorNode* *nodes_;
+            MercatorNode* *buckets_;    //!< heads of hash chains
+            size_t bucket_mask_;        //!< number of buckets minus one
+            MercatorNode * head_;       //!< the most recently used node
+            MercatorNode * tail_;       //!< the least recently used node
         };
 
     } // namespace terrain
 } // namespace mgn
 
-#endif
\ No newline at end of file
+#endif
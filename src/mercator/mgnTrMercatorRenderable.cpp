@@ -3,6 +3,7 @@
 #include "mgnTrMercatorTree.h"
 #include "mgnTrMercatorNode.h"
 #include "mgnTrMercatorMapTile.h"
+#include "mgnTrMercatorService.h"
 
 #include "mgnTrConstants.h"
 
@@ -26,6 +27,8 @@ namespace {
         float height_multiplier = kMSM / 111111.0f / 360.0f;
         return height * height_multiplier;
     }
+    // Minimum priority change to reorder node tasks in service
+    const float kPriorityThreshold = 0.05f;
 }
 
 namespace mgn {
@@ -35,6 +38,7 @@ namespace mgn {
 		: node_(NULL)
 		, map_tile_(NULL)
 		, lod_priority_(0.0f)
+		, reported_priority_(0.0f)
 		, child_distance_(0.0f)
 		, distance_(0.0f)
 		, is_in_lod_range_(false)
@@ -72,17 +76,16 @@ namespace mgn {
                 // Update just map tile dependent functions
                 map_tile_ = map_tile;
                 child_distance_ = 0.0f;
+                // Heights and so bounds come from the new map tile
+                AnalyzeTerrain();
                 InitDisplacementMapping();
             }
         }
 		void MercatorRenderable::SetFrameOfReference()
 		{
 			const MercatorLodParams& params = node_->owner_->lod_params_;
-			const math::Frustum * frustum = node_->owner_->frustum_;
             const float planet_radius = node_->owner_->earth_radius_;
 
-			// Bounding box clipping.
-			is_clipped_ = false; //!frustum->IsBoxIn(bounding_box_); // TODO: fix clipping
 			is_far_away_ = false;
 
 			// Get vector from center to camera and normalize it.
@@ -105,7 +108,14 @@ namespace mgn {
 			math::Vector3 to_camera = near_position_offset / near_position_distance;
 
 			// Determine LOD priority.
-			lod_priority_ = -(to_camera & params.camera_front);
+			float lod_priority = -(to_camera & params.camera_front);
+			if (fabs(lod_priority - reported_priority_) > kPriorityThreshold)
+			{
+				// Let the tiles in front of camera be fetched first
+				node_->owner_->service_->UpdateNodePriority(const_cast<MercatorNode*>(node_), lod_priority);
+				reported_priority_ = lod_priority;
+			}
+			lod_priority_ = lod_priority;
 
 			is_in_lod_range_ = true; //GetLodDistance() * params.geo_factor < near_position_distance;
 
@@ -117,6 +127,16 @@ namespace mgn {
 
 			is_in_mip_range_ = texel_size * params.tex_factor < near_position_distance;
 		}
+		void MercatorRenderable::UpdateVisibility(math::CullInfo& cull_info)
+		{
+			// Planes that have accepted one of ancestors can't cull this box
+			if (cull_info.active_planes)
+			{
+				const math::Frustum * frustum = node_->owner_->frustum_;
+				cull_info = frustum->ComputeBoxVisibility(bounding_box_.center, bounding_box_.extent, cull_info);
+			}
+			is_clipped_ = cull_info.culled;
+		}
 		const bool MercatorRenderable::IsInLODRange() const
 		{
 			return is_in_lod_range_;
@@ -181,7 +201,8 @@ namespace mgn {
 			math::Vector3 min = math::Vector3(fMapSizeMax), max = math::Vector3(-fMapSizeMax);
 			center_.Set(0.0f, 0.0f, 0.0f);
 
-            const float * height_data = map_tile_->GetHeightData();
+            const MercatorHeightData& tile_height_data = map_tile_->GetHeightData();
+            const float * height_data = tile_height_data.heights();
 
             if (height_data != NULL)
             {
@@ -241,6 +262,19 @@ namespace mgn {
 				}
 			}
 
+			// Grid vertices may skip peaks between them, so take height bounds over all samples of the tile.
+			// Tile region is aligned to a cell of the min/max pyramid, so lookup just descends to it.
+			if (height_data != NULL)
+			{
+				float min_height, max_height;
+				tile_height_data.GetBounds(pixel_x, pixel_y,
+					pixel_x + step_x * (grid_size - 1), pixel_y + step_y * (grid_size - 1),
+					min_height, max_height);
+				// Skirts are lowered by the lossy representation error
+				min.y = MetersToPixelsHeight(min_height - distance_);
+				max.y = MetersToPixelsHeight(max_height);
+			}
+
 			// Calculate center.
 			center_ /= (float)(grid_size * grid_size);
 
@@ -23,6 +23,8 @@ namespace mgn {
             void Update(MercatorNode * node, MercatorMapTile * map_tile);
 
 			void SetFrameOfReference();
+			//! Tests bounding box against frustum planes left active by the parent node
+			void UpdateVisibility(math::CullInfo& cull_info);
 
 			const bool IsInLODRange() const;
 			const bool IsClipped() const;
@@ -46,6 +48,7 @@ namespace mgn {
 			math::Vector3 center_;
 
 			float lod_priority_; //!< priority for nodes queue processing
+			float reported_priority_; //!< priority last reported to service
 			float child_distance_;
 
 			// Additional params to map to shader
@@ -0,0 +1,60 @@
+#include "mgnTrMercatorRequestQueue.h"
+
+#include <assert.h>
+
+namespace mgn {
+    namespace terrain {
+
+        MercatorRequestQueue::MercatorRequestQueue()
+        : size_(0)
+        {
+            head_.prev = &head_;
+            head_.next = &head_;
+        }
+        bool MercatorRequestQueue::empty() const
+        {
+            return size_ == 0;
+        }
+        size_t MercatorRequestQueue::size() const
+        {
+            return size_;
+        }
+        MercatorRequest * MercatorRequestQueue::front() const
+        {
+            return (size_ != 0) ? head_.next : NULL;
+        }
+        void MercatorRequestQueue::PushFront(MercatorRequest * request)
+        {
+            InsertAfter(&head_, request);
+        }
+        void MercatorRequestQueue::PushBack(MercatorRequest * request)
+        {
+            InsertAfter(head_.prev, request);
+        }
+        void MercatorRequestQueue::Remove(MercatorRequest * request)
+        {
+            assert(request->IsQueued());
+            request->prev->next = request->next;
+            request->next->prev = request->prev;
+            request->prev = NULL;
+            request->next = NULL;
+            --size_;
+        }
+        void MercatorRequestQueue::Clear()
+        {
+            // Hooks belong to nodes, just unlink them
+            while (size_ != 0)
+                Remove(head_.next);
+        }
+        void MercatorRequestQueue::InsertAfter(MercatorRequest * position, MercatorRequest * request)
+        {
+            assert(!request->IsQueued());
+            request->prev = position;
+            request->next = position->next;
+            position->next->prev = request;
+            position->next = request;
+            ++size_;
+        }
+
+    } // namespace terrain
+} // namespace mgn
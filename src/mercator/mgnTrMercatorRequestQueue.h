@@ -0,0 +1,83 @@
+#pragma once
+#ifndef __MGN_TERRAIN_MERCATOR_REQUEST_QUEUE_H__
+#define __MGN_TERRAIN_MERCATOR_REQUEST_QUEUE_H__
+
+#include <algorithm>
+#include <cstddef>
+#include <vector>
+
+namespace mgn {
+    namespace terrain {
+
+        // Forward declarations
+        class MercatorNode;
+
+        //! Number of request types handled by Mercator tree
+        const int kNumMercatorRequestTypes = 4;
+
+        //! Mercator request structure, intrusive queue hook embedded into node per request type
+        struct MercatorRequest {
+            MercatorNode * node;
+            int type;
+            MercatorRequest * prev;
+            MercatorRequest * next;
+
+            MercatorRequest() : node(NULL), type(0), prev(NULL), next(NULL) {}
+
+            bool IsQueued() const { return prev != NULL; }
+        };
+
+        /*! Mercator request queue class.
+        ** Doubly linked list of request hooks owned by nodes, so pushing
+        ** doesn't allocate memory and removal of any request is O(1).
+        ** Node may be queued at most once per request type.
+        */
+        class MercatorRequestQueue {
+        public:
+            MercatorRequestQueue();
+
+            bool empty() const;
+            size_t size() const;
+            MercatorRequest * front() const;
+
+            void PushFront(MercatorRequest * request);
+            void PushBack(MercatorRequest * request);
+            //! Request should be queued in this queue
+            void Remove(MercatorRequest * request);
+            void Clear();
+
+            //! Stable sort of requests, same as std::list::sort
+            template <class Compare>
+            void Sort(Compare compare)
+            {
+                sort_buffer_.clear();
+                for (MercatorRequest * request = head_.next; request != &head_; request = request->next)
+                    sort_buffer_.push_back(request);
+                std::stable_sort(sort_buffer_.begin(), sort_buffer_.end(), compare);
+                // Relink hooks in sorted order
+                MercatorRequest * prev = &head_;
+                for (std::vector<MercatorRequest*>::iterator it = sort_buffer_.begin(); it != sort_buffer_.end(); ++it)
+                {
+                    prev->next = *it;
+                    (*it)->prev = prev;
+                    prev = *it;
+                }
+                prev->next = &head_;
+                head_.prev = prev;
+            }
+
+        private:
+            MercatorRequestQueue(const MercatorRequestQueue&);
+            MercatorRequestQueue& operator=(const MercatorRequestQueue&);
+
+            void InsertAfter(MercatorRequest * position, MercatorRequest * request);
+
+            MercatorRequest head_;  //!< sentinel, list is circular
+            size_t size_;
+            std::vector<MercatorRequest*> sort_buffer_; //!< kept to not allocate on every sort
+        };
+
+    } // namespace terrain
+} // namespace mgn
+
+#endif
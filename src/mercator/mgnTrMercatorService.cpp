@@ -2,13 +2,25 @@
 
 #include <boost/functional.hpp>
 
+#include <algorithm>
+
+namespace {
+	// Maximum number of tasks fetched by a single provider call
+	const size_t kMaxBatchSize = 16;
+}
+
 namespace mgn {
     namespace terrain {
 
-    	MercatorService::MercatorService()
-		: processed_node_(NULL)
+    	MercatorService::MercatorService(int num_workers)
+		: num_tasks_(0)
+		, next_worker_(0)
 		, finishing_(false)
 		{
+			for (int i = 0; i < std::max(num_workers, 1); ++i)
+			{
+				workers_.push_back(new Worker());
+			}
 		}
 		MercatorService::~MercatorService()
 		{
@@ -18,28 +30,26 @@ namespace mgn {
 			mutex_.unlock();
 			if (!finishing)
 				StopService();
+			for (std::vector<Worker*>::iterator it = workers_.begin(); it != workers_.end(); ++it)
+				delete *it;
 		}
 		void MercatorService::RunService()
 		{
 			finishing_ = false;
-			thread_ = boost::thread(boost::bind(&MercatorService::ThreadFunc, this));
+			for (int i = 0; i < static_cast<int>(workers_.size()); ++i)
+				threads_.create_thread(boost::bind(&MercatorService::ThreadFunc, this, i));
 		}
 		void MercatorService::StopService()
 		{
 			{//---
 				boost::unique_lock<boost::mutex> guard(mutex_);
 				finishing_ = true;
-				condition_variable_.notify_one();
+				condition_variable_.notify_all();
 			}//---
-			thread_.join();
+			threads_.join_all();
 
+			ClearTasks();
 			Task * task = 0;
-            while (!tasks_.empty()) // there are some tasks
-            {
-                task = tasks_.front();
-                tasks_.pop_front();
-                delete task;
-            }
             while (!done_tasks_.empty())
             {
                 task = done_tasks_.front();
@@ -51,20 +61,23 @@ namespace mgn {
 		{
 			{//---
 				boost::unique_lock<boost::mutex> guard(mutex_);
-				Task * task = 0;
-	            while (!tasks_.empty()) // there are some tasks
-	            {
-	                task = tasks_.front();
-	                tasks_.pop_front();
-	                delete task;
-	            }
+				std::vector<Task*> tasks;
+				for (std::vector<Worker*>::iterator it = workers_.begin(); it != workers_.end(); ++it)
+					(*it)->tasks.Release(tasks);
+	            for (std::vector<Task*>::iterator it = tasks.begin(); it != tasks.end(); ++it)
+	                delete *it;
+				node_tasks_.clear();
+				num_tasks_ = 0;
 			}//---
 		}
         void MercatorService::AddTask(Task * task)
         {
             {//---
 				boost::unique_lock<boost::mutex> guard(mutex_);
-				tasks_.push_back(task);
+				workers_[next_worker_]->tasks.Push(task);
+				node_tasks_.insert(std::make_pair(task->node(), task));
+				next_worker_ = (next_worker_ + 1) % static_cast<int>(workers_.size());
+				++num_tasks_;
 				condition_variable_.notify_one();
 			}//---
         }
@@ -79,61 +92,167 @@ namespace mgn {
         		return true;
         	}
         }
-        bool MercatorService::RemoveAllNodeTasks(MercatorNode * node)
+        void MercatorService::CancelAllNodeTasks(MercatorNode * node)
         {
         	boost::unique_lock<boost::mutex> guard(mutex_);
-        	if (processed_node_ == node)
-        		return false;
-        	TaskNodeMatchFunctor task_match_functor(node);
-        	tasks_.remove_if(task_match_functor);
-        	done_tasks_.remove_if(task_match_functor);
-        	return true;
+        	// Tasks being executed are just marked, they will be deleted by worker after execution
+        	for (std::vector<Worker*>::const_iterator it = workers_.begin(); it != workers_.end(); ++it)
+        	{
+        		const TaskBatch& batch = (*it)->processed_tasks;
+        		for (TaskBatch::const_iterator itb = batch.begin(); itb != batch.end(); ++itb)
+        			if ((*itb)->node() == node)
+        				(*itb)->Cancel();
+        	}
+        	// Queued tasks may be deleted immediately
+        	std::pair<NodeTaskMap::iterator, NodeTaskMap::iterator> range = node_tasks_.equal_range(node);
+        	for (NodeTaskMap::iterator it = range.first; it != range.second; ++it)
+        	{
+        		Task * task = it->second;
+        		task->queue_->Remove(task);
+        		delete task;
+        		--num_tasks_;
+        	}
+        	node_tasks_.erase(range.first, range.second);
+        	// Done tasks will be dropped on processing
+        	for (TaskList::iterator it = done_tasks_.begin(); it != done_tasks_.end(); ++it)
+        	{
+        		Task * task = *it;
+        		if (task->node() == node)
+        			task->Cancel();
+        	}
         }
-        void MercatorService::SortTasks()
+        void MercatorService::UpdateNodePriority(MercatorNode * node, float priority)
         {
             boost::unique_lock<boost::mutex> guard(mutex_);
-            tasks_.sort(TaskNodeCompareFunctor());
+            std::pair<NodeTaskMap::iterator, NodeTaskMap::iterator> range = node_tasks_.equal_range(node);
+            for (NodeTaskMap::iterator it = range.first; it != range.second; ++it)
+            {
+                Task * task = it->second;
+                task->queue_->Update(task, priority);
+            }
         }
-		void MercatorService::ThreadFunc()
+        void MercatorService::PromoteNodeTasks(MercatorNode * node)
+        {
+            boost::unique_lock<boost::mutex> guard(mutex_);
+            std::pair<NodeTaskMap::iterator, NodeTaskMap::iterator> range = node_tasks_.equal_range(node);
+            for (NodeTaskMap::iterator it = range.first; it != range.second; ++it)
+            {
+                Task * task = it->second;
+                if (task->IsPrefetch())
+                    task->queue_->Promote(task);
+            }
+        }
+        void MercatorService::RefreshPriorities()
+        {
+            boost::unique_lock<boost::mutex> guard(mutex_);
+            for (std::vector<Worker*>::iterator it = workers_.begin(); it != workers_.end(); ++it)
+                (*it)->tasks.RefreshPriorities();
+        }
+        int MercatorService::num_workers() const
+        {
+            return static_cast<int>(workers_.size());
+        }
+        Task * MercatorService::PopTask(int index)
+        {
+            // Should be called with locked mutex
+            TaskQueue * queue = &workers_[index]->tasks;
+            if (queue->empty())
+            {
+                // Steal the most important task among other workers
+                queue = NULL;
+                TaskNodeCompareFunctor compare;
+                for (std::vector<Worker*>::iterator it = workers_.begin(); it != workers_.end(); ++it)
+                {
+                    TaskQueue * victim = &(*it)->tasks;
+                    if (!victim->empty() && (!queue || compare(victim->Top(), queue->Top())))
+                        queue = victim;
+                }
+                if (!queue)
+                    return NULL;
+            }
+            Task * task = queue->Pop();
+            EraseNodeTask(task);
+            --num_tasks_;
+            return task;
+        }
+        void MercatorService::PopBatch(int index, TaskBatch& batch)
+        {
+            // Should be called with locked mutex
+            Task * first = PopTask(index);
+            if (!first)
+                return;
+            batch.push_back(first);
+            // Gather compatible tasks from all workers, they are at the top of queues
+            // since queues are ordered by type and LOD first
+            for (std::vector<Worker*>::iterator it = workers_.begin(); it != workers_.end(); ++it)
+            {
+                TaskQueue& queue = (*it)->tasks;
+                while (batch.size() < kMaxBatchSize && !queue.empty() && queue.Top()->IsBatchableWith(first))
+                {
+                    Task * task = queue.Pop();
+                    EraseNodeTask(task);
+                    --num_tasks_;
+                    batch.push_back(task);
+                }
+            }
+        }
+        void MercatorService::EraseNodeTask(Task * task)
+        {
+            // Should be called with locked mutex
+            std::pair<NodeTaskMap::iterator, NodeTaskMap::iterator> range = node_tasks_.equal_range(task->node());
+            for (NodeTaskMap::iterator it = range.first; it != range.second; ++it)
+            {
+                if (it->second == task)
+                {
+                    node_tasks_.erase(it);
+                    break;
+                }
+            }
+        }
+		void MercatorService::ThreadFunc(int index)
 		{
-			Task * task = NULL;
+			TaskBatch& batch = workers_[index]->processed_tasks;
 			bool finishing = false;
 			for (;;)
 			{
 				{//---
 					boost::lock_guard<boost::mutex> guard(mutex_);
 					finishing = finishing_;
-					if (task)
+					for (TaskBatch::iterator it = batch.begin(); it != batch.end(); ++it)
 					{
-						done_tasks_.push_back(task);
+						Task * task = *it;
+						if (task->IsCancelled())
+							delete task; // node doesn't need this task anymore
+						else
+							done_tasks_.push_back(task);
 					}
-                    if (!tasks_.empty())
-                    {
-                        task = tasks_.front();
-                        tasks_.pop_front();
-                        processed_node_ = task->node();
-                    }
-                    else
-                    {
-                    	task = NULL;
-                    	processed_node_ = NULL;
-                    }
+					batch.clear();
+                    PopBatch(index, batch);
 				}//---
 
 				if (finishing)
+				{
+					// Tasks have been taken but won't be executed
+					for (TaskBatch::iterator it = batch.begin(); it != batch.end(); ++it)
+						delete *it;
+					batch.clear();
 					break;
+				}
 
-				if (!task)
+				if (batch.empty())
 				{
 					boost::unique_lock<boost::mutex> guard(mutex_);
-					while (!finishing_ && tasks_.empty())
+					while (!finishing_ && num_tasks_ == 0)
 						condition_variable_.wait(guard);
 					continue;
 				}
 
-				task->Execute();
+				if (batch.size() == 1)
+					batch.front()->Execute();
+				else
+					batch.front()->ExecuteBatch(batch);
 			}
 		}
 
     } // namespace terrain
-} // namespace mgn
\ No newline at end of file
+} // namespace mgn
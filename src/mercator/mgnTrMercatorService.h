@@ -3,21 +3,32 @@
 #define __MGN_TERRAIN_MERCATOR_SERVICE_H__
 
 #include "mgnTrMercatorTask.h"
+#include "mgnTrMercatorTaskQueue.h"
 
 #include <boost/thread/mutex.hpp>
 #include <boost/thread/condition_variable.hpp>
 #include <boost/thread/thread.hpp>
+#include <boost/unordered_map.hpp>
 
 #include <list>
+#include <vector>
 
 namespace mgn {
     namespace terrain {
 
+    	/*! Mercator service class.
+    	** Tasks are executed by several worker threads. Each worker owns its own priority queue,
+    	** new tasks are distributed between workers in round-robin order. Idle worker
+    	** steals the most important task among other workers' queues, thus single slow
+    	** provider call doesn't block the rest of the tasks.
+    	** Queued tasks of the same kind and LOD are coalesced into a batch and fetched
+    	** from provider by a single call.
+    	*/
     	class MercatorService {
 		public:
 			typedef std::list<Task*> TaskList;
 
-			MercatorService();
+			explicit MercatorService(int num_workers = 1);
 			virtual ~MercatorService();
 
 			void RunService();
@@ -26,22 +37,38 @@ namespace mgn {
 			void ClearTasks();
             void AddTask(Task * task);
             bool GetDoneTasks(TaskList& task_list);
-            bool RemoveAllNodeTasks(MercatorNode * node);
-            void SortTasks();
+            void CancelAllNodeTasks(MercatorNode * node);
+            void UpdateNodePriority(MercatorNode * node, float priority);
+            void PromoteNodeTasks(MercatorNode * node);
+            void RefreshPriorities();
+
+            int num_workers() const;
 
 		private:
 			MercatorService(MercatorService&);
 			MercatorService& operator=(MercatorService&);
 
-			void ThreadFunc();
+			typedef boost::unordered_multimap<MercatorNode*, Task*> NodeTaskMap;
+
+			struct Worker {
+				TaskQueue tasks;
+				TaskBatch processed_tasks; //!< batch of tasks being executed by this worker
+			};
+
+			void ThreadFunc(int index);
+			Task * PopTask(int index);
+			void PopBatch(int index, TaskBatch& batch);
+			void EraseNodeTask(Task * task);
 
 			boost::mutex mutex_;
 			boost::condition_variable condition_variable_;
-			boost::thread thread_;
+			boost::thread_group threads_;
 
-            TaskList tasks_;
+            std::vector<Worker*> workers_;
+            NodeTaskMap node_tasks_;    //!< queued tasks indexed by node
             TaskList done_tasks_;
-            MercatorNode * processed_node_;
+            int num_tasks_;     //!< total number of tasks in all worker queues
+            int next_worker_;   //!< worker to receive the next task
 
 			bool finishing_;
 		};
@@ -49,4 +76,4 @@ namespace mgn {
     } // namespace terrain
 } // namespace mgn
 
-#endif
\ No newline at end of file
+#endif
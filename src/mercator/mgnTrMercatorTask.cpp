@@ -1,11 +1,24 @@
 #include "mgnTrMercatorTask.h"
 
+#include "mgnTrMercatorNode.h"
+
+#include <cstddef>
+
 namespace mgn {
     namespace terrain {
 
-        Task::Task(MercatorNode * node, int type)
+        Task::Task(MercatorNode * node, int type, int kind)
         : node_(node)
         , type_(type)
+        , kind_(kind)
+        , lod_(node->lod())
+        , x_(node->x())
+        , y_(node->y())
+        , generation_(node->generation())
+        , priority_(node->GetPriority())
+        , prefetch_(node->IsPrefetch())
+        , queue_(NULL)
+        , queue_index_(-1)
         {
         }
         Task::~Task()
@@ -19,6 +32,43 @@ namespace mgn {
         {
             return type_;
         }
+        int Task::kind() const
+        {
+            return kind_;
+        }
+        int Task::lod() const
+        {
+            return lod_;
+        }
+        float Task::priority() const
+        {
+            return priority_;
+        }
+        unsigned int Task::generation() const
+        {
+            return generation_;
+        }
+        bool Task::IsPrefetch() const
+        {
+            return prefetch_;
+        }
+        void Task::Cancel()
+        {
+            cancellation_token_.Cancel();
+        }
+        bool Task::IsCancelled() const
+        {
+            return cancellation_token_.IsCancelled();
+        }
+        bool Task::IsBatchableWith(const Task * other) const
+        {
+            return kind_ == other->kind_ && lod_ == other->lod_;
+        }
+        void Task::ExecuteBatch(const TaskBatch& batch)
+        {
+            for (TaskBatch::const_iterator it = batch.begin(); it != batch.end(); ++it)
+                (*it)->Execute();
+        }
         TaskNodeMatchFunctor::TaskNodeMatchFunctor(MercatorNode * node)
         : node_(node)
         {
@@ -28,6 +78,19 @@ namespace mgn {
         {
             return task->node() == node_;
         }
+        bool TaskNodeCompareFunctor::operator()(const Task * task1, const Task * task2) const
+        {
+            // Speculative tasks are done only when there is nothing else to do
+            if (task1->prefetch_ != task2->prefetch_)
+                return task2->prefetch_;
+            // Textures have first priority for fetch
+            else if (task1->type_ != task2->type_)
+                return task1->type_ < task2->type_; // texture over other requests
+            else if (task1->lod_ != task2->lod_)
+                return task1->lod_ < task2->lod_; // lower LOD priority
+            else
+                return task1->priority_ > task2->priority_;
+        }
 
     } // namespace terrain
-} // namespace mgn
\ No newline at end of file
+} // namespace mgn
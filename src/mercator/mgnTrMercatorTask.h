@@ -2,6 +2,10 @@
 #ifndef __MGN_TERRAIN_MERCATOR_TASK_H__
 #define __MGN_TERRAIN_MERCATOR_TASK_H__
 
+#include "mgnTrMercatorDataInfo.h"
+
+#include <vector>
+
 namespace mgn {
     namespace terrain {
 
@@ -12,24 +16,66 @@ namespace mgn {
             REQUEST_ICONS
         };
 
+        //! Task kinds, tasks of the same kind and LOD may be executed in a single batch
+        enum MercatorTaskKind {
+            TASK_TEXTURE,
+            TASK_TEXTURE_LABELS,
+            TASK_HEIGHTMAP,
+            TASK_LABELS,
+            TASK_ICONS
+        };
+
         // Forward declarations
         class MercatorNode;
+        class TaskQueue;
+        class Task;
+
+        typedef std::vector<Task*> TaskBatch;
 
         //! Base task class
         class Task {
+            friend class TaskQueue;
+            friend class MercatorService;
+            friend class TaskNodeCompareFunctor;
         public:
-            Task(MercatorNode * node, int type);
+            Task(MercatorNode * node, int type, int kind);
             virtual ~Task();
 
             MercatorNode * node() const;
             int type() const;
+            int kind() const;
+            int lod() const;
+            float priority() const;
+            unsigned int generation() const;
+            bool IsPrefetch() const;
 
-            virtual void Execute() = 0; //!< target task, done on service thread
+            void Cancel();
+            bool IsCancelled() const;
+
+            //! Returns true if tasks may be executed in the same batch
+            bool IsBatchableWith(const Task * other) const;
+
+            //! Target task, done on service thread. Shouldn't access node, it may be destroyed meanwhile.
+            virtual void Execute() = 0;
+            //! Executes batch of tasks of the same kind (including this one), done on service thread
+            virtual void ExecuteBatch(const TaskBatch& batch);
             virtual void Process() = 0; //!< data processing after task is completed, done on main thread
 
         protected:
             MercatorNode * node_;
             int type_;
+            int kind_;
+            int lod_;           //!< node's LOD at the moment of creation
+            int x_;
+            int y_;
+            CancellationToken cancellation_token_;
+
+        private:
+            unsigned int generation_; //!< node's generation at the moment of creation
+            float priority_;    //!< cached node priority, changed only via queue
+            bool prefetch_;     //!< speculative task, executed after all the others
+            TaskQueue * queue_; //!< queue containing this task
+            int queue_index_;   //!< position in queue's heap
         };
 
         //! Functor for node matching
@@ -42,13 +88,13 @@ namespace mgn {
             MercatorNode * node_;
         };
 
-        //! Functor for node matching
+        //! Functor for task ordering, returns true if first task is more important
         class TaskNodeCompareFunctor {
         public:
-            bool operator()(Task * task1, Task * task2) const;
+            bool operator()(const Task * task1, const Task * task2) const;
         };
 
     } // namespace terrain
 } // namespace mgn
 
-#endif
\ No newline at end of file
+#endif
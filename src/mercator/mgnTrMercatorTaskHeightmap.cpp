@@ -2,13 +2,15 @@
 
 #include "mgnTrMercatorNode.h"
 #include "mgnTrMercatorProvider.h"
+#include "mgnTrMercatorTileStore.h"
 
 namespace mgn {
     namespace terrain {
 
-        HeightmapTask::HeightmapTask(MercatorNode * node, MercatorProvider * provider)
-        : Task(node, REQUEST_HEIGHTMAP)
+        HeightmapTask::HeightmapTask(MercatorNode * node, MercatorProvider * provider, MercatorTileStore * tile_store)
+        : Task(node, REQUEST_HEIGHTMAP, TASK_HEIGHTMAP)
         , provider_(provider)
+        , tile_store_(tile_store)
         , has_errors_(false)
         {
         }
@@ -17,20 +19,70 @@ namespace mgn {
         }
         void HeightmapTask::Execute()
         {
-            MercatorProvider::HeightmapInfo heightmap_info;
-            heightmap_info.key_x = node_->x();
-            heightmap_info.key_y = node_->y();
-            heightmap_info.key_z = node_->lod();
-            heightmap_info.image = &image_;
-            heightmap_info.errors_occured = false;
+            if (!tile_store_->LoadHeightmap(PackedTileKey(lod_, x_, y_), image_))
+            {
+                MercatorProvider::HeightmapInfo heightmap_info;
+                FillInfo(heightmap_info);
+
+                provider_->GetHeightmap(heightmap_info);
+
+                has_errors_ = heightmap_info.errors_occured;
+                StoreResult();
+            }
+            BuildHeightData();
+        }
+        void HeightmapTask::ExecuteBatch(const TaskBatch& batch)
+        {
+            // Only tiles missing in store are requested from provider
+            std::vector<HeightmapTask*> tasks;
+            for (TaskBatch::const_iterator it = batch.begin(); it != batch.end(); ++it)
+            {
+                HeightmapTask * task = static_cast<HeightmapTask*>(*it);
+                if (tile_store_->LoadHeightmap(PackedTileKey(task->lod_, task->x_, task->y_), task->image_))
+                    task->BuildHeightData();
+                else
+                    tasks.push_back(task);
+            }
+            if (tasks.empty())
+                return;
 
-            provider_->GetHeightmap(heightmap_info);
+            std::vector<MercatorProvider::HeightmapInfo> infos(tasks.size());
+            for (size_t i = 0; i < tasks.size(); ++i)
+                tasks[i]->FillInfo(infos[i]);
 
-            has_errors_ = heightmap_info.errors_occured;
+            provider_->GetHeightmapBatch(infos);
+
+            for (size_t i = 0; i < tasks.size(); ++i)
+            {
+                tasks[i]->has_errors_ = infos[i].errors_occured;
+                tasks[i]->StoreResult();
+                tasks[i]->BuildHeightData();
+            }
         }
         void HeightmapTask::Process()
         {
-            node_->OnHeightmapTaskCompleted(image_, has_errors_);
+            node_->OnHeightmapTaskCompleted(image_, height_data_, has_errors_);
+        }
+        void HeightmapTask::FillInfo(MercatorProvider::HeightmapInfo& heightmap_info)
+        {
+            heightmap_info.key_x = x_;
+            heightmap_info.key_y = y_;
+            heightmap_info.key_z = lod_;
+            heightmap_info.image = &image_;
+            heightmap_info.cancellation_token = &cancellation_token_;
+            heightmap_info.errors_occured = false;
+        }
+        void HeightmapTask::StoreResult()
+        {
+            // Abandoned requests may return incomplete data
+            if (!has_errors_ && !IsCancelled())
+                tile_store_->SaveHeightmap(PackedTileKey(lod_, x_, y_), image_);
+        }
+        void HeightmapTask::BuildHeightData()
+        {
+            // Decoding and min/max pyramid are kept off the render thread
+            if (!IsCancelled())
+                height_data_.Build(image_);
         }
 
     } // namespace terrain
@@ -3,26 +3,36 @@
 #define __MGN_TERRAIN_MERCATOR_TASK_HEIGHTMAP_H__
 
 #include "mgnTrMercatorTask.h"
+#include "mgnTrMercatorProvider.h"
+#include "mgnTrMercatorHeightData.h"
 
 #include "MapDrawing/Graphics/mgnImage.h"
 
 namespace mgn {
     namespace terrain {
 
-        class MercatorProvider;
+        // Forward declarations
+        class MercatorTileStore;
 
         //! Heightmap task class
         class HeightmapTask : public Task {
         public:
-            HeightmapTask(MercatorNode * node, MercatorProvider * provider);
+            HeightmapTask(MercatorNode * node, MercatorProvider * provider, MercatorTileStore * tile_store);
             ~HeightmapTask();
 
             void Execute(); /* override */
+            void ExecuteBatch(const TaskBatch& batch); /* override */
             void Process(); /* override */
 
         private:
+            void FillInfo(MercatorProvider::HeightmapInfo& heightmap_info);
+            void StoreResult();
+            void BuildHeightData();
+
             MercatorProvider * provider_;
+            MercatorTileStore * tile_store_;
             graphics::Image image_;
+            MercatorHeightData height_data_; //!< decoded on worker thread, handed over to map tile
             bool has_errors_;
         };
 
@@ -4,13 +4,17 @@
 #include "mgnTrMercatorProvider.h"
 #include "mgnTrMercatorTileContext.h"
 
+#include <cmath>
+#include <set>
+
 namespace mgn {
     namespace terrain {
 
         IconsTask::IconsTask(MercatorNode * node, MercatorProvider * provider,
             const mgnMdWorldPosition * gps_position)
-        : Task(node, REQUEST_ICONS)
+        : Task(node, REQUEST_ICONS, TASK_ICONS)
         , provider_(provider)
+        , terrain_view_(node->terrain_view())
         , gps_position_(gps_position)
         , has_errors_(false)
         {
@@ -21,24 +25,109 @@ namespace mgn {
         void IconsTask::Execute()
         {
             MercatorProvider::IconsInfo icons_info;
-            icons_info.key_x = node_->x();
-            icons_info.key_y = node_->y();
-            icons_info.key_z = node_->lod();
-            icons_info.icons_data = &icons_data_;
-            icons_info.errors_occured = false;
+            FillInfo(icons_info);
 
-            const mgnMdTerrainView * terrain_view = node_->terrain_view();
-            MercatorTileContext context(terrain_view, gps_position_,
-                node_->x(), node_->y(), node_->lod());
+            MercatorTileContext context(terrain_view_, gps_position_, x_, y_, lod_);
 
             provider_->GetIcons(icons_info, context);
 
             has_errors_ = icons_info.errors_occured;
+            PrepareIcons();
+        }
+        void IconsTask::ExecuteBatch(const TaskBatch& batch)
+        {
+            std::vector<MercatorProvider::IconsInfo> infos(batch.size());
+            std::vector<MercatorTileContext*> tile_contexts(batch.size());
+            std::vector<const mgnMdIUserDataDrawContext*> contexts(batch.size());
+            for (size_t i = 0; i < batch.size(); ++i)
+            {
+                IconsTask * task = static_cast<IconsTask*>(batch[i]);
+                task->FillInfo(infos[i]);
+                tile_contexts[i] = new MercatorTileContext(task->terrain_view_, task->gps_position_,
+                    task->x_, task->y_, task->lod_);
+                contexts[i] = tile_contexts[i];
+            }
+
+            provider_->GetIconsBatch(infos, contexts);
+
+            for (size_t i = 0; i < batch.size(); ++i)
+            {
+                IconsTask * task = static_cast<IconsTask*>(batch[i]);
+                task->has_errors_ = infos[i].errors_occured;
+                task->PrepareIcons();
+                delete tile_contexts[i];
+            }
         }
         void IconsTask::Process()
         {
             node_->OnIconsTaskCompleted(icons_data_, has_errors_);
         }
+        void IconsTask::FillInfo(MercatorProvider::IconsInfo& icons_info)
+        {
+            icons_info.key_x = x_;
+            icons_info.key_y = y_;
+            icons_info.key_z = lod_;
+            icons_info.icons_data = &icons_data_;
+            icons_info.cancellation_token = &cancellation_token_;
+            icons_info.errors_occured = false;
+        }
+        void IconsTask::PrepareIcons()
+        {
+            // Icons are filtered and their bitmaps are made ready for upload here,
+            // so render thread only creates textures
+            if (IsCancelled())
+                return;
+
+            // Filter out duplicates (POIs that stand in the same position), the last one is kept
+            // Precision is equal to 2 pixels in chosen LOD (in degrees)
+            const double kPrecision = 2.0 * 360.0 / static_cast<double>(256 << lod_);
+            size_t num_icons = 0;
+            for (size_t i = 0; i < icons_data_.size(); ++i)
+            {
+                const IconData & data = icons_data_[i];
+                bool has_duplicate = false;
+                for (size_t j = i + 1; j < icons_data_.size(); ++j)
+                {
+                    const IconData & other_data = icons_data_[j];
+                    if (fabs(data.latitude - other_data.latitude) < kPrecision &&
+                        fabs(data.longitude - other_data.longitude) < kPrecision) // the same position
+                    {
+                        has_duplicate = true;
+                        break;
+                    }
+                }
+                if (has_duplicate)
+                    continue;
+                if (num_icons != i)
+                {
+                    // Move bitmap instead of copying it
+                    std::vector<unsigned char> bitmap_data;
+                    bitmap_data.swap(icons_data_[i].bitmap_data);
+                    icons_data_[num_icons] = icons_data_[i];
+                    icons_data_[num_icons].bitmap_data.swap(bitmap_data);
+                }
+                ++num_icons;
+            }
+            icons_data_.resize(num_icons);
+
+            // The same bitmap is uploaded once per tile
+            std::set<size_t> hashes;
+            for (std::vector<IconData>::iterator it = icons_data_.begin(); it != icons_data_.end(); ++it)
+            {
+                IconData & data = *it;
+                if (!hashes.insert(data.hash).second)
+                {
+                    // Texture is created from the first icon with this hash
+                    std::vector<unsigned char>().swap(data.bitmap_data);
+                    data.bitmap_width = 0;
+                    data.bitmap_height = 0;
+                    continue;
+                }
+                // Atlas pages aren't mipmapped, so bitmap keeps its size
+                data.bitmap_width = data.width;
+                data.bitmap_height = data.height;
+            }
+        }
 
     } // namespace terrain
-} // namespace mgn
\ No newline at end of file
+} // namespace mgn
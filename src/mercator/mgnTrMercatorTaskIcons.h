@@ -3,16 +3,16 @@
 #define __MGN_TERRAIN_MERCATOR_TASK_ICONS_H__
 
 #include "mgnTrMercatorTask.h"
+#include "mgnTrMercatorProvider.h"
 
 #include "mgnTrMercatorDataInfo.h"
 
 class mgnMdWorldPosition;
+class mgnMdTerrainView;
 
 namespace mgn {
     namespace terrain {
 
-        class MercatorProvider;
-
         //! Icons task class
         class IconsTask : public Task {
         public:
@@ -21,10 +21,15 @@ namespace mgn {
             ~IconsTask();
 
             void Execute(); /* override */
+            void ExecuteBatch(const TaskBatch& batch); /* override */
             void Process(); /* override */
 
         private:
+            void FillInfo(MercatorProvider::IconsInfo& icons_info);
+            void PrepareIcons();
+
             MercatorProvider * provider_;
+            const mgnMdTerrainView * terrain_view_;
             const mgnMdWorldPosition * gps_position_;
             std::vector<IconData> icons_data_;
             bool has_errors_;
@@ -7,30 +7,61 @@ namespace mgn {
     namespace terrain {
 
         LabelsTask::LabelsTask(MercatorNode * node, MercatorProvider * provider)
-        : Task(node, REQUEST_LABELS)
+        : Task(node, REQUEST_LABELS, TASK_LABELS)
         , provider_(provider)
+        , terrain_view_(node->terrain_view())
+        , font_(node->font())
         , has_errors_(false)
         {
         }
         LabelsTask::~LabelsTask()
         {
+            // Labels created from geometries have taken their references
+            ReleaseLabels(geometries_);
         }
         void LabelsTask::Execute()
         {
             MercatorProvider::LabelsInfo labels_info;
-            labels_info.key_x = node_->x();
-            labels_info.key_y = node_->y();
-            labels_info.key_z = node_->lod();
-            labels_info.labels_data = &labels_data_;
-            labels_info.errors_occured = false;
+            FillInfo(labels_info);
 
             provider_->GetLabels(labels_info);
 
             has_errors_ = labels_info.errors_occured;
+            PrepareLabels();
+        }
+        void LabelsTask::ExecuteBatch(const TaskBatch& batch)
+        {
+            std::vector<MercatorProvider::LabelsInfo> infos(batch.size());
+            for (size_t i = 0; i < batch.size(); ++i)
+                static_cast<LabelsTask*>(batch[i])->FillInfo(infos[i]);
+
+            provider_->GetLabelsBatch(infos);
+
+            for (size_t i = 0; i < batch.size(); ++i)
+            {
+                LabelsTask * task = static_cast<LabelsTask*>(batch[i]);
+                task->has_errors_ = infos[i].errors_occured;
+                task->PrepareLabels();
+            }
         }
         void LabelsTask::Process()
         {
-            node_->OnLabelsTaskCompleted(labels_data_, has_errors_);
+            node_->OnLabelsTaskCompleted(labels_data_, geometries_, has_errors_);
+        }
+        void LabelsTask::FillInfo(MercatorProvider::LabelsInfo& labels_info)
+        {
+            labels_info.key_x = x_;
+            labels_info.key_y = y_;
+            labels_info.key_z = lod_;
+            labels_info.labels_data = &labels_data_;
+            labels_info.cancellation_token = &cancellation_token_;
+            labels_info.errors_occured = false;
+        }
+        void LabelsTask::PrepareLabels()
+        {
+            // Label meshes are built here, so render thread only uploads them
+            if (!IsCancelled())
+                terrain::PrepareLabels(terrain_view_, font_, lod_, labels_data_, geometries_);
         }
 
     } // namespace terrain
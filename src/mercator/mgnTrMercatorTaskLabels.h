@@ -3,14 +3,17 @@
 #define __MGN_TERRAIN_MERCATOR_TASK_LABELS_H__
 
 #include "mgnTrMercatorTask.h"
+#include "mgnTrMercatorProvider.h"
 
 #include "mgnTrMercatorDataInfo.h"
 
+#include "../mgnTrLabelGeometry.h"
+
+class mgnMdTerrainView;
+
 namespace mgn {
     namespace terrain {
 
-        class MercatorProvider;
-
         //! Labels task class
         class LabelsTask : public Task {
         public:
@@ -18,11 +21,18 @@ namespace mgn {
             ~LabelsTask();
 
             void Execute(); /* override */
+            void ExecuteBatch(const TaskBatch& batch); /* override */
             void Process(); /* override */
 
         private:
+            void FillInfo(MercatorProvider::LabelsInfo& labels_info);
+            void PrepareLabels();
+
             MercatorProvider * provider_;
+            const mgnMdTerrainView * terrain_view_;
+            const Font * font_;
             std::vector<LabelData> labels_data_;
+            std::vector<LabelGeometry> geometries_;
             bool has_errors_;
         };
 
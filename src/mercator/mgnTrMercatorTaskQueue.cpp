@@ -0,0 +1,141 @@
+#include "mgnTrMercatorTaskQueue.h"
+
+#include "mgnTrMercatorTask.h"
+#include "mgnTrMercatorNode.h"
+
+#include <cstddef>
+#include <assert.h>
+
+namespace mgn {
+    namespace terrain {
+
+        TaskQueue::TaskQueue()
+        {
+        }
+        TaskQueue::~TaskQueue()
+        {
+        }
+        bool TaskQueue::empty() const
+        {
+            return heap_.empty();
+        }
+        int TaskQueue::size() const
+        {
+            return static_cast<int>(heap_.size());
+        }
+        void TaskQueue::Push(Task * task)
+        {
+            assert(task->queue_ == NULL);
+            task->queue_ = this;
+            task->queue_index_ = static_cast<int>(heap_.size());
+            heap_.push_back(task);
+            SiftUp(task->queue_index_);
+        }
+        Task * TaskQueue::Top() const
+        {
+            return (heap_.empty()) ? NULL : heap_.front();
+        }
+        Task * TaskQueue::Pop()
+        {
+            if (heap_.empty())
+                return NULL;
+            Task * task = heap_.front();
+            Remove(task);
+            return task;
+        }
+        void TaskQueue::Remove(Task * task)
+        {
+            assert(task->queue_ == this);
+            int index = task->queue_index_;
+            int last = static_cast<int>(heap_.size()) - 1;
+            if (index != last)
+            {
+                Swap(index, last);
+                heap_.pop_back();
+                // Moved element may go either direction
+                SiftUp(index);
+                SiftDown(index);
+            }
+            else
+                heap_.pop_back();
+            task->queue_ = NULL;
+            task->queue_index_ = -1;
+        }
+        void TaskQueue::Update(Task * task, float priority)
+        {
+            assert(task->queue_ == this);
+            float old_priority = task->priority_;
+            task->priority_ = priority;
+            if (priority > old_priority)
+                SiftUp(task->queue_index_);
+            else
+                SiftDown(task->queue_index_);
+        }
+        void TaskQueue::Promote(Task * task)
+        {
+            assert(task->queue_ == this);
+            task->prefetch_ = false;
+            SiftUp(task->queue_index_);
+        }
+        void TaskQueue::Release(std::vector<Task*>& tasks)
+        {
+            for (std::vector<Task*>::iterator it = heap_.begin(); it != heap_.end(); ++it)
+            {
+                Task * task = *it;
+                task->queue_ = NULL;
+                task->queue_index_ = -1;
+                tasks.push_back(task);
+            }
+            heap_.clear();
+        }
+        void TaskQueue::RefreshPriorities()
+        {
+            for (std::vector<Task*>::iterator it = heap_.begin(); it != heap_.end(); ++it)
+                (*it)->priority_ = (*it)->node()->GetPriority();
+            for (int i = static_cast<int>(heap_.size()) / 2 - 1; i >= 0; --i)
+                SiftDown(i);
+        }
+        bool TaskQueue::Less(int i, int j) const
+        {
+            return TaskNodeCompareFunctor()(heap_[i], heap_[j]);
+        }
+        void TaskQueue::Swap(int i, int j)
+        {
+            Task * task = heap_[i];
+            heap_[i] = heap_[j];
+            heap_[j] = task;
+            heap_[i]->queue_index_ = i;
+            heap_[j]->queue_index_ = j;
+        }
+        void TaskQueue::SiftUp(int index)
+        {
+            while (index > 0)
+            {
+                int parent = (index - 1) / 2;
+                if (!Less(index, parent))
+                    break;
+                Swap(index, parent);
+                index = parent;
+            }
+        }
+        void TaskQueue::SiftDown(int index)
+        {
+            const int size = static_cast<int>(heap_.size());
+            for (;;)
+            {
+                int left = 2 * index + 1;
+                if (left >= size)
+                    break;
+                int best = left;
+                int right = left + 1;
+                if (right < size && Less(right, left))
+                    best = right;
+                if (!Less(best, index))
+                    break;
+                Swap(index, best);
+                index = best;
+            }
+        }
+
+    } // namespace terrain
+} // namespace mgn
@@ -0,0 +1,60 @@
+#pragma once
+#ifndef __MGN_TERRAIN_MERCATOR_TASK_QUEUE_H__
+#define __MGN_TERRAIN_MERCATOR_TASK_QUEUE_H__
+
+#include <vector>
+
+namespace mgn {
+    namespace terrain {
+
+        // Forward declarations
+        class Task;
+
+        /*! Mercator task queue class.
+        ** Indexed binary heap of tasks ordered by (prefetch, type, lod, priority).
+        ** Each task stores its position in the heap, thus removal and priority change
+        ** are done in O(log n) without searching.
+        */
+        class TaskQueue {
+        public:
+            TaskQueue();
+            ~TaskQueue();
+
+            bool empty() const;
+            int size() const;
+
+            void Push(Task * task);
+            Task * Top() const;
+            Task * Pop();
+
+            //! Removes task from any position of the queue
+            void Remove(Task * task);
+
+            //! Updates position of the task after its priority has been changed
+            void Update(Task * task, float priority);
+
+            //! Turns speculative task into regular one and moves it up accordingly
+            void Promote(Task * task);
+
+            //! Moves all tasks out of the queue (queue becomes empty)
+            void Release(std::vector<Task*>& tasks);
+
+            //! Recomputes priorities of all tasks from their nodes and restores heap property, O(n)
+            void RefreshPriorities();
+
+        private:
+            TaskQueue(const TaskQueue&);
+            TaskQueue& operator=(const TaskQueue&);
+
+            bool Less(int i, int j) const;
+            void Swap(int i, int j);
+            void SiftUp(int index);
+            void SiftDown(int index);
+
+            std::vector<Task*> heap_;
+        };
+
+    } // namespace terrain
+} // namespace mgn
+
+#endif
@@ -2,13 +2,15 @@
 
 #include "mgnTrMercatorNode.h"
 #include "mgnTrMercatorProvider.h"
+#include "mgnTrMercatorTileStore.h"
 
 namespace mgn {
     namespace terrain {
 
-        TextureTask::TextureTask(MercatorNode * node, MercatorProvider * provider)
-        : Task(node, REQUEST_TEXTURE)
+        TextureTask::TextureTask(MercatorNode * node, MercatorProvider * provider, MercatorTileStore * tile_store)
+        : Task(node, REQUEST_TEXTURE, TASK_TEXTURE)
         , provider_(provider)
+        , tile_store_(tile_store)
         , has_errors_(false)
         {
         }
@@ -17,21 +19,61 @@ namespace mgn {
         }
         void TextureTask::Execute()
         {
+            if (tile_store_->LoadTexture(PackedTileKey(lod_, x_, y_), image_))
+                return;
+
             MercatorProvider::TextureInfo texture_info;
-            texture_info.key_x = node_->x();
-            texture_info.key_y = node_->y();
-            texture_info.key_z = node_->lod();
-            texture_info.image = &image_;
-            texture_info.errors_occured = false;
+            FillInfo(texture_info);
 
             provider_->GetTexture(texture_info);
 
             has_errors_ = texture_info.errors_occured;
+            StoreResult();
+        }
+        void TextureTask::ExecuteBatch(const TaskBatch& batch)
+        {
+            // Only tiles missing in store are requested from provider
+            std::vector<TextureTask*> tasks;
+            for (TaskBatch::const_iterator it = batch.begin(); it != batch.end(); ++it)
+            {
+                TextureTask * task = static_cast<TextureTask*>(*it);
+                if (!tile_store_->LoadTexture(PackedTileKey(task->lod_, task->x_, task->y_), task->image_))
+                    tasks.push_back(task);
+            }
+            if (tasks.empty())
+                return;
+
+            std::vector<MercatorProvider::TextureInfo> infos(tasks.size());
+            for (size_t i = 0; i < tasks.size(); ++i)
+                tasks[i]->FillInfo(infos[i]);
+
+            provider_->GetTextureBatch(infos);
+
+            for (size_t i = 0; i < tasks.size(); ++i)
+            {
+                tasks[i]->has_errors_ = infos[i].errors_occured;
+                tasks[i]->StoreResult();
+            }
         }
         void TextureTask::Process()
         {
             node_->OnTextureTaskCompleted(image_, has_errors_);
         }
+        void TextureTask::FillInfo(MercatorProvider::TextureInfo& texture_info)
+        {
+            texture_info.key_x = x_;
+            texture_info.key_y = y_;
+            texture_info.key_z = lod_;
+            texture_info.image = &image_;
+            texture_info.cancellation_token = &cancellation_token_;
+            texture_info.errors_occured = false;
+        }
+        void TextureTask::StoreResult()
+        {
+            // Abandoned requests may return incomplete data
+            if (!has_errors_ && !IsCancelled())
+                tile_store_->SaveTexture(PackedTileKey(lod_, x_, y_), image_);
+        }
 
     } // namespace terrain
 } // namespace mgn
\ No newline at end of file
@@ -3,25 +3,32 @@
 #define __MGN_TERRAIN_MERCATOR_TASK_TEXTURE_H__
 
 #include "mgnTrMercatorTask.h"
+#include "mgnTrMercatorProvider.h"
 
 #include "MapDrawing/Graphics/mgnImage.h"
 
 namespace mgn {
     namespace terrain {
 
-        class MercatorProvider;
+        // Forward declarations
+        class MercatorTileStore;
 
         //! Texture task class
         class TextureTask : public Task {
         public:
-            TextureTask(MercatorNode * node, MercatorProvider * provider);
+            TextureTask(MercatorNode * node, MercatorProvider * provider, MercatorTileStore * tile_store);
             ~TextureTask();
 
             void Execute(); /* override */
+            void ExecuteBatch(const TaskBatch& batch); /* override */
             void Process(); /* override */
 
         private:
+            void FillInfo(MercatorProvider::TextureInfo& texture_info);
+            void StoreResult();
+
             MercatorProvider * provider_;
+            MercatorTileStore * tile_store_;
             graphics::Image image_;
             bool has_errors_;
         };
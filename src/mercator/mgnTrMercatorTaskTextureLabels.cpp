@@ -2,38 +2,79 @@
 
 #include "mgnTrMercatorNode.h"
 #include "mgnTrMercatorProvider.h"
+#include "mgnTrMercatorTileStore.h"
 
 namespace mgn {
     namespace terrain {
 
-        TextureLabelsTask::TextureLabelsTask(MercatorNode * node, MercatorProvider * provider)
-        : Task(node, REQUEST_TEXTURE)
+        TextureLabelsTask::TextureLabelsTask(MercatorNode * node, MercatorProvider * provider, MercatorTileStore * tile_store)
+        : Task(node, REQUEST_TEXTURE, TASK_TEXTURE_LABELS)
         , provider_(provider)
+        , tile_store_(tile_store)
+        , terrain_view_(node->terrain_view())
+        , font_(node->font())
         , has_errors_(false)
         {
         }
         TextureLabelsTask::~TextureLabelsTask()
         {
+            // Labels created from geometries have taken their references
+            ReleaseLabels(geometries_);
         }
         void TextureLabelsTask::Execute()
         {
             MercatorProvider::TextureLabelsInfo tl_info;
-            tl_info.key_x = node_->x();
-            tl_info.key_y = node_->y();
-            tl_info.key_z = node_->lod();
-            tl_info.image = &image_;
-            tl_info.labels_data = &labels_data_;
-            tl_info.need_image = true;
-            tl_info.need_labels = true;
-            tl_info.errors_occured = false;
+            FillInfo(tl_info);
 
             provider_->GetTextureAndLabels(tl_info);
 
             has_errors_ = tl_info.errors_occured;
+            StoreResult(tl_info);
+            PrepareLabels();
+        }
+        void TextureLabelsTask::ExecuteBatch(const TaskBatch& batch)
+        {
+            std::vector<MercatorProvider::TextureLabelsInfo> infos(batch.size());
+            for (size_t i = 0; i < batch.size(); ++i)
+                static_cast<TextureLabelsTask*>(batch[i])->FillInfo(infos[i]);
+
+            provider_->GetTextureAndLabelsBatch(infos);
+
+            for (size_t i = 0; i < batch.size(); ++i)
+            {
+                TextureLabelsTask * task = static_cast<TextureLabelsTask*>(batch[i]);
+                task->has_errors_ = infos[i].errors_occured;
+                task->StoreResult(infos[i]);
+                task->PrepareLabels();
+            }
         }
         void TextureLabelsTask::Process()
         {
-            node_->OnTextureLabelsTaskCompleted(image_, labels_data_, has_errors_);
+            node_->OnTextureLabelsTaskCompleted(image_, labels_data_, geometries_, has_errors_);
+        }
+        void TextureLabelsTask::FillInfo(MercatorProvider::TextureLabelsInfo& tl_info)
+        {
+            tl_info.key_x = x_;
+            tl_info.key_y = y_;
+            tl_info.key_z = lod_;
+            tl_info.image = &image_;
+            tl_info.labels_data = &labels_data_;
+            // Labels aren't stored, so only the image may be taken from store
+            tl_info.need_image = !tile_store_->LoadTexture(PackedTileKey(lod_, x_, y_), image_);
+            tl_info.need_labels = true;
+            tl_info.cancellation_token = &cancellation_token_;
+            tl_info.errors_occured = false;
+        }
+        void TextureLabelsTask::StoreResult(const MercatorProvider::TextureLabelsInfo& tl_info)
+        {
+            if (tl_info.need_image && !has_errors_ && !IsCancelled())
+                tile_store_->SaveTexture(PackedTileKey(lod_, x_, y_), image_);
+        }
+        void TextureLabelsTask::PrepareLabels()
+        {
+            // Label meshes are built here, so render thread only uploads them
+            if (!IsCancelled())
+                terrain::PrepareLabels(terrain_view_, font_, lod_, labels_data_, geometries_);
         }
 
     } // namespace terrain
@@ -3,29 +3,44 @@
 #define __MGN_TERRAIN_MERCATOR_TASK_TEXTURE_LABELS_H__
 
 #include "mgnTrMercatorTask.h"
+#include "mgnTrMercatorProvider.h"
 
 #include "mgnTrMercatorDataInfo.h"
 
+#include "../mgnTrLabelGeometry.h"
+
 #include "MapDrawing/Graphics/mgnImage.h"
 
+class mgnMdTerrainView;
+
 namespace mgn {
     namespace terrain {
 
-        class MercatorProvider;
+        // Forward declarations
+        class MercatorTileStore;
 
         //! Texture and labels task class
         class TextureLabelsTask : public Task {
         public:
-            TextureLabelsTask(MercatorNode * node, MercatorProvider * provider);
+            TextureLabelsTask(MercatorNode * node, MercatorProvider * provider, MercatorTileStore * tile_store);
             ~TextureLabelsTask();
 
             void Execute(); /* override */
+            void ExecuteBatch(const TaskBatch& batch); /* override */
             void Process(); /* override */
 
         private:
+            void FillInfo(MercatorProvider::TextureLabelsInfo& tl_info);
+            void StoreResult(const MercatorProvider::TextureLabelsInfo& tl_info);
+            void PrepareLabels();
+
             MercatorProvider * provider_;
+            MercatorTileStore * tile_store_;
+            const mgnMdTerrainView * terrain_view_;
+            const Font * font_;
             graphics::Image image_;
             std::vector<LabelData> labels_data_;
+            std::vector<LabelGeometry> geometries_;
             bool has_errors_;
         };
 
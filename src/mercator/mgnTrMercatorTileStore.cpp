@@ -0,0 +1,391 @@
+#include "mgnTrMercatorTileStore.h"
+
+#include "MapDrawing/Graphics/mgnImage.h"
+
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+#include <boost/thread/locks.hpp>
+
+#include <algorithm>
+#include <cstring>
+
+namespace {
+    const boost::uint32_t kRecordMagic = 0x4D545331; // 'MTS1'
+    const int kMaxRunLength = 128;
+}
+
+namespace mgn {
+    namespace terrain {
+
+        MercatorTileStore::MercatorTileStore()
+        : file_(NULL)
+        , mapped_size_(0)
+        , file_size_(0)
+        , max_size_(0)
+        , version_(0)
+        {
+        }
+        MercatorTileStore::~MercatorTileStore()
+        {
+            Close();
+        }
+        bool MercatorTileStore::Open(const std::string& filename, unsigned int version, size_t max_size)
+        {
+            Close();
+            boost::lock_guard<boost::mutex> guard(mutex_);
+            filename_ = filename;
+            version_ = version;
+            max_size_ = max_size;
+
+            file_ = std::fopen(filename.c_str(), "r+b");
+            if (file_)
+            {
+                std::fseek(file_, 0, SEEK_END);
+                file_size_ = static_cast<size_t>(std::ftell(file_));
+                if (file_size_ != 0 && Remap())
+                {
+                    const unsigned char * data = static_cast<const unsigned char*>(region_->get_address());
+                    size_t valid_size = ScanRecords(data, mapped_size_);
+                    // Records are appended right after the last complete one
+                    file_size_ = valid_size;
+                    // Space of other versions is reclaimed, otherwise pack would stay full forever
+                    if (file_size_ > max_size_)
+                        Compact(max_size_ / 2);
+                    else if (GetLiveSize() < file_size_)
+                        Compact(max_size_);
+                }
+            }
+            if (!file_)
+            {
+                file_ = std::fopen(filename.c_str(), "w+b");
+                if (!file_)
+                    return false;
+                file_size_ = 0;
+            }
+            std::fseek(file_, static_cast<long>(file_size_), SEEK_SET);
+            return true;
+        }
+        void MercatorTileStore::Close()
+        {
+            boost::lock_guard<boost::mutex> guard(mutex_);
+            if (file_)
+            {
+                std::fclose(file_);
+                file_ = NULL;
+            }
+            region_.reset();
+            mapped_size_ = 0;
+            file_size_ = 0;
+            for (int i = 0; i < kNumRecordTypes; ++i)
+                records_[i].clear();
+        }
+        bool MercatorTileStore::IsOpen() const
+        {
+            return file_ != NULL;
+        }
+        bool MercatorTileStore::LoadTexture(const PackedTileKey& key, graphics::Image& image)
+        {
+            Record record;
+            RegionPtr region;
+            if (!Find(RECORD_TEXTURE, key, record, region))
+                return false;
+            const RecordHeader& header = record.header;
+            const unsigned char * data = static_cast<const unsigned char*>(region->get_address())
+                + record.offset + sizeof(RecordHeader);
+            unsigned char * pixels = image.Allocate(header.width, header.height,
+                static_cast<graphics::Image::Format>(header.format));
+            return DecodeRle(data, header.size, header.bpp, pixels, header.width * header.height);
+        }
+        bool MercatorTileStore::LoadHeightmap(const PackedTileKey& key, graphics::Image& image)
+        {
+            Record record;
+            RegionPtr region;
+            if (!Find(RECORD_HEIGHTMAP, key, record, region))
+                return false;
+            const RecordHeader& header = record.header;
+            const int num_samples = header.width * header.height;
+            if (header.size != static_cast<boost::uint32_t>(num_samples) * 2U || header.bpp < 2)
+                return false;
+            const unsigned char * data = static_cast<const unsigned char*>(region->get_address())
+                + record.offset + sizeof(RecordHeader);
+            unsigned char * pixels = image.Allocate(header.width, header.height,
+                static_cast<graphics::Image::Format>(header.format));
+            memset(pixels, 0, num_samples * header.bpp);
+            // Samples are big endian, the same order as in image
+            for (int i = 0; i < num_samples; ++i)
+            {
+                pixels[i * header.bpp    ] = data[2 * i    ];
+                pixels[i * header.bpp + 1] = data[2 * i + 1];
+            }
+            return true;
+        }
+        void MercatorTileStore::SaveTexture(const PackedTileKey& key, const graphics::Image& image)
+        {
+            if (!IsOpen())
+                return;
+            std::vector<unsigned char> payload;
+            EncodeRle(image.pixels(), image.width() * image.height(), image.bpp(), payload);
+            Append(RECORD_TEXTURE, key, image, payload);
+        }
+        void MercatorTileStore::SaveHeightmap(const PackedTileKey& key, const graphics::Image& image)
+        {
+            if (!IsOpen() || image.bpp() < 2)
+                return;
+            // Only two bytes of packed height are meaningful
+            const int num_samples = image.width() * image.height();
+            const int bpp = image.bpp();
+            const unsigned char * pixels = image.pixels();
+            std::vector<unsigned char> payload(num_samples * 2);
+            for (int i = 0; i < num_samples; ++i)
+            {
+                payload[2 * i    ] = pixels[i * bpp    ];
+                payload[2 * i + 1] = pixels[i * bpp + 1];
+            }
+            Append(RECORD_HEIGHTMAP, key, image, payload);
+        }
+        bool MercatorTileStore::Find(RecordType type, const PackedTileKey& key, Record& record, RegionPtr& region)
+        {
+            boost::lock_guard<boost::mutex> guard(mutex_);
+            RecordMap::const_iterator it = records_[type].find(key);
+            if (it == records_[type].end())
+                return false;
+            record = it->second;
+            // Record may have been appended after the last mapping
+            if (record.offset + sizeof(RecordHeader) + record.header.size > mapped_size_ && !Remap())
+                return false;
+            // Mapping is kept alive by the caller even if it gets replaced meanwhile
+            region = region_;
+            return true;
+        }
+        void MercatorTileStore::Append(RecordType type, const PackedTileKey& key, const graphics::Image& image,
+            const std::vector<unsigned char>& payload)
+        {
+            RecordHeader header;
+            header.magic = kRecordMagic;
+            header.version = version_;
+            header.key = key.value();
+            header.type = static_cast<boost::uint32_t>(type);
+            header.size = static_cast<boost::uint32_t>(payload.size());
+            header.width = image.width();
+            header.height = image.height();
+            header.format = static_cast<boost::int32_t>(image.format());
+            header.bpp = image.bpp();
+
+            boost::lock_guard<boost::mutex> guard(mutex_);
+            if (!file_ || records_[type].find(key) != records_[type].end())
+                return;
+            const size_t record_size = sizeof(RecordHeader) + payload.size();
+            if (file_size_ + record_size > max_size_)
+            {
+                // Mapping can't be replaced while loads are reading it, the next save will try again
+                if (record_size > max_size_ / 2 || (region_ && !region_.unique()))
+                    return;
+                if (!Compact(max_size_ / 2))
+                    return;
+            }
+            bool written = std::fwrite(&header, sizeof(RecordHeader), 1, file_) == 1;
+            if (written && !payload.empty())
+                written = std::fwrite(&payload[0], payload.size(), 1, file_) == 1;
+            // Data should be in file before it's mapped by readers
+            if (!written || std::fflush(file_) != 0)
+            {
+                // Drop partial record, next open will cut it off anyway
+                std::fseek(file_, static_cast<long>(file_size_), SEEK_SET);
+                return;
+            }
+            Record& record = records_[type][key];
+            record.offset = file_size_;
+            record.header = header;
+            file_size_ += record_size;
+        }
+        bool MercatorTileStore::Remap()
+        {
+            // Should be called with locked mutex
+            try
+            {
+                boost::interprocess::file_mapping mapping(filename_.c_str(), boost::interprocess::read_only);
+                region_.reset(new boost::interprocess::mapped_region(mapping, boost::interprocess::read_only, 0, file_size_));
+                mapped_size_ = region_->get_size();
+            }
+            catch (...)
+            {
+                region_.reset();
+                mapped_size_ = 0;
+                return false;
+            }
+            return true;
+        }
+        size_t MercatorTileStore::ScanRecords(const unsigned char * data, size_t size)
+        {
+            size_t offset = 0;
+            while (offset + sizeof(RecordHeader) <= size)
+            {
+                RecordHeader header;
+                memcpy(&header, data + offset, sizeof(RecordHeader));
+                if (header.magic != kRecordMagic || header.type >= kNumRecordTypes ||
+                    offset + sizeof(RecordHeader) + header.size > size)
+                    break; // torn or corrupted tail
+                if (header.version == version_)
+                {
+                    Record& record = records_[header.type][PackedTileKey::FromValue(header.key)];
+                    record.offset = offset;
+                    record.header = header;
+                }
+                offset += sizeof(RecordHeader) + header.size;
+            }
+            return offset;
+        }
+        size_t MercatorTileStore::GetLiveSize() const
+        {
+            size_t size = 0;
+            for (int i = 0; i < kNumRecordTypes; ++i)
+                for (RecordMap::const_iterator it = records_[i].begin(); it != records_[i].end(); ++it)
+                    size += sizeof(RecordHeader) + it->second.header.size;
+            return size;
+        }
+        bool MercatorTileStore::Compact(size_t target_size)
+        {
+            // Should be called with locked mutex and mapping not used by readers
+            if (file_size_ > mapped_size_ && !Remap())
+                return false;
+
+            // Newest records are kept, file order is preserved
+            std::vector<Record> records;
+            for (int i = 0; i < kNumRecordTypes; ++i)
+                for (RecordMap::const_iterator it = records_[i].begin(); it != records_[i].end(); ++it)
+                    records.push_back(it->second);
+            std::sort(records.begin(), records.end(), IsNewer);
+            size_t compacted_size = 0;
+            size_t num_kept = 0;
+            for (; num_kept < records.size(); ++num_kept)
+            {
+                const size_t record_size = sizeof(RecordHeader) + records[num_kept].header.size;
+                if (compacted_size + record_size > target_size)
+                    break;
+                compacted_size += record_size;
+            }
+            records.resize(num_kept);
+            std::sort(records.begin(), records.end(), IsOlder);
+
+            // Records are copied straight from mapping to a new pack
+            const std::string compacted_filename = filename_ + ".tmp";
+            std::FILE * file = std::fopen(compacted_filename.c_str(), "wb");
+            bool written = (file != NULL);
+            for (std::vector<Record>::const_iterator it = records.begin(); it != records.end() && written; ++it)
+            {
+                const unsigned char * data = static_cast<const unsigned char*>(region_->get_address()) + it->offset;
+                written = std::fwrite(data, sizeof(RecordHeader) + it->header.size, 1, file) == 1;
+            }
+            if (file && std::fclose(file) != 0)
+                written = false;
+
+            // Old pack should be unmapped and closed before it's replaced
+            region_.reset();
+            mapped_size_ = 0;
+            std::fclose(file_);
+            file_ = NULL;
+            for (int i = 0; i < kNumRecordTypes; ++i)
+                records_[i].clear();
+            if (written)
+            {
+                std::remove(filename_.c_str());
+                if (std::rename(compacted_filename.c_str(), filename_.c_str()) == 0)
+                    file_ = std::fopen(filename_.c_str(), "r+b");
+            }
+            if (file_)
+            {
+                file_size_ = compacted_size;
+                if (file_size_ != 0 && Remap())
+                    ScanRecords(static_cast<const unsigned char*>(region_->get_address()), mapped_size_);
+            }
+            else
+            {
+                // Start over with empty pack
+                std::remove(compacted_filename.c_str());
+                file_ = std::fopen(filename_.c_str(), "w+b");
+                file_size_ = 0;
+                if (!file_)
+                    return false;
+            }
+            std::fseek(file_, static_cast<long>(file_size_), SEEK_SET);
+            return true;
+        }
+        bool MercatorTileStore::IsNewer(const Record& first, const Record& second)
+        {
+            return first.offset > second.offset; // records are appended, so later ones are newer
+        }
+        bool MercatorTileStore::IsOlder(const Record& first, const Record& second)
+        {
+            return first.offset < second.offset;
+        }
+        void MercatorTileStore::EncodeRle(const unsigned char * pixels, int num_pixels, int bpp,
+            std::vector<unsigned char>& out)
+        {
+            // Control byte below 128 is followed by (n + 1) literal pixels,
+            // otherwise the next pixel is repeated (n - 126) times
+            out.clear();
+            out.reserve(num_pixels * bpp / 4);
+            int i = 0;
+            while (i < num_pixels)
+            {
+                int run = 1;
+                while (i + run < num_pixels && run < kMaxRunLength + 1 &&
+                    memcmp(pixels + (i + run) * bpp, pixels + i * bpp, bpp) == 0)
+                    ++run;
+                if (run > 1)
+                {
+                    out.push_back(static_cast<unsigned char>(run + 126));
+                    out.insert(out.end(), pixels + i * bpp, pixels + (i + 1) * bpp);
+                    i += run;
+                }
+                else
+                {
+                    // Collect literals until the next run of two equal pixels
+                    int start = i;
+                    int count = 0;
+                    while (i < num_pixels && count < kMaxRunLength &&
+                        !(i + 1 < num_pixels && memcmp(pixels + (i + 1) * bpp, pixels + i * bpp, bpp) == 0))
+                    {
+                        ++i;
+                        ++count;
+                    }
+                    if (count == 0)
+                        continue;
+                    out.push_back(static_cast<unsigned char>(count - 1));
+                    out.insert(out.end(), pixels + start * bpp, pixels + i * bpp);
+                }
+            }
+        }
+        bool MercatorTileStore::DecodeRle(const unsigned char * data, size_t size, int bpp,
+            unsigned char * pixels, int num_pixels)
+        {
+            const unsigned char * end = data + size;
+            int i = 0;
+            while (data < end && i < num_pixels)
+            {
+                int control = *data++;
+                if (control < 128)
+                {
+                    int count = control + 1;
+                    if (i + count > num_pixels || data + count * bpp > end)
+                        return false;
+                    memcpy(pixels + i * bpp, data, count * bpp);
+                    data += count * bpp;
+                    i += count;
+                }
+                else
+                {
+                    int count = control - 126;
+                    if (i + count > num_pixels || data + bpp > end)
+                        return false;
+                    for (int k = 0; k < count; ++k)
+                        memcpy(pixels + (i + k) * bpp, data, bpp);
+                    data += bpp;
+                    i += count;
+                }
+            }
+            return i == num_pixels;
+        }
+
+    } // namespace terrain
+} // namespace mgn
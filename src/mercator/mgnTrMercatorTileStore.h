@@ -0,0 +1,115 @@
+#pragma once
+#ifndef __MGN_TERRAIN_MERCATOR_TILE_STORE_H__
+#define __MGN_TERRAIN_MERCATOR_TILE_STORE_H__
+
+#include "../mgnTrPackedTileKey.h"
+
+#include <boost/cstdint.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/unordered_map.hpp>
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+namespace boost {
+    namespace interprocess {
+        class mapped_region;
+    }
+}
+
+namespace mgn {
+    namespace graphics {
+        class Image;
+    }
+
+    namespace terrain {
+
+        /*! Mercator tile store class.
+        ** Persistent cache of tile data keyed by (lod, x, y, provider data version).
+        ** Records are appended to a single pack file and read back through memory mapping.
+        ** Every record has a self-describing header, so the index is rebuilt by walking
+        ** headers on open and a torn record at the tail is just cut off.
+        ** Pack is compacted when it's full or holds records of other data versions:
+        ** the newest records of current version are copied to a new pack file that replaces the old one.
+        ** Albedo is stored run-length encoded by pixels, heightmap as raw 16-bit samples.
+        ** All functions are thread safe, loads are called from service workers concurrently.
+        */
+        class MercatorTileStore {
+        public:
+            MercatorTileStore();
+            ~MercatorTileStore();
+
+            //! Opens pack file, records of other data versions are dropped by compaction
+            // @param max_size Pack file reaching this size is compacted to half of it.
+            bool Open(const std::string& filename, unsigned int version, size_t max_size);
+            void Close();
+            bool IsOpen() const;
+
+            bool LoadTexture(const PackedTileKey& key, graphics::Image& image);
+            bool LoadHeightmap(const PackedTileKey& key, graphics::Image& image);
+            void SaveTexture(const PackedTileKey& key, const graphics::Image& image);
+            void SaveHeightmap(const PackedTileKey& key, const graphics::Image& image);
+
+        private:
+            MercatorTileStore(const MercatorTileStore&);
+            MercatorTileStore& operator=(const MercatorTileStore&);
+
+            enum RecordType {
+                RECORD_TEXTURE,
+                RECORD_HEIGHTMAP,
+                kNumRecordTypes
+            };
+
+            struct RecordHeader {
+                boost::uint32_t magic;
+                boost::uint32_t version;    //!< provider data version
+                boost::uint64_t key;        //!< packed tile key
+                boost::uint32_t type;
+                boost::uint32_t size;       //!< payload size following the header
+                boost::int32_t width;
+                boost::int32_t height;
+                boost::int32_t format;      //!< graphics::Image::Format of stored image
+                boost::int32_t bpp;
+            };
+
+            struct Record {
+                size_t offset;              //!< offset of record header in pack file
+                RecordHeader header;
+            };
+
+            typedef boost::unordered_map<PackedTileKey, Record> RecordMap;
+            typedef boost::shared_ptr<boost::interprocess::mapped_region> RegionPtr;
+
+            bool Find(RecordType type, const PackedTileKey& key, Record& record, RegionPtr& region);
+            void Append(RecordType type, const PackedTileKey& key, const graphics::Image& image,
+                const std::vector<unsigned char>& payload);
+            bool Remap();
+            size_t ScanRecords(const unsigned char * data, size_t size);
+            size_t GetLiveSize() const;
+            //! Rewrites pack with the newest records fitting into target size
+            bool Compact(size_t target_size);
+            static bool IsNewer(const Record& first, const Record& second);
+            static bool IsOlder(const Record& first, const Record& second);
+
+            static void EncodeRle(const unsigned char * pixels, int num_pixels, int bpp,
+                std::vector<unsigned char>& out);
+            static bool DecodeRle(const unsigned char * data, size_t size, int bpp,
+                unsigned char * pixels, int num_pixels);
+
+            boost::mutex mutex_;
+            std::string filename_;
+            std::FILE * file_;          //!< pack file opened for appending
+            RegionPtr region_;          //!< mapping of pack file, replaced when file grows
+            size_t mapped_size_;
+            size_t file_size_;
+            size_t max_size_;
+            unsigned int version_;
+            RecordMap records_[kNumRecordTypes];
+        };
+
+    } // namespace terrain
+} // namespace mgn
+
+#endif
@@ -4,11 +4,14 @@
 
 #include "mgnTrMercatorNode.h"
 #include "mgnTrMercatorNodePool.h"
+#include "mgnTrMercatorNodeCache.h"
 #include "mgnTrMercatorTileMesh.h"
 #include "mgnTrMercatorRenderable.h"
 #include "mgnTrMercatorService.h"
+#include "mgnTrMercatorTileStore.h"
 
 #include "../mgnTrIcon.h"
+#include "../mgnTimeManager.h"
 
 #include "mgnTrMercatorTaskTexture.h"
 #include "mgnTrMercatorTaskHeightmap.h"
@@ -20,6 +23,9 @@
 
 #include "MapDrawing/Graphics/mgnCommonMath.h"
 
+#include <boost/static_assert.hpp>
+#include <boost/thread/locks.hpp>
+
 #include <algorithm>
 #include <cmath>
 #include <cstddef>
@@ -29,6 +35,27 @@ namespace {
     // The more detail coefficient is, the less detalization is required
     const float kGeoDetail = 6.0f;
     const float kTexDetail = 1.0f;
+
+    // Number of rendered nodes around the camera one in each direction
+    const int kRenderedNodeShift = 3;
+
+    // Prefetch parameters
+    const int kPrefetchDepth = 3;                   // rows of nodes ahead of rendered block
+    const float kPrefetchMinSpeed = 0.5f;           // tiles per second, heading is used below it
+    const float kPrefetchZoomThreshold = 0.5f;      // relative change of camera height per second
+    const float kPrefetchTrajectoryCosine = 0.866f; // direction change over 30 degrees resets prefetch
+
+    // Request handler costs before the first measurements (renderable, map tile, split, merge), microseconds
+    const float kInitialRequestCosts[] = { 400.0f, 400.0f, 40.0f, 80.0f };
+    const float kRequestCostSmoothing = 0.125f;     // weight of the last measurement in running average
+
+    const int kPruneAge = 100;                      // frames since node was opened last time to consider merge
+    const int kMaxPrunedNodesPerFrame = 16;
+
+    // Atlases of icon and shield bitmaps, page is 1 MB of RGBA
+    const int kAtlasPageSize = 512;
+    const int kMaxIconAtlasPages = 4;
+    const int kMaxShieldAtlasPages = 2;
 }
 
 namespace mgn {
@@ -47,23 +74,54 @@ namespace mgn {
         , provider_(provider)
         , gps_position_(gps_position)
         , grid_size_(17)
+        , request_time_budget_(mgn::terrain::GetRequestTimeBudget())
+        , request_time_left_(0)
+        , open_head_(NULL)
+        , open_tail_(NULL)
         , frame_counter_(0)
         , preprocess_(!IsCollection())
         , lod_freeze_(false)
         , tree_freeze_(false)
+        , last_camera_position_(0.0f)
+        , last_prefetch_time_(0U)
+        , prefetch_direction_x_(0.0f)
+        , prefetch_direction_y_(0.0f)
+        , prefetch_lod_(-1)
+        , prefetch_zoom_(0)
+        , prefetch_budget_(mgn::terrain::GetPrefetchBudget())
+        , icon_list_stamp_(0U)
         {
             root_ = new MercatorNode(this);
 
-            const int kPoolSize = 50;
+            const int kPoolSize = MercatorNodePool::CapacityForMemory(mgn::terrain::GetNodePoolMemoryBudget());
             node_pool_ = new MercatorNodePool(kPoolSize);
 
+            // Should be much greater than number of rendered keys
+            const int kNodeCacheSize = 256;
+            node_cache_ = new MercatorNodeCache(kNodeCacheSize);
+
             tile_ = new MercatorTileMesh(renderer, grid_size_);
-            service_ = new MercatorService();
+            service_ = new MercatorService(std::max(1, provider_->GetServiceWorkerCount()));
+            tile_store_ = new MercatorTileStore();
+
+            icon_atlas_ = new TextureAtlas(renderer, kAtlasPageSize, kMaxIconAtlasPages);
+            shield_atlas_ = new TextureAtlas(renderer, kAtlasPageSize, kMaxShieldAtlasPages);
 
             const float kPlanetRadius = 6371000.0f;
             const float kMSM = static_cast<float>(mgn::terrain::GetMapSizeMax());
             terrain_view->LocalToPixelDistance(kPlanetRadius, earth_radius_, kMSM);
 
+            // Nodes keep a queue hook per request type
+            BOOST_STATIC_ASSERT(kNumRequestTypes == kNumMercatorRequestTypes);
+            for (int i = 0; i < kNumRequestTypes; ++i)
+                request_costs_[i] = kInitialRequestCosts[i];
+
+            render_stats_.num_drawn = 0;
+            render_stats_.num_culled = 0;
+            render_stats_.request_time = 0;
+            render_stats_.num_handled_requests = 0;
+            render_stats_.num_pending_requests = 0;
+
 #ifdef DEBUG
             debug_info_.num_nodes = 1;
             debug_info_.num_map_tiles = 0;
@@ -72,31 +130,27 @@ namespace mgn {
         }
         MercatorTree::~MercatorTree()
         {
+            rendered_nodes_.clear();
+            prefetch_nodes_.clear();
+
             delete root_;
             root_ = NULL;
 
             delete node_pool_;
             node_pool_ = NULL;
 
+            delete node_cache_;
+            node_cache_ = NULL;
+
             delete tile_;
             tile_ = NULL;
 
-            // Clear texture caches
-            for (IconTextureCache::iterator it = icon_texture_cache_.begin(); it != icon_texture_cache_.end(); ++it)
-            {
-                graphics::Texture * texture = it->second;
-                if (texture)
-                    renderer_->DeleteTexture(texture);
-            }
-            icon_texture_cache_.clear();
+            // Delete atlases after nodes, which billboards reference them
+            delete icon_atlas_;
+            icon_atlas_ = NULL;
 
-            for (ShieldTextureCache::iterator it = shield_texture_cache_.begin(); it != shield_texture_cache_.end(); ++it)
-            {
-                graphics::Texture * texture = it->second;
-                if (texture)
-                    renderer_->DeleteTexture(texture);
-            }
-            shield_texture_cache_.clear();
+            delete shield_atlas_;
+            shield_atlas_ = NULL;
 
             // Delete default textures
             if (default_albedo_texture_)
@@ -113,6 +167,12 @@ namespace mgn {
             service_->StopService();
             delete service_; // should be deleted after faces are done
             service_ = NULL;
+
+            delete tile_store_; // is used by service workers
+            tile_store_ = NULL;
+
+            if (terrain_view_->getElevationPyramid() == &elevation_pyramid_)
+                terrain_view_->setElevationPyramid(NULL);
         }
         bool MercatorTree::Initialize(float fovy_in_radians, int screen_height)
         {
@@ -143,6 +203,18 @@ namespace mgn {
                     (unsigned char*)&kHeightData);
                 if (!default_heightmap_texture_) return false;
             }
+            // Open tile store, tiles will be fetched from provider if it fails
+            {
+                std::string path = provider_->GetTileStorePath();
+                if (!path.empty())
+                    tile_store_->Open(path, provider_->GetDataVersion(), mgn::terrain::GetTileStoreMaxSize());
+            }
+            // Open elevation pyramid, altitude is taken from provider if it fails
+            {
+                std::string path = provider_->GetElevationPyramidPath();
+                if (!path.empty() && elevation_pyramid_.Open(path))
+                    terrain_view_->setElevationPyramid(&elevation_pyramid_);
+            }
             // Run service
             service_->RunService();
             // Setup LOD parameters
@@ -160,6 +232,11 @@ namespace mgn {
         }
         void MercatorTree::Update()
         {
+            // Render and inline requests share time budget of the frame
+            request_time_left_ = request_time_budget_;
+            render_stats_.request_time = 0;
+            render_stats_.num_handled_requests = 0;
+
             // Update LOD state.
             if (!lod_freeze_)
             {
@@ -176,6 +253,7 @@ namespace mgn {
 
                 FillRenderedKeys();
                 PrepareNodes();
+                PrefetchNodes();
             }
             else
             {
@@ -198,9 +276,13 @@ namespace mgn {
                     HandleInlineRequests();
                 }
             }
+            render_stats_.num_pending_requests = static_cast<int>(render_requests_.size() + inline_requests_.size());
         }
         void MercatorTree::Render()
         {
+            render_stats_.num_drawn = 0;
+            render_stats_.num_culled = 0;
+
             shader_->Bind();
             if (IsCollection())
             {
@@ -209,14 +291,14 @@ namespace mgn {
                 {
                     MercatorNode * node = *it;
                     if (node->WillRender())
-                        node->Render();
+                        node->Render(math::CullInfo());
                 }
             }
             else
             {
                 rendered_nodes_.clear();
                 if (root_->WillRender())
-                    root_->Render();
+                    root_->Render(math::CullInfo());
             }
             shader_->Unbind();
 
@@ -229,8 +311,8 @@ namespace mgn {
             billboard_shader_->Bind();
 
             // Draw labels
-            used_labels_.clear();
-            label_bounding_boxes_.clear();
+            used_labels_.Clear();
+            label_grid_.Clear();
             for (std::vector<MercatorNode*>::const_iterator it = rendered_nodes_.begin();
                 it != rendered_nodes_.end(); ++it)
             {
@@ -239,68 +321,100 @@ namespace mgn {
                     node->RenderLabels();
             }
             // Draw point user meshes
-            for (std::vector<Icon*>::iterator it = icons_list_.begin(); it != icons_list_.end(); ++it)
-            {
-                Icon* icon = *it;
-                icon->render();
-            }
+            for (size_t i = 0; i < icons_list_.size(); ++i)
+                icons_list_[i]->render();
 
             billboard_shader_->Unbind();
 
             renderer_->EnableDepthTest();
+
+            UpdateIconSelection();
         }
-        class IconDistanceCompareFunctor
+        void MercatorTree::UpdateIconSelection()
         {
-        public:
-            IconDistanceCompareFunctor(const mgnMdTerrainView * terrain_view)
-            {
-                const float kMSM = static_cast<float>(mgn::terrain::GetMapSizeMax());
-                terrain_view->LocalToPixel(terrain_view->getCamPosition(), camera_position_, kMSM);
-            }
-            bool operator()(Icon * first, Icon * second) const
-            {
-                vec3 first_position = first->position();
-                vec3 second_position = second->position();
-                float d1_sqr = math::DistanceSqr(first_position, camera_position_);
-                float d2_sqr = math::DistanceSqr(second_position, camera_position_);
-                return d1_sqr > d2_sqr; // distant ones should be first
-            }
-        private:
-            vec3 camera_position_; //!< camera position in local cs
-        };
+            const math::Matrix4& proj = renderer_->projection_matrix();
+            const math::Matrix4& view = renderer_->view_matrix();
+            const math::Vector4& viewport = renderer_->viewport();
+
+            boost::lock_guard<boost::mutex> guard(icon_selection_mutex_);
+            icon_selection_.Clear();
+            for (size_t i = 0; i < icons_list_.size(); ++i)
+                icon_selection_.Insert(icons_list_[i], proj, view, viewport);
+        }
+        void MercatorTree::GetSelectedIcons(int x, int y, int radius, std::vector<int>& ids)
+        {
+            boost::lock_guard<boost::mutex> guard(icon_selection_mutex_);
+            icon_selection_.SelectIcons(x, y, radius, ids);
+        }
+        void MercatorTree::GetSelectedPOIs(int x, int y, int radius, TMapObjectsVector& objects)
+        {
+            boost::lock_guard<boost::mutex> guard(icon_selection_mutex_);
+            icon_selection_.SelectPOIs(x, y, radius, objects);
+        }
         void MercatorTree::UpdateIconList()
         {
-            // TODO: lock needed for selection requests
-            //mgnCriticalSectionScopedEntrance guard(mIconListCriticalSection);
-            // Form list
-            icons_list_.clear();
+            ++icon_list_stamp_;
+
+            // Add icons of nodes which have become rendered
+            std::vector<MercatorNode*> icon_nodes;
             for (std::vector<MercatorNode*>::const_iterator it = rendered_nodes_.begin();
                 it != rendered_nodes_.end(); ++it)
             {
                 MercatorNode * node = *it;
-                if (node->lod_ != terrain_view_->GetLod()) continue;
-
-                // if (! tile->mIsFetchedUserObjects)
-                //     continue;
+                if (node->lod_ != terrain_view_->GetLod() || !node->has_icons_)
+                    continue;
+                node->icon_list_stamp_ = icon_list_stamp_;
+                if (!node->in_icon_list_)
+                {
+                    icons_list_.Add(node, node->point_user_meshes_);
+                    node->in_icon_list_ = true;
+                    icon_nodes.push_back(node);
+                }
+            }
 
-                for (std::vector<Icon*>::iterator iti = node->point_user_meshes_.begin();
-                    iti != node->point_user_meshes_.end(); ++iti)
+            // Remove icons of nodes which aren't rendered anymore
+            std::vector<IconDepthList::Owner> removed_nodes;
+            for (std::vector<MercatorNode*>::const_iterator it = icon_nodes_.begin(); it != icon_nodes_.end(); ++it)
+            {
+                MercatorNode * node = *it;
+                if (node->icon_list_stamp_ == icon_list_stamp_)
                 {
-                    Icon * icon = *iti;
-                    icons_list_.push_back( icon );
+                    icon_nodes.push_back(node);
+                }
+                else
+                {
+                    node->in_icon_list_ = false;
+                    removed_nodes.push_back(node);
                 }
             }
-            // Then sort it by distance
-            // This is the weakest part, complexity is O(n*log(n))
-            std::sort(icons_list_.begin(), icons_list_.end(), IconDistanceCompareFunctor(terrain_view_));
+            icons_list_.Remove(removed_nodes);
+            icon_nodes_.swap(icon_nodes);
+
+            // Then order it by distance, previous order makes it nearly linear
+            const float kMSM = static_cast<float>(mgn::terrain::GetMapSizeMax());
+            vec3 camera_position;
+            terrain_view_->LocalToPixel(terrain_view_->getCamPosition(), camera_position, kMSM);
+            icons_list_.Sort(camera_position);
+        }
+        void MercatorTree::RemoveIcons(MercatorNode * node)
+        {
+            if (!node->in_icon_list_)
+                return;
+            icons_list_.Remove(node);
+            icon_nodes_.erase(std::find(icon_nodes_.begin(), icon_nodes_.end(), node));
+            node->in_icon_list_ = false;
+
+            // Icons are going to be deleted, selection is empty until the next frame
+            boost::lock_guard<boost::mutex> guard(icon_selection_mutex_);
+            icon_selection_.Clear();
         }
         void MercatorTree::SplitQuadTreeNode(MercatorNode* node)
         {
             // Parent is no longer an open node, now has at least one child.
             if (node->parent_)
-                open_nodes_.erase(node->parent_);
+                UnlinkOpenNode(node->parent_);
             // This node is now open.
-            open_nodes_.insert(node);
+            LinkOpenNode(node);
             // Create children.
             for (int i = 0; i < 4; ++i)
             {
@@ -324,7 +438,7 @@ namespace mgn {
                 node->DetachChild(i, IsUsingPool());
             }
             // This node is now closed.
-            open_nodes_.erase(node);
+            UnlinkOpenNode(node);
             if (node->parent_)
             {
                 // Check to see if any siblings are split.
@@ -332,89 +446,98 @@ namespace mgn {
                     if (node->parent_->children_[i]->IsSplit())
                         return;
                 // If not, the parent is now open.
-                open_nodes_.insert(node->parent_);
+                LinkOpenNode(node->parent_);
             }
         }
         void MercatorTree::Request(MercatorNode* node, int type, bool priority)
         {
-            RequestQueue& request_queue = (type == REQUEST_MAPTILE) ? render_requests_ : inline_requests_;
+            RequestQueue& request_queue = GetRequestQueue(type);
+            MercatorRequest* request = &node->requests_[type];
+            if (request->IsQueued())
+            {
+                // Node is queued once per request type, priority request just moves it ahead
+                if (!priority)
+                    return;
+                request_queue.Remove(request);
+            }
             if (priority)
-                request_queue.push_front(RequestType(node, type));
+                request_queue.PushFront(request);
             else
-                request_queue.push_back(RequestType(node, type));
+                request_queue.PushBack(request);
         }
         void MercatorTree::Unrequest(MercatorNode* node)
         {
             // Remove node from queues
-            RequestQueue* request_queues[] = { &render_requests_, &inline_requests_ };
-            for (int q = 0; q < 2; ++q)
+            for (int type = 0; type < kNumRequestTypes; ++type)
             {
-                RequestQueue* request_queue = request_queues[q];
-                RequestQueue::iterator i = (*request_queue).begin(), j;
-                while (i != (*request_queue).end())
-                {
-                    if ((*i).node == node)
-                    {
-                        // Remove item at front of queue.
-                        if (i == (*request_queue).begin())
-                        {
-                            (*request_queue).erase(i);
-                            i = (*request_queue).begin();
-                            continue;
-                        }
-                        else // Remove item mid-queue.
-                        {
-                            j = i;
-                            --i;
-                            (*request_queue).erase(j);
-                        }
-                    }
-                    ++i;
-                }
+                MercatorRequest* request = &node->requests_[type];
+                if (request->IsQueued())
+                    GetRequestQueue(type).Remove(request);
+            }
+            // Remove node from service, tasks being executed are cancelled and won't be processed
+            service_->CancelAllNodeTasks(node);
+            ++node->generation_;
+            if (node->prefetch_)
+            {
+                std::vector<MercatorNode*>::iterator it = std::find(prefetch_nodes_.begin(), prefetch_nodes_.end(), node);
+                if (it != prefetch_nodes_.end())
+                    prefetch_nodes_.erase(it);
             }
-            // Remove node from service
-            // Guess this is the best solution to make a cycle
-            while (!service_->RemoveAllNodeTasks(node));
+        }
+        MercatorTree::RequestQueue& MercatorTree::GetRequestQueue(int type)
+        {
+            return (type == REQUEST_MAPTILE) ? render_requests_ : inline_requests_;
         }
         void MercatorTree::HandleRequests(RequestQueue& requests)
         {
-            // Ensure we only use up x time per frame.
-            int weights[] = { 10, 10, 1, 2 };
-            bool(MercatorTree::*handlers[4])(MercatorNode*) =
+            bool(MercatorTree::*handlers[kNumRequestTypes])(MercatorNode*) =
             {
                 &MercatorTree::HandleRenderable,
                 &MercatorTree::HandleMapTile,
                 &MercatorTree::HandleSplit,
                 &MercatorTree::HandleMerge
             };
-            int limit = 1000;
             bool sorted = false;
 
             // Added request count to not stuck into the cycle (some handlers may duplicate requests)
-            RequestQueue::size_type num_requests = requests.size();
+            size_t num_requests = requests.size();
+            size_t num_handled = 0; // per queue, so every queue makes progress in frame
             while (!requests.empty() && num_requests != 0)
             {
-                RequestType request = *requests.begin();
-                MercatorNode* node = request.node;
+                MercatorRequest* request = requests.front();
+                MercatorNode* node = request->node;
+                const int type = request->type;
 
-                // If not a root level task.
-                if (node->parent_)
+                // If not a root level task and tree isn't being preprocessed.
+                if (node->parent_ && !preprocess_)
                 {
-                    // Verify job limits.
-                    if (limit <= 0) return;
-                    limit -= weights[request.type];
+                    // Request that doesn't fit into the rest of frame time is left for the next frame,
+                    // but at least one request is handled to make progress.
+                    if (request_costs_[type] > static_cast<float>(request_time_left_) &&
+                        num_handled != 0)
+                        return;
                 }
 
-                requests.pop_front();
+                // Handler may queue this request again
+                requests.Remove(request);
                 --num_requests;
 
-                // Call handler.
-                if ((this->*handlers[request.type])(node))
+                // Call handler and measure its real cost.
+                const boost::uint64_t start_time = TimeManager::GetPreciseTime();
+                const bool completed = (this->*handlers[type])(node);
+                const int elapsed = static_cast<int>(TimeManager::GetPreciseTime() - start_time);
+                request_costs_[type] += (static_cast<float>(elapsed) - request_costs_[type]) * kRequestCostSmoothing;
+                request_time_left_ -= elapsed;
+                render_stats_.request_time += elapsed;
+                ++render_stats_.num_handled_requests;
+                ++num_handled;
+
+                if (completed)
                 {
                     // Job was completed. We can re-sort the priority queue.
                     if (!sorted)
                     {
-                        requests.sort(RequestComparePriority());
+                        requests.Sort(RequestComparePriority());
                         sorted = true;
                     }
                 }
@@ -520,9 +643,10 @@ namespace mgn {
             }
             else // ! tile_filled
             {
-                // Repeat this request until is done
+                // Park this request until texture or heightmap task completes,
+                // so pending nodes don't take handling time every frame
                 node->request_map_tile_ = true;
-                Request(node, REQUEST_MAPTILE, false);
+                node->wait_map_tile_ = true;
                 return false;
             }
         }
@@ -547,22 +671,15 @@ namespace mgn {
         }
         void MercatorTree::PruneTree()
         {
-            NodeHeap heap;
-
-            NodeSet::iterator open_node = open_nodes_.begin();
-            while (open_node != open_nodes_.end())
-            {
-                heap.push(*open_node);
-                ++open_node;
-            };
-
-            while (!heap.empty())
+            // Open nodes are ordered by last opened frame, so only the oldest ones are examined
+            int num_examined = 0;
+            MercatorNode* old_node = open_head_;
+            while (old_node && num_examined < kMaxPrunedNodesPerFrame &&
+                GetFrameCounter() - old_node->last_opened_ > kPruneAge)
             {
-                MercatorNode* old_node = heap.top();
-                heap.pop();
-                if (!old_node->page_out_ &&
-                    !old_node->request_merge_ &&
-                    (GetFrameCounter() - old_node->last_opened_ > 100))
+                MercatorNode* next_node = old_node->open_next_;
+                ++num_examined;
+                if (!old_node->page_out_ && !old_node->request_merge_)
                 {
                     old_node->renderable_.SetFrameOfReference();
                     // Make sure node's children are too detailed rather than just invisible.
@@ -574,13 +691,48 @@ namespace mgn {
                         Request(old_node, REQUEST_MERGE, true);
                         return;
                     }
-                    else
-                    {
-                        old_node->last_opened_ = GetFrameCounter();
-                    }
                 }
+                // Node is moved to the back not to be examined again for a while
+                old_node->MarkOpened();
+                old_node = next_node;
             }
         }
+        void MercatorTree::LinkOpenNode(MercatorNode* node)
+        {
+            if (node->is_open_)
+                return;
+            node->is_open_ = true;
+            // Node is usually opened recently, so its place is found near the tail
+            MercatorNode* prev = open_tail_;
+            while (prev && prev->last_opened_ > node->last_opened_)
+                prev = prev->open_prev_;
+            node->open_prev_ = prev;
+            node->open_next_ = prev ? prev->open_next_ : open_head_;
+            if (node->open_next_)
+                node->open_next_->open_prev_ = node;
+            else
+                open_tail_ = node;
+            if (prev)
+                prev->open_next_ = node;
+            else
+                open_head_ = node;
+        }
+        void MercatorTree::UnlinkOpenNode(MercatorNode* node)
+        {
+            if (!node->is_open_)
+                return;
+            node->is_open_ = false;
+            if (node->open_prev_)
+                node->open_prev_->open_next_ = node->open_next_;
+            else
+                open_head_ = node->open_next_;
+            if (node->open_next_)
+                node->open_next_->open_prev_ = node->open_prev_;
+            else
+                open_tail_ = node->open_prev_;
+            node->open_prev_ = NULL;
+            node->open_next_ = NULL;
+        }
         void MercatorTree::RefreshMapTile(MercatorNode* node, MercatorMapTile* old_tile, MercatorMapTile* new_tile)
         {
             for (int i = 0; i < 4; ++i)
@@ -621,7 +773,9 @@ namespace mgn {
                 {
                     task = done_tasks.front();
                     done_tasks.pop_front();
-                    task->Process();
+                    // Drop stale results of nodes that have been unrequested
+                    if (!task->IsCancelled() && task->generation() == task->node()->generation())
+                        task->Process();
                     delete task;
                 }
             }
@@ -633,24 +787,31 @@ namespace mgn {
                 HandleInlineRequests();
                 HandleRenderRequests();
                 if (root_->WillRender())
-                    root_->Render();
+                    root_->Render(math::CullInfo());
             }
             while (!render_requests_.empty() || !inline_requests_.empty());
 
             // After preprocess we should flush map tiles to root level
             FlushMapTileToRoot(root_);
 
-            // And sort tasks queue in service
-            service_->SortTasks();
+            // And refresh tasks priorities in service, renderables have been created at this point
+            service_->RefreshPriorities();
+        }
+        void MercatorTree::GetCameraTile(int lod, float& x, float& y) const
+        {
+            const float kMSM = static_cast<float>(mgn::terrain::GetMapSizeMax());
+            float tiles_per_side = static_cast<float>(1 << lod);
+            x = (lod_params_.camera_position.x / kMSM) * tiles_per_side;
+            y = (1.0f - lod_params_.camera_position.z / kMSM) * tiles_per_side;
         }
         void MercatorTree::FillRenderedKeys()
         {
             // Determine current node
-            const float kMSM = static_cast<float>(mgn::terrain::GetMapSizeMax());
             int lod = terrain_view_->GetLod();
-            float tiles_per_side = static_cast<float>(1 << lod);
-            int x = static_cast<int>((lod_params_.camera_position.x / kMSM) * tiles_per_side);
-            int y = static_cast<int>((1.0f - lod_params_.camera_position.z / kMSM) * tiles_per_side);
+            float camera_x, camera_y;
+            GetCameraTile(lod, camera_x, camera_y);
+            int x = static_cast<int>(camera_x);
+            int y = static_cast<int>(camera_y);
 
             /*
             z
@@ -662,9 +823,8 @@ namespace mgn {
 
             // Fill keys
             rendered_keys_.clear();
-            const int kNodeShift = 3;
-            for (int j = y - kNodeShift; j <= y + kNodeShift; ++j)
-                for (int i = x - kNodeShift; i <= x + kNodeShift; ++i)
+            for (int j = y - kRenderedNodeShift; j <= y + kRenderedNodeShift; ++j)
+                for (int i = x - kRenderedNodeShift; i <= x + kRenderedNodeShift; ++i)
                     rendered_keys_.push_back(MercatorNodeKey(lod, i, j));
             // rendered_keys_.push_back(MercatorNodeKey(lod, x  , y  ));
             // rendered_keys_.push_back(MercatorNodeKey(lod, x  , y-1));
@@ -683,22 +843,204 @@ namespace mgn {
                 it != rendered_keys_.end(); ++it)
             {
                 const MercatorNodeKey& key = *it;
-                MercatorNode * node;
-                AllocatedNodes::iterator ait = allocated_nodes_.find(key);
-                if (ait == allocated_nodes_.end()) // hasn't been allocated yet
+                MercatorNode * node = node_cache_->Find(key);
+                if (node == NULL) // hasn't been allocated yet
                 {
                     node = new MercatorNode(this);
                     node->lod_ = key.lod;
                     node->x_ = key.x;
                     node->y_ = key.y;
-                    allocated_nodes_.insert(std::make_pair(key, node));
+                    MercatorNode * evicted_node = node_cache_->Insert(node);
+                    if (evicted_node)
+                        evicted_nodes_.push_back(evicted_node);
                 }
+                else if (node->prefetch_) // node is needed now
+                    PromoteNode(node);
+                rendered_nodes_.push_back(node);
+            }
+            // Evicted nodes release their textures, labels and icons.
+            // Deleted after rendered nodes are complete, thus icons list is rebuilt properly.
+            for (std::vector<MercatorNode*>::iterator it = evicted_nodes_.begin();
+                it != evicted_nodes_.end(); ++it)
+                delete *it;
+            evicted_nodes_.clear();
+        }
+        void MercatorTree::PrefetchNodes()
+        {
+            const int lod = terrain_view_->GetLod();
+            const float kMSM = static_cast<float>(mgn::terrain::GetMapSizeMax());
+            const float tiles_per_side = static_cast<float>(1 << lod);
+
+            // Camera motion since the last frame
+            math::Vector3 velocity = lod_params_.camera_position - last_camera_position_;
+            last_camera_position_ = lod_params_.camera_position;
+            const boost::uint64_t time = TimeManager::GetPreciseTime();
+            const boost::uint64_t elapsed = time - last_prefetch_time_;
+            last_prefetch_time_ = time;
+            if (prefetch_lod_ < 0)
+            {
+                // Motion is unknown at the first frame
+                prefetch_lod_ = lod;
+                return;
+            }
+            // Speed is measured per second, so thresholds don't depend on frame rate
+            const float inv_elapsed = (elapsed != 0) ? 1000000.0f / static_cast<float>(elapsed) : 0.0f;
+
+            // Direction of motion in tiles of current LOD, camera heading is used when standing still
+            float direction_x = (velocity.x / kMSM) * tiles_per_side * inv_elapsed;
+            float direction_y = -(velocity.z / kMSM) * tiles_per_side * inv_elapsed;
+            float length = sqrt(direction_x * direction_x + direction_y * direction_y);
+            if (length < kPrefetchMinSpeed)
+            {
+                direction_x = lod_params_.camera_front.x;
+                direction_y = -lod_params_.camera_front.z;
+                length = sqrt(direction_x * direction_x + direction_y * direction_y);
+            }
+            if (length > 1e-3f)
+            {
+                direction_x /= length;
+                direction_y /= length;
+            }
+            else // looking straight down
+                direction_x = direction_y = 0.0f;
+
+            // Zooming is detected by relative change of camera height
+            int zoom = 0;
+            const float height = lod_params_.camera_position.y;
+            if (height > 0.0f && fabs(velocity.y) * inv_elapsed > kPrefetchZoomThreshold * height)
+                zoom = (velocity.y < 0.0f) ? 1 : -1;
+
+            // Speculative requests along the old trajectory are useless now.
+            // Direction is unknown while looking straight down, so it doesn't count as a turn.
+            const bool has_direction = (direction_x != 0.0f || direction_y != 0.0f);
+            const bool had_direction = (prefetch_direction_x_ != 0.0f || prefetch_direction_y_ != 0.0f);
+            const bool turned = has_direction && had_direction &&
+                (direction_x * prefetch_direction_x_ + direction_y * prefetch_direction_y_ < kPrefetchTrajectoryCosine);
+            if ((lod != prefetch_lod_) || (zoom != prefetch_zoom_) || turned)
+            {
+                CancelPrefetch();
+                prefetch_lod_ = lod;
+                prefetch_zoom_ = zoom;
+            }
+            if (has_direction)
+            {
+                prefetch_direction_x_ = direction_x;
+                prefetch_direction_y_ = direction_y;
+            }
+
+            // Completely loaded nodes don't consume budget
+            for (std::vector<MercatorNode*>::iterator it = prefetch_nodes_.begin(); it != prefetch_nodes_.end(); )
+            {
+                MercatorNode * node = *it;
+                if (!node->request_albedo_ && !node->request_heightmap_ &&
+                    !node->request_labels_ && !node->request_icons_)
+                    it = prefetch_nodes_.erase(it);
                 else
+                    ++it;
+            }
+
+            // Nodes of the next LOD are needed first while zooming
+            const int zoom_lod = lod + zoom;
+            if (zoom != 0 && zoom_lod >= 0 && zoom_lod <= GetMaxLod())
+            {
+                float camera_x, camera_y;
+                GetCameraTile(zoom_lod, camera_x, camera_y);
+                int x = static_cast<int>(camera_x);
+                int y = static_cast<int>(camera_y);
+                for (int j = y - 1; j <= y + 1; ++j)
+                    for (int i = x - 1; i <= x + 1; ++i)
+                        PrefetchNode(MercatorNodeKey(zoom_lod, i, j));
+            }
+
+            // Then rows of nodes ahead of rendered block, each row is three nodes wide
+            if (direction_x != 0.0f || direction_y != 0.0f)
+            {
+                float camera_x, camera_y;
+                GetCameraTile(lod, camera_x, camera_y);
+                bool has_budget = true;
+                for (int step = kRenderedNodeShift + 1; step <= kRenderedNodeShift + kPrefetchDepth && has_budget; ++step)
                 {
-                    node = ait->second;
+                    float ahead_x = camera_x + direction_x * static_cast<float>(step);
+                    float ahead_y = camera_y + direction_y * static_cast<float>(step);
+                    for (int side = -1; side <= 1 && has_budget; ++side)
+                    {
+                        int x = static_cast<int>(floor(ahead_x - direction_y * static_cast<float>(side)));
+                        int y = static_cast<int>(floor(ahead_y + direction_x * static_cast<float>(side)));
+                        has_budget = PrefetchNode(MercatorNodeKey(lod, x, y));
+                    }
+                }
+            }
+
+            for (std::vector<MercatorNode*>::iterator it = evicted_nodes_.begin();
+                it != evicted_nodes_.end(); ++it)
+                delete *it;
+            evicted_nodes_.clear();
+        }
+        bool MercatorTree::PrefetchNode(const MercatorNodeKey& key)
+        {
+            if (static_cast<int>(prefetch_nodes_.size()) >= prefetch_budget_)
+                return false;
+            MercatorNode * node = node_cache_->Find(key);
+            if (node)
+            {
+                // Rendered nodes are requested by tree itself
+                if (!node->prefetch_)
+                    return true;
+                // Prefetch cancelled by trajectory change keeps loaded data, the rest is requested again
+                const bool has_albedo = node->map_tile_.HasAlbedoTexture() || node->request_albedo_;
+                const bool has_heightmap = node->map_tile_.HasHeightmapTexture() || node->request_heightmap_;
+                if (has_albedo && has_heightmap)
+                    return true;
+                prefetch_nodes_.push_back(node);
+                if (!has_albedo)
+                    RequestTexture(node);
+                if (!has_heightmap)
+                    RequestHeightmap(node);
+                return true;
+            }
+            node = new MercatorNode(this);
+            node->lod_ = key.lod;
+            node->x_ = key.x;
+            node->y_ = key.y;
+            node->prefetch_ = true;
+            MercatorNode * evicted_node = node_cache_->Insert(node);
+            if (evicted_node)
+                evicted_nodes_.push_back(evicted_node);
+            prefetch_nodes_.push_back(node);
+            // Tasks get low priority from node's prefetch flag
+            RequestTexture(node);
+            RequestHeightmap(node);
+            return true;
+        }
+        void MercatorTree::PromoteNode(MercatorNode* node)
+        {
+            node->prefetch_ = false;
+            std::vector<MercatorNode*>::iterator it = std::find(prefetch_nodes_.begin(), prefetch_nodes_.end(), node);
+            if (it != prefetch_nodes_.end())
+                prefetch_nodes_.erase(it);
+            service_->PromoteNodeTasks(node);
+        }
+        void MercatorTree::CancelPrefetch()
+        {
+            for (std::vector<MercatorNode*>::iterator it = prefetch_nodes_.begin();
+                it != prefetch_nodes_.end(); ++it)
+            {
+                MercatorNode * node = *it;
+                service_->CancelAllNodeTasks(node);
+                ++node->generation_;
+                // Node keeps data loaded so far, the rest will be requested if node gets rendered
+                node->request_albedo_ = false;
+                node->request_heightmap_ = false;
+                node->request_labels_ = false;
+                node->request_icons_ = false;
+                // Parked map tile request won't be woken up by cancelled tasks
+                if (node->wait_map_tile_)
+                {
+                    node->wait_map_tile_ = false;
+                    node->request_map_tile_ = false;
                 }
-                rendered_nodes_.push_back(node);
             }
+            prefetch_nodes_.clear();
         }
         void MercatorTree::RequestTexture(MercatorNode* node)
         {
@@ -706,9 +1048,9 @@ namespace mgn {
             {
                 node->request_albedo_ = true;
                 if (node->has_labels_)
-                    service_->AddTask(new TextureTask(node, provider_));
+                    service_->AddTask(new TextureTask(node, provider_, tile_store_));
                 else
-                    service_->AddTask(new TextureLabelsTask(node, provider_));
+                    service_->AddTask(new TextureLabelsTask(node, provider_, tile_store_));
             }
         }
         void MercatorTree::RequestHeightmap(MercatorNode* node)
@@ -716,7 +1058,7 @@ namespace mgn {
             if (!node->request_heightmap_)
             {
                 node->request_heightmap_ = true;
-                service_->AddTask(new HeightmapTask(node, provider_));
+                service_->AddTask(new HeightmapTask(node, provider_, tile_store_));
             }
         }
         void MercatorTree::RequestLabels(MercatorNode* node)
@@ -743,27 +1085,81 @@ namespace mgn {
         {
             return frame_counter_;
         }
-        const bool MercatorTree::IsUsingPool()
+        bool MercatorTree::IntersectSegment(const math::Vector3& begin, const math::Vector3& end,
+            math::Vector3& intersection)
         {
+            const float kMSM = static_cast<float>(mgn::terrain::GetMapSizeMax());
+            const float height_multiplier = kMSM / 111111.0f / 360.0f;
+
+            float nearest_t = 2.0f;
+            // Descendant nodes share map tile of their ancestor
+            std::vector<const MercatorMapTile*> tested_map_tiles;
+            for (std::vector<MercatorNode*>::const_iterator it = rendered_nodes_.begin();
+                it != rendered_nodes_.end(); ++it)
+            {
+                MercatorNode * node = *it;
+                if (!node->has_renderable_)
+                    continue;
+                MercatorMapTile * map_tile = node->renderable_.GetMapTile();
+                const MercatorHeightData& height_data = map_tile->GetHeightData();
+                if (height_data.IsEmpty() ||
+                    std::find(tested_map_tiles.begin(), tested_map_tiles.end(), map_tile) != tested_map_tiles.end())
+                    continue;
+                tested_map_tiles.push_back(map_tile);
+
+                // Pixel coordinates to map tile samples, inverse of vertex shader transform
+                const MercatorNode * tile_node = map_tile->GetNode();
+                const float scale = static_cast<float>(1 << tile_node->lod_) / kMSM;
+                const float samples_x = static_cast<float>(height_data.width() - 1);
+                const float samples_y = static_cast<float>(height_data.height() - 1);
+                const math::Vector3 tile_begin(
+                    (begin.x * scale - tile_node->x_) * samples_x,
+                    ((kMSM - begin.z) * scale - tile_node->y_) * samples_y,
+                    begin.y / height_multiplier);
+                const math::Vector3 tile_end(
+                    (end.x * scale - tile_node->x_) * samples_x,
+                    ((kMSM - end.z) * scale - tile_node->y_) * samples_y,
+                    end.y / height_multiplier);
+                float t;
+                if (height_data.IntersectSegment(tile_begin, tile_end, t) && t < nearest_t)
+                    nearest_t = t;
+            }
+            if (nearest_t > 1.0f)
+                return false;
+            intersection = begin + nearest_t * (end - begin);
             return true;
         }
-        const bool MercatorTree::IsCollection()
+        const MercatorRenderStats& MercatorTree::GetRenderStats() const
+        {
+            return render_stats_;
+        }
+        ScreenGrid& MercatorTree::GetLabelGrid()
+        {
+            return label_grid_;
+        }
+        void MercatorTree::SetPrefetchBudget(int budget)
+        {
+            // Prefetched nodes shouldn't force rendered ones out of cache
+            const int kMaxBudget = node_cache_->capacity() / 2;
+            prefetch_budget_ = std::max(0, std::min(budget, kMaxBudget));
+            if (static_cast<int>(prefetch_nodes_.size()) > prefetch_budget_)
+                CancelPrefetch();
+        }
+        void MercatorTree::SetRequestTimeBudget(int budget)
+        {
+            request_time_budget_ = budget;
+        }
+        const bool MercatorTree::IsUsingPool()
         {
             return true;
         }
-        bool MercatorTree::RequestComparePriority::operator()(const RequestType& a, const RequestType& b) const
+        const bool MercatorTree::IsCollection()
         {
-            return (a.node->GetPriority() > b.node->GetPriority());
+            return true;
         }
-        bool TaskNodeCompareFunctor::operator()(Task * task1, Task * task2) const
+        bool MercatorTree::RequestComparePriority::operator()(const MercatorRequest* a, const MercatorRequest* b) const
         {
-            // Textures have first priority for fetch
-            if (task1->type() != task2->type())
-                return task1->type() < task2->type(); // texture over other requests
-            else if (task1->node()->lod() != task2->node()->lod())
-                return task1->node()->lod() < task2->node()->lod(); // lower LOD priority
-            else
-                return task1->node()->GetPriority() > task2->node()->GetPriority();
+            return (a->node->GetPriority() > b->node->GetPriority());
         }
 
     } // namespace terrain
@@ -3,13 +3,19 @@
 #define __MGN_TERRAIN_MERCATOR_TREE_H__
 
 #include "mgnTrMercatorNode.h"
+#include "mgnTrMercatorRequestQueue.h"
 
-#include <boost/unordered_set.hpp>
+#include "../mgnTrElevationPyramid.h"
+#include "../mgnTrIconDepthList.h"
+#include "../mgnTrIconSelectionIndex.h"
+#include "../mgnTrLabelTextTable.h"
+#include "../mgnTrScreenGrid.h"
+#include "../mgnTrTextureAtlas.h"
 
-#include <list>
-#include <set>
-#include <map>
-#include <queue>
+#include <boost/cstdint.hpp>
+#include <boost/thread/mutex.hpp>
+
+#include <vector>
 
 class mgnMdTerrainView;
 class mgnMdWorldPosition;
@@ -27,6 +33,8 @@ namespace mgn {
         class MercatorService;
         class MercatorProvider;
         class MercatorNodePool;
+        class MercatorNodeCache;
+        class MercatorTileStore;
         struct MercatorNodeKey;
         class Font;
 
@@ -38,6 +46,15 @@ namespace mgn {
         };
 #endif
 
+        //! Per-frame rendering statistics
+        struct MercatorRenderStats {
+            int num_drawn;      //!< number of drawn tiles
+            int num_culled;     //!< number of nodes rejected by frustum culling
+            int request_time;   //!< time spent on requests handling, microseconds
+            int num_handled_requests;
+            int num_pending_requests; //!< requests carried over to the next frame
+        };
+
         struct MercatorLodParams {
             int limit;
 
@@ -59,23 +76,15 @@ namespace mgn {
                 REQUEST_MAPTILE,
                 REQUEST_SPLIT,
                 REQUEST_MERGE,
-            };
-
-            struct RequestType {
-                MercatorNode* node;
-                int type;
-
-                RequestType(MercatorNode* node, int type) : node(node), type(type) {};
+                kNumRequestTypes
             };
 
             class RequestComparePriority {
             public:
-                bool operator()(const RequestType& a, const RequestType& b) const;
+                bool operator()(const MercatorRequest* a, const MercatorRequest* b) const;
             };
 
-            typedef std::list<RequestType> RequestQueue;
-            typedef std::set<MercatorNode*> NodeSet;
-            typedef std::priority_queue<MercatorNode*, std::vector<MercatorNode*>, MercatorNodeCompareLastOpened> NodeHeap;
+            typedef MercatorRequestQueue RequestQueue;
 
         public:
             MercatorTree(graphics::Renderer * renderer,
@@ -91,7 +100,15 @@ namespace mgn {
             void Render();
             void RenderLabels();
 
+            //! Synchronizes icon list with rendered nodes and orders it by distance to camera
             void UpdateIconList();
+            //! Removes icons of node from icon list
+            void RemoveIcons(MercatorNode * node);
+
+            //! Selection among icons rendered in the last frame, may be called from any thread
+            // Coordinates are window ones, results are ordered from nearest to farest icon.
+            void GetSelectedIcons(int x, int y, int radius, std::vector<int>& ids);
+            void GetSelectedPOIs(int x, int y, int radius, TMapObjectsVector& objects);
 
             const int grid_size() const;
 
@@ -99,12 +116,26 @@ namespace mgn {
             const bool IsCollection();
 
             int GetFrameCounter() const;
+            const MercatorRenderStats& GetRenderStats() const;
+            //! Eye space bounding boxes of labels rendered in the last frame
+            ScreenGrid& GetLabelGrid();
+
+            //! Finds the nearest intersection of segment with heightmaps of rendered tiles
+            // Segment is in pixel coordinates.
+            bool IntersectSegment(const math::Vector3& begin, const math::Vector3& end,
+                math::Vector3& intersection);
+
+            //! Sets maximum number of nodes being loaded speculatively ahead of camera
+            void SetPrefetchBudget(int budget);
+            //! Sets time spent on requests handling per frame, microseconds
+            void SetRequestTimeBudget(int budget);
 
         protected:
             void SplitQuadTreeNode(MercatorNode* node);
             void MergeQuadTreeNode(MercatorNode* node);
             void Request(MercatorNode* node, int type, bool priority = false);
             void Unrequest(MercatorNode* node);
+            RequestQueue& GetRequestQueue(int type);
             void HandleRequests(RequestQueue& requests);
             void HandleRenderRequests();
             void HandleInlineRequests();
@@ -115,19 +146,29 @@ namespace mgn {
             bool HandleMerge(MercatorNode* node);
 
             void PruneTree();
+            void LinkOpenNode(MercatorNode* node);
+            void UnlinkOpenNode(MercatorNode* node);
             void RefreshMapTile(MercatorNode* node, MercatorMapTile* old_tile, MercatorMapTile* new_tile);
             void FlushMapTileToRoot(MercatorNode* node);
             void ProcessDoneTasks();
             void PreprocessTree();
 
+            void GetCameraTile(int lod, float& x, float& y) const;
             void FillRenderedKeys();
             void PrepareNodes();
 
+            void PrefetchNodes();
+            bool PrefetchNode(const MercatorNodeKey& key);
+            void PromoteNode(MercatorNode* node);
+            void CancelPrefetch();
+
             void RequestTexture(MercatorNode* node);
             void RequestHeightmap(MercatorNode* node);
             void RequestLabels(MercatorNode* node);
             void RequestIcons(MercatorNode* node);
 
+            void UpdateIconSelection();
+
         private:
             graphics::Renderer * renderer_;     //!< pointer to renderer object
             graphics::Shader * shader_;         //!< pointer to shader object
@@ -140,20 +181,28 @@ namespace mgn {
 
             MercatorNode * root_;
             MercatorNodePool * node_pool_;
+            MercatorNodeCache * node_cache_;    //!< nodes storage for collection mode
 
             const int grid_size_;
             MercatorTileMesh * tile_;
             MercatorService * service_;         //!< service for filling data
+            MercatorTileStore * tile_store_;    //!< persistent storage of fetched tiles
+            ElevationPyramid elevation_pyramid_; //!< serves altitude queries of terrain view and renderers
 
             graphics::Texture * default_albedo_texture_;
             graphics::Texture * default_heightmap_texture_;
 
             RequestQueue inline_requests_;
             RequestQueue render_requests_;
-            NodeSet open_nodes_;
+            float request_costs_[kNumRequestTypes]; //!< running average handler time, microseconds
+            int request_time_budget_;       //!< per frame, microseconds
+            int request_time_left_;         //!< left for the current frame, microseconds
+            MercatorNode * open_head_;          //!< the least recently opened node of open nodes list
+            MercatorNode * open_tail_;          //!< the most recently opened node
 
             float earth_radius_;
             MercatorLodParams lod_params_;
+            MercatorRenderStats render_stats_;
 #ifdef DEBUG
             MercatorDebugInfo debug_info_;
 #endif
@@ -167,19 +216,28 @@ namespace mgn {
             std::vector<MercatorNode*> rendered_nodes_; //!< for optimized rendering of labels and other data
 
             std::vector<MercatorNodeKey> rendered_keys_;
-            typedef std::map<MercatorNodeKey, MercatorNode*> AllocatedNodes; // TODO: replace on LRU cache
-            std::map<MercatorNodeKey, MercatorNode*> allocated_nodes_;
-
-            typedef std::map<size_t, graphics::Texture*> IconTextureCache;
-            IconTextureCache icon_texture_cache_;
-
-            typedef std::map<unsigned int, graphics::Texture*> ShieldTextureCache;
-            ShieldTextureCache shield_texture_cache_;
-
-            std::vector<math::Rect> label_bounding_boxes_; //!< to not render overlapping labels
-            typedef boost::unordered_set<std::wstring> UsedLabelsSet;
-            UsedLabelsSet used_labels_; //!< to not render duplicated labels
-            std::vector<Icon*> icons_list_; //!< list of icons (any billboard objects) for rendering
+            std::vector<MercatorNode*> evicted_nodes_; //!< nodes evicted from cache during nodes preparation
+
+            // Speculative loading of nodes along camera trajectory
+            std::vector<MercatorNode*> prefetch_nodes_; //!< prefetched nodes with pending requests
+            math::Vector3 last_camera_position_;
+            boost::uint64_t last_prefetch_time_; //!< time of the last frame, us
+            float prefetch_direction_x_;    //!< normalized direction of prefetched trajectory in tiles
+            float prefetch_direction_y_;
+            int prefetch_lod_;              //!< LOD of prefetched trajectory, -1 before the first frame
+            int prefetch_zoom_;             //!< -1 zooming out, 1 zooming in, 0 otherwise
+            int prefetch_budget_;
+
+            TextureAtlas * icon_atlas_;     //!< bitmaps of icons by their hashes
+            TextureAtlas * shield_atlas_;   //!< bitmaps of shields by their hashes
+
+            ScreenGrid label_grid_; //!< bounding boxes of rendered labels, to not render overlapping ones
+            LabelIdSet used_labels_; //!< text ids of rendered labels, to not render duplicated ones
+            IconDepthList icons_list_; //!< icons (any billboard objects) for rendering, distant ones first
+            std::vector<MercatorNode*> icon_nodes_; //!< nodes with icons in the list
+            unsigned int icon_list_stamp_;
+            IconSelectionIndex icon_selection_; //!< window space quads of rendered icons
+            boost::mutex icon_selection_mutex_;
         };
 
     } // namespace terrain
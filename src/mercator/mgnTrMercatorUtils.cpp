@@ -158,4 +158,9 @@ namespace Mercator
     {
         return kZoomTable[level_of_detail] * kPixelsPerCm;
     }
+    double GroundResolution(double latitude, int level_of_detail)
+    {
+        latitude = Clip(latitude, kMinLatitude, kMaxLatitude);
+        return cos(latitude * M_PI / 180.0) * 2.0 * M_PI * kEarthRadius / (double)MapSize(level_of_detail);
+    }
 }
\ No newline at end of file
@@ -1,5 +1,6 @@
 #include "mgnMdTerrainView.h"
 #include "mgnTrConstants.h"
+#include "mgnTrElevationPyramid.h"
 #include "mgnTrMercatorUtils.h"
 
 #include <math.h>
@@ -92,7 +93,8 @@ mgnMdTerrainView::mgnMdTerrainView(mgnMdWorldPoint location,int altitude):
   mZFar(1000.0f),
   mFovX(PI*0.4f),
   mLod(5),
-  mTerrainProvider(NULL)
+  mTerrainProvider(NULL),
+  mElevationPyramid(NULL)
 {
 }
 
@@ -222,7 +224,7 @@ bool mgnMdTerrainView::isViewPathClear(double horz_dist, double tilt, double dxm
         path_height += height_step;
         point.mLatitude  -= trace_step * cos_a;
         point.mLongitude -= trace_step * sin_a;
-        double terrain_height = mTerrainProvider->getAltitude(point.mLatitude, point.mLongitude, (float)dxm);
+        double terrain_height = getAltitude(point.mLatitude, point.mLongitude, (float)dxm);
         if (path_height + kDeltaHeight < terrain_height)
             return false;
     }
@@ -255,8 +257,8 @@ void mgnMdTerrainView::update() const
     double sin_heading = sin(mHeading)/getMetersPerLongitude();
     mCamPoint.mLatitude  -= horz_dist * cos_heading;
     mCamPoint.mLongitude -= horz_dist * sin_heading;
-    mCenterHeight = (float)mTerrainProvider->getAltitude(mLocation.mLatitude, mLocation.mLongitude);
-    mGroundHeight = (float)mTerrainProvider->getAltitude(mCamPoint.mLatitude, mCamPoint.mLongitude);
+    mCenterHeight = (float)getAltitude(mLocation.mLatitude, mLocation.mLongitude);
+    mGroundHeight = (float)getAltitude(mCamPoint.mLatitude, mCamPoint.mLongitude);
     if (low_altitudes) // using ray tracing to find terrain intersection with view ray
     {
         //while (mGroundHeight - mCenterHeight > mCamDistance * sin(desired_tilt) - dh)
@@ -267,7 +269,7 @@ void mgnMdTerrainView::update() const
             mCamPoint = mLocation;
             mCamPoint.mLatitude  -= horz_dist * cos_heading;
             mCamPoint.mLongitude -= horz_dist * sin_heading;
-            mGroundHeight = (float)mTerrainProvider->getAltitude(mCamPoint.mLatitude, mCamPoint.mLongitude);
+            mGroundHeight = (float)getAltitude(mCamPoint.mLatitude, mCamPoint.mLongitude);
         }
     }
     else // high altitudes
@@ -499,6 +501,21 @@ void mgnMdTerrainView::setTerrainProvider(mgnMdTerrainProvider * provider)
 {
     mTerrainProvider = provider;
 }
+void mgnMdTerrainView::setElevationPyramid(const mgn::terrain::ElevationPyramid * pyramid)
+{
+    mElevationPyramid = pyramid;
+}
+const mgn::terrain::ElevationPyramid * mgnMdTerrainView::getElevationPyramid() const
+{
+    return mElevationPyramid;
+}
+double mgnMdTerrainView::getAltitude(double lat, double lon, float dxm) const
+{
+    double altitude;
+    if (mElevationPyramid && mElevationPyramid->GetAltitude(lat, lon, dxm, altitude))
+        return altitude;
+    return mTerrainProvider->getAltitude(lat, lon, dxm);
+}
 void mgnMdTerrainView::setPixelScale(float pixel_scale)
 {
     mPixelScale = pixel_scale;
@@ -674,9 +691,9 @@ void mgnMdTerrainView::IntersectionWithRay(const vec3& ray, vec3& intersection)
     vec3 left_point = getCamPosition();
     vec3 right_point = left_point + distance * ray;
     LocalToWorld(left_point.x, left_point.z, world_point);
-    float left_height = (float)mTerrainProvider->getAltitude(world_point.mLatitude, world_point.mLongitude);
+    float left_height = (float)getAltitude(world_point.mLatitude, world_point.mLongitude);
     LocalToWorld(right_point.x, right_point.z, world_point);
-    float right_height = (float)mTerrainProvider->getAltitude(world_point.mLatitude, world_point.mLongitude);
+    float right_height = (float)getAltitude(world_point.mLatitude, world_point.mLongitude);
     if ((left_point.y - left_height)*(right_point.y - right_height) < 0.0f)
     {
         const float kMinimumDistance = kMSM / 111111.0f / 360.0f; // = LocalToPixelDistance(1.0f,...)
@@ -684,7 +701,7 @@ void mgnMdTerrainView::IntersectionWithRay(const vec3& ray, vec3& intersection)
         {
             vec3 center_point = 0.5f*(left_point + right_point);
             LocalToWorld(center_point.x, center_point.z, world_point);
-            float center_height = (float)mTerrainProvider->getAltitude(world_point.mLatitude, world_point.mLongitude);
+            float center_height = (float)getAltitude(world_point.mLatitude, world_point.mLongitude);
             if ((left_point.y - left_height)*(center_point.y - center_height) < 0.0f)
             {
                 right_point = center_point;
@@ -729,10 +746,10 @@ void mgnMdTerrainView::IntersectionWithRayPixel(const vec3& ray, vec3& intersect
     LocalToPixel(left_point, left_point, kMSM);
     vec3 right_point = left_point + distance * ray;
     PixelToWorld(left_point.x, left_point.z, world_point, kMSM);
-    float left_height = (float)mTerrainProvider->getAltitude(world_point.mLatitude, world_point.mLongitude);
+    float left_height = (float)getAltitude(world_point.mLatitude, world_point.mLongitude);
     LocalToPixelDistance(left_height, left_height, kMSM);
     PixelToWorld(right_point.x, right_point.z, world_point, kMSM);
-    float right_height = (float)mTerrainProvider->getAltitude(world_point.mLatitude, world_point.mLongitude);
+    float right_height = (float)getAltitude(world_point.mLatitude, world_point.mLongitude);
     LocalToPixelDistance(right_height, right_height, kMSM);
     if ((left_point.y - left_height)*(right_point.y - right_height) < 0.0f)
     {
@@ -741,7 +758,7 @@ void mgnMdTerrainView::IntersectionWithRayPixel(const vec3& ray, vec3& intersect
         {
             vec3 center_point = 0.5f*(left_point + right_point);
             PixelToWorld(center_point.x, center_point.z, world_point, kMSM);
-            float center_height = (float)mTerrainProvider->getAltitude(world_point.mLatitude, world_point.mLongitude);
+            float center_height = (float)getAltitude(world_point.mLatitude, world_point.mLongitude);
             LocalToPixelDistance(center_height, center_height, kMSM);
             if ((left_point.y - left_height)*(center_point.y - center_height) < 0.0f)
             {
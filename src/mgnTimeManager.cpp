@@ -4,6 +4,14 @@
 
 #include <cstdlib>
 
+#if defined(_WIN32)
+#include <windows.h>
+#elif defined(__APPLE__)
+#include <mach/mach_time.h>
+#else
+#include <time.h>
+#endif
+
 namespace mgn {
 
     Timer::Timer(mgnU32_t interval)
@@ -139,5 +147,28 @@ namespace mgn {
     {
         return mFrameRate;
     }
+    boost::uint64_t TimeManager::GetPreciseTime()
+    {
+#if defined(_WIN32)
+        static LARGE_INTEGER frequency = { 0 };
+        if (frequency.QuadPart == 0)
+            QueryPerformanceFrequency(&frequency);
+        LARGE_INTEGER counter;
+        QueryPerformanceCounter(&counter);
+        const boost::uint64_t ticks = static_cast<boost::uint64_t>(counter.QuadPart);
+        const boost::uint64_t ticks_per_second = static_cast<boost::uint64_t>(frequency.QuadPart);
+        // Split to not overflow on multiplication
+        return ticks / ticks_per_second * 1000000U + ticks % ticks_per_second * 1000000U / ticks_per_second;
+#elif defined(__APPLE__)
+        static mach_timebase_info_data_t timebase = { 0, 0 };
+        if (timebase.denom == 0)
+            mach_timebase_info(&timebase);
+        return mach_absolute_time() / 1000U * timebase.numer / timebase.denom;
+#else
+        timespec time;
+        clock_gettime(CLOCK_MONOTONIC, &time);
+        return static_cast<boost::uint64_t>(time.tv_sec) * 1000000U + static_cast<boost::uint64_t>(time.tv_nsec) / 1000U;
+#endif
+    }
 
 } // namespace mgn
\ No newline at end of file
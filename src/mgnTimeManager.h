@@ -4,6 +4,8 @@
 
 #include "mgnBaseType.h"
 
+#include <boost/cstdint.hpp>
+
 namespace mgn {
 
     class Timer {
@@ -42,6 +44,10 @@ namespace mgn {
         mgnU32_t GetFrameTime() const; //!< returns time between two updates, ms
         float GetFrameRate() const; //!< returns number of frames per second (FPS)
 
+        //! Returns monotonic high resolution time, us
+        // Unlike GetTime it's read on every call, thus suits for measuring work within a frame.
+        static boost::uint64_t GetPreciseTime();
+
     private:
 
         mgnU32_t mLastTime;
@@ -15,24 +15,25 @@ namespace mgn {
 
         class Font;
         struct LabelData;
+        struct LabelGeometry;
 
         //! class for rendering atlas based labels
         class AtlasLabel : public Billboard {
         public:
+            //! Geometry is built beforehand, so only buffers are created here
             explicit AtlasLabel(mgn::graphics::Renderer * renderer, mgnMdTerrainView * terrain_view,
-                graphics::Shader * shader, const Font * font, const LabelData &data, int lod);
+                graphics::Shader * shader, const Font * font, const LabelData &data, const LabelGeometry &geometry);
             virtual ~AtlasLabel();
 
             const std::wstring& text() const;
+            unsigned int text_id() const;
 
             //! Returns 4 vertices in eye space
             void GetBoundingBox(const math::Matrix4& view, math::Rect& rect);
 
         protected:
             std::wstring mText; //!< text of label
-
-        private:
-            void Create(const Font * font, const LabelData &data, int lod);
+            unsigned int mTextId; //!< interned text, to detect duplicated labels
         };
 
     } // namespace terrain
@@ -1,5 +1,6 @@
 #include "mgnTrBillboard.h"
 #include "mgnTrConstants.h"
+#include "mgnTrLabelGeometry.h"
 
 #include "mgnMdTerrainView.h"
 
@@ -16,12 +17,16 @@ namespace mgn {
         , mTexture(NULL)
         , mScale(scale)
         , mOwnsTexture(true)
+        , mAtlas(NULL)
+        , mAtlasKey(0)
         {
         }
         Billboard::~Billboard()
         {
             if (mTexture && mOwnsTexture)
                 renderer_->DeleteTexture(mTexture);
+            if (mAtlas)
+                mAtlas->Release(mAtlasKey);
         }
         void Billboard::render()
         {
@@ -78,6 +83,13 @@ namespace mgn {
             mTexture = texture;
             mOwnsTexture = owns_texture;
         }
+        void Billboard::setTexture(TextureAtlas * atlas, TextureAtlas::Key key, const TextureRegion& region)
+        {
+            mTexture = region.texture;
+            mOwnsTexture = false;
+            mAtlas = atlas;
+            mAtlasKey = key;
+        }
         void Billboard::GetIconSize(vec2& size)
         {
             const float kMSM = static_cast<float>(mgn::terrain::GetMapSizeMax());
@@ -97,6 +109,29 @@ namespace mgn {
         {
             return mOrigin;
         }
+        bool Billboard::SetGeometry(const LabelGeometry& geometry, const TextureRegion& region)
+        {
+            mPosition = geometry.position;
+            mOrigin = geometry.origin;
+            mWidth = geometry.width;
+            mHeight = geometry.height;
+
+            if (geometry.indices.empty())
+                return false;
+            index_size_ = sizeof(unsigned short);
+            index_data_type_ = graphics::DataType::kUnsignedShort;
+            num_vertices_ = static_cast<unsigned int>(geometry.vertices.size() / 5);
+            num_indices_ = static_cast<unsigned int>(geometry.indices.size());
+            if (region.texture == NULL)
+                return MakeRenderable(const_cast<float*>(&geometry.vertices[0]),
+                    const_cast<unsigned short*>(&geometry.indices[0]));
+
+            // Texture coordinates are mapped into atlas region
+            std::vector<float> vertices(geometry.vertices);
+            for (size_t i = 0; i + 4 < vertices.size(); i += 5)
+                region.Map(vertices[i + 3], vertices[i + 4]);
+            return MakeRenderable(&vertices[0], const_cast<unsigned short*>(&geometry.indices[0]));
+        }
         void Billboard::FillAttributes()
         {
             // Specify attributes
@@ -3,12 +3,15 @@
 #define __MGN_TERRAIN_BILLBOARD_H__
 
 #include "mgnTrMesh.h"
+#include "mgnTrTextureAtlas.h"
 
 class mgnMdTerrainView;
 
 namespace mgn {
     namespace terrain {
 
+        struct LabelGeometry;
+
         class Billboard : protected Mesh {
         public:
             explicit Billboard(mgn::graphics::Renderer * renderer, mgnMdTerrainView * terrain_view,
@@ -23,12 +26,18 @@ namespace mgn {
             void render();
 
             void setTexture(graphics::Texture * texture, bool owns_texture = true);
+            //! Uses region of atlas page as texture, region is released on destruction
+            // Texture coordinates should be mapped into the region when geometry is created.
+            void setTexture(TextureAtlas * atlas, TextureAtlas::Key key, const TextureRegion& region);
             virtual void GetIconSize(vec2& size);
 
             const vec3& position() const;
             OriginType getOrigin() const; // need for selection icon id
 
         protected:
+            //! Takes placement from prebuilt geometry and creates its buffers
+            bool SetGeometry(const LabelGeometry& geometry, const TextureRegion& region = TextureRegion());
+
             mgnMdTerrainView * mTerrainView;
             graphics::Shader * mShader;
             graphics::Texture * mTexture;
@@ -39,6 +48,8 @@ namespace mgn {
             float mWidth;
             float mHeight;
             bool mOwnsTexture;
+            TextureAtlas * mAtlas;      //!< atlas which texture region is taken from
+            TextureAtlas::Key mAtlasKey;
 
         private:
             virtual void FillAttributes();
@@ -0,0 +1,114 @@
+#include "mgnTrBitmapResample.h"
+
+#include "MapDrawing/Graphics/mgnCommonMath.h"
+
+#include <boost/cstdint.hpp>
+
+#include <algorithm>
+
+namespace {
+
+    const unsigned int kLowChannelsMask = 0x00FF00FFU;
+    const unsigned int kHighChannelsMask = 0xFF00FF00U;
+
+    //! Interpolates all four channels of two pixels, weight is in range [0,255]
+    inline unsigned int LerpPixel(unsigned int c1, unsigned int c2, unsigned int weight)
+    {
+        // Every channel gets its own 16-bit lane, products never exceed 255*256
+        const unsigned int inv_weight = 256U - weight;
+        const unsigned int low = ((c1 & kLowChannelsMask) * inv_weight +
+            (c2 & kLowChannelsMask) * weight) >> 8;
+        const unsigned int high = ((c1 >> 8) & kLowChannelsMask) * inv_weight +
+            ((c2 >> 8) & kLowChannelsMask) * weight;
+        return (low & kLowChannelsMask) | (high & kHighChannelsMask);
+    }
+
+    //! Source sample position in 24.8 fixed point, same mapping as dst * src_size / dst_size
+    inline void SamplePosition(int dst, int src_size, int dst_size, int& index0, int& index1, unsigned int& weight)
+    {
+        const boost::uint64_t position = (static_cast<boost::uint64_t>(dst) * static_cast<boost::uint64_t>(src_size) << 8) /
+            static_cast<boost::uint64_t>(dst_size);
+        index0 = static_cast<int>(position >> 8);
+        index1 = std::min(index0 + 1, src_size - 1);
+        weight = static_cast<unsigned int>(position & 0xFFU);
+    }
+
+    void ResampleRow(const unsigned int * src, const int * columns0, const int * columns1,
+        const unsigned int * weights, unsigned int * dst, int dst_width)
+    {
+        for (int x = 0; x < dst_width; ++x)
+            dst[x] = LerpPixel(src[columns0[x]], src[columns1[x]], weights[x]);
+    }
+
+} // namespace
+
+namespace mgn {
+    namespace terrain {
+
+        void ResampleBitmap(const unsigned char * src, int src_width, int src_height,
+            unsigned char * dst, int dst_width, int dst_height)
+        {
+            const unsigned int * src_pixels = reinterpret_cast<const unsigned int*>(src);
+            unsigned int * dst_pixels = reinterpret_cast<unsigned int*>(dst);
+
+            // Horizontal sample positions are the same for every row
+            std::vector<int> columns0(dst_width);
+            std::vector<int> columns1(dst_width);
+            std::vector<unsigned int> weights(dst_width);
+            for (int x = 0; x < dst_width; ++x)
+                SamplePosition(x, src_width, dst_width, columns0[x], columns1[x], weights[x]);
+
+            // Horizontally resampled source rows, neighbour destination rows mostly share them
+            std::vector<unsigned int> rows(2 * dst_width);
+            unsigned int * row0 = &rows[0];
+            unsigned int * row1 = &rows[dst_width];
+            int row_y0 = -1;
+            int row_y1 = -1;
+            for (int y = 0; y < dst_height; ++y)
+            {
+                int y0, y1;
+                unsigned int weight;
+                SamplePosition(y, src_height, dst_height, y0, y1, weight);
+                if (y0 != row_y0)
+                {
+                    if (y0 == row_y1)
+                    {
+                        std::swap(row0, row1);
+                        row_y0 = row_y1;
+                        row_y1 = -1;
+                    }
+                    else
+                    {
+                        ResampleRow(src_pixels + y0 * src_width, &columns0[0], &columns1[0], &weights[0],
+                            row0, dst_width);
+                        row_y0 = y0;
+                    }
+                }
+                if (y1 != row_y1)
+                {
+                    ResampleRow(src_pixels + y1 * src_width, &columns0[0], &columns1[0], &weights[0],
+                        row1, dst_width);
+                    row_y1 = y1;
+                }
+                unsigned int * dst_row = dst_pixels + y * dst_width;
+                for (int x = 0; x < dst_width; ++x)
+                    dst_row[x] = LerpPixel(row0[x], row1[x], weight);
+            }
+        }
+        bool MakePotBitmap(int width, int height, const std::vector<unsigned char>& data,
+            int& pot_width, int& pot_height, std::vector<unsigned char>& pot_data)
+        {
+            if (((width & (width-1)) == 0) && ((height & (height-1)) == 0)) // already a pot texture
+                return false;
+            if (width <= 0 || height <= 0 || data.size() < static_cast<size_t>(width * height * 4))
+                return false;
+
+            pot_width = math::RoundToPowerOfTwo(width);
+            pot_height = math::RoundToPowerOfTwo(height);
+            pot_data.resize(pot_width * pot_height * 4);
+            ResampleBitmap(&data[0], width, height, &pot_data[0], pot_width, pot_height);
+            return true;
+        }
+
+    } // namespace terrain
+} // namespace mgn
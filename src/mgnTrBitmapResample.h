@@ -0,0 +1,24 @@
+#pragma once
+#ifndef __MGN_TERRAIN_BITMAP_RESAMPLE_H__
+#define __MGN_TERRAIN_BITMAP_RESAMPLE_H__
+
+#include <vector>
+
+namespace mgn {
+    namespace terrain {
+
+        //! Resamples RGBA8 bitmap with bilinear filter
+        // Two channels are interpolated per 32-bit operation with 8-bit fixed point weights,
+        // so result doesn't depend on byte order of the platform.
+        void ResampleBitmap(const unsigned char * src, int src_width, int src_height,
+            unsigned char * dst, int dst_width, int dst_height);
+
+        //! Rescales RGBA8 bitmap to power of two sizes (generateMipmaps isn't working on iOS with NPOT textures)
+        // @return False if bitmap already has power of two sizes, output is left untouched then.
+        bool MakePotBitmap(int width, int height, const std::vector<unsigned char>& data,
+            int& pot_width, int& pot_height, std::vector<unsigned char>& pot_data);
+
+    } // namespace terrain
+} // namespace mgn
+
+#endif
@@ -1,5 +1,49 @@
 #include "mgnTrConstants.h"
 
+#include <boost/cstdint.hpp>
+#include <boost/thread/thread.hpp>
+
+#include <algorithm>
+
+#if defined(_WIN32)
+#ifndef NOMINMAX
+#define NOMINMAX // std::min and std::max are used
+#endif
+#include <windows.h>
+#elif defined(__APPLE__)
+#include <sys/types.h>
+#include <sys/sysctl.h>
+#else
+#include <unistd.h>
+#endif
+
+namespace {
+    // Returns physical memory size of device, bytes, or zero if it's unknown
+    boost::uint64_t GetPhysicalMemorySize()
+    {
+#if defined(_WIN32)
+        MEMORYSTATUSEX status;
+        status.dwLength = sizeof(status);
+        if (GlobalMemoryStatusEx(&status))
+            return static_cast<boost::uint64_t>(status.ullTotalPhys);
+        return 0U;
+#elif defined(__APPLE__)
+        int mib[2] = { CTL_HW, HW_MEMSIZE };
+        boost::uint64_t size = 0U;
+        size_t length = sizeof(size);
+        if (sysctl(mib, 2, &size, &length, NULL, 0) == 0)
+            return size;
+        return 0U;
+#else
+        const long num_pages = sysconf(_SC_PHYS_PAGES);
+        const long page_size = sysconf(_SC_PAGE_SIZE);
+        if (num_pages > 0 && page_size > 0)
+            return static_cast<boost::uint64_t>(num_pages) * static_cast<boost::uint64_t>(page_size);
+        return 0U;
+#endif
+    }
+}
+
 namespace mgn {
     namespace terrain {
 
@@ -35,6 +79,34 @@ namespace mgn {
         {
             return 65;
         }
+        const int GetServiceWorkerCount()
+        {
+            // One hardware thread is left for rendering
+            const int num_threads = static_cast<int>(boost::thread::hardware_concurrency());
+            return std::min(std::max(num_threads - 1, 1), 4);
+        }
+        const size_t GetNodePoolMemoryBudget()
+        {
+            const boost::uint64_t kMinBudget = 32U << 20;
+            const boost::uint64_t kMaxBudget = 256U << 20;
+            const boost::uint64_t kDefaultBudget = 64U << 20;
+            const boost::uint64_t memory_size = GetPhysicalMemorySize();
+            if (memory_size == 0U)
+                return static_cast<size_t>(kDefaultBudget);
+            return static_cast<size_t>(std::min(std::max(memory_size / 32U, kMinBudget), kMaxBudget));
+        }
+        const int GetPrefetchBudget()
+        {
+            return 16;
+        }
+        const size_t GetTileStoreMaxSize()
+        {
+            return 256U << 20;
+        }
+        const int GetRequestTimeBudget()
+        {
+            return 4000;
+        }
 
     } // namespace terrain
 } // namespace mgn
\ No newline at end of file
@@ -1,5 +1,6 @@
 #include "mgnTrDottedLineRenderer.h"
 #include "mgnTrConstants.h"
+#include "mgnTrElevationPyramid.h"
 #include "mgnTrMercatorProvider.h"
 
 #include "mgnMdTerrainView.h"
@@ -15,7 +16,7 @@ namespace mgn {
             const float dxm = ((float)terrain_view->getMagnitude())/111111.0f;
             local.position.x = 0.0f;
             local.position.z = 0.0f;
-            local.position.y = (float)provider->GetAltitude(
+            local.position.y = (float)GetAltitude(terrain_view->getElevationPyramid(), provider,
                 world.point.mLatitude,
                 world.point.mLongitude,
                 dxm);
@@ -29,7 +30,7 @@ namespace mgn {
             terrain_view->WorldToLocal(world.point, local_x, local_y);
             local.position.x = (float)local_x - offset_x;
             local.position.z = (float)local_y - offset_y;
-            local.position.y = (float)provider->GetAltitude(
+            local.position.y = (float)GetAltitude(terrain_view->getElevationPyramid(), provider,
                 world.point.mLatitude,
                 world.point.mLongitude,
                 dxm);
@@ -226,16 +227,17 @@ namespace mgn {
         }
         void DottedLineRenderer::calcNormal(DottedLinePointInfo& point, float circle_size)
         {
+            const ElevationPyramid * pyramid = terrain_view_->getElevationPyramid();
             vec3 normal;
             float dxm = ((float)terrain_view_->getMagnitude())/111111.0f;
             // Fast, but inaccurate computation
             double d = circle_size * elementSize() * 1.41;
             double dlon = d / terrain_view_->getMetersPerLongitude();
             double dlat = d / terrain_view_->getMetersPerLatitude();
-            float h_x_plus  = (float)provider_->GetAltitude(point.world.point.mLatitude, point.world.point.mLongitude + dlon, dxm); // x+1
-            float h_x_minus = (float)provider_->GetAltitude(point.world.point.mLatitude, point.world.point.mLongitude - dlon, dxm); // x-1
-            float h_y_plus  = (float)provider_->GetAltitude(point.world.point.mLatitude + dlat, point.world.point.mLongitude, dxm); // y+1
-            float h_y_minus = (float)provider_->GetAltitude(point.world.point.mLatitude - dlat, point.world.point.mLongitude, dxm); // y-1
+            float h_x_plus  = (float)GetAltitude(pyramid, provider_, point.world.point.mLatitude, point.world.point.mLongitude + dlon, dxm); // x+1
+            float h_x_minus = (float)GetAltitude(pyramid, provider_, point.world.point.mLatitude, point.world.point.mLongitude - dlon, dxm); // x-1
+            float h_y_plus  = (float)GetAltitude(pyramid, provider_, point.world.point.mLatitude + dlat, point.world.point.mLongitude, dxm); // y+1
+            float h_y_minus = (float)GetAltitude(pyramid, provider_, point.world.point.mLatitude - dlat, point.world.point.mLongitude, dxm); // y-1
             float sx = h_x_plus - h_x_minus;
             float sy = h_y_plus - h_y_minus;
             // assume that tile cell sizes in both directions are the same
@@ -275,6 +277,7 @@ namespace mgn {
         }
         void DottedLineRenderer::calcNormal(DottedLinePointInfo& point, const vec3& to_target)
         {
+            const ElevationPyramid * pyramid = terrain_view_->getElevationPyramid();
             vec3 normal;
             if (isUsingFastNormalComputation())
             {
@@ -284,17 +287,17 @@ namespace mgn {
                 double dlon = d / terrain_view_->getMetersPerLongitude();
                 double dlat = d / terrain_view_->getMetersPerLatitude();
                 float sx =      
-                    (float)provider_->GetAltitude(point.world.point.mLatitude, 
+                    (float)GetAltitude(pyramid, provider_, point.world.point.mLatitude, 
                                                                      point.world.point.mLongitude + dlon,
                                                                      dxm) - // x+1
-                    (float)provider_->GetAltitude(point.world.point.mLatitude,
+                    (float)GetAltitude(pyramid, provider_, point.world.point.mLatitude,
                                                                      point.world.point.mLongitude - dlon,
                                                                      dxm);  // x-1
                 float sy =      
-                    (float)provider_->GetAltitude(point.world.point.mLatitude + dlat, 
+                    (float)GetAltitude(pyramid, provider_, point.world.point.mLatitude + dlat, 
                                                                      point.world.point.mLongitude,
                                                                      dxm) - // y+1
-                    (float)provider_->GetAltitude(point.world.point.mLatitude - dlat,
+                    (float)GetAltitude(pyramid, provider_, point.world.point.mLatitude - dlat,
                                                                      point.world.point.mLongitude,
                                                                      dxm);  // y-1
                 // assume that tile cell sizes in both directions are the same
@@ -316,16 +319,16 @@ namespace mgn {
                 p0.y = (float)point.local.position.y;
                 p1.x = (float)local_y;
                 p1.z = (float)(local_x + d);
-                p1.y = (float)provider_->GetAltitude(point.world.point.mLatitude, point.world.point.mLongitude + dlon);
+                p1.y = (float)GetAltitude(pyramid, provider_, point.world.point.mLatitude, point.world.point.mLongitude + dlon);
                 p2.x = (float)(local_y + d);
                 p2.z = (float)local_x;
-                p2.y = (float)provider_->GetAltitude(point.world.point.mLatitude + dlat, point.world.point.mLongitude);
+                p2.y = (float)GetAltitude(pyramid, provider_, point.world.point.mLatitude + dlat, point.world.point.mLongitude);
                 p3.x = (float)local_y;
                 p3.z = (float)(local_x - d);
-                p3.y = (float)provider_->GetAltitude(point.world.point.mLatitude, point.world.point.mLongitude - dlon);
+                p3.y = (float)GetAltitude(pyramid, provider_, point.world.point.mLatitude, point.world.point.mLongitude - dlon);
                 p4.x = (float)(local_y - d);
                 p4.z = (float)local_x;
-                p4.y = (float)provider_->GetAltitude(point.world.point.mLatitude - dlat, point.world.point.mLongitude);
+                p4.y = (float)GetAltitude(pyramid, provider_, point.world.point.mLatitude - dlat, point.world.point.mLongitude);
                 vec3 n1 = (p1 - p0) ^ (p2 - p0);
                 vec3 n2 = (p2 - p0) ^ (p3 - p0);
                 vec3 n3 = (p3 - p0) ^ (p4 - p0);
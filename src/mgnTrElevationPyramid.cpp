@@ -0,0 +1,444 @@
+#include "mgnTrElevationPyramid.h"
+
+#include "mgnTrConstants.h"
+#include "mgnTrMercatorProvider.h"
+#include "mgnTrMercatorUtils.h"
+
+#include "MapDrawing/Graphics/mgnImage.h"
+
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <limits>
+
+namespace {
+    // Offset aligned by 8 bytes
+    inline size_t Align(size_t offset)
+    {
+        return (offset + 7) & ~static_cast<size_t>(7);
+    }
+
+    inline bool IsBigEndianHost()
+    {
+        const boost::uint16_t value = 1;
+        return *reinterpret_cast<const unsigned char*>(&value) == 0;
+    }
+    // File is little endian, conversion is the same in both directions
+    inline boost::uint16_t LittleEndian(boost::uint16_t value)
+    {
+        if (!IsBigEndianHost())
+            return value;
+        return static_cast<boost::uint16_t>((value >> 8) | (value << 8));
+    }
+    inline boost::uint32_t LittleEndian(boost::uint32_t value)
+    {
+        if (!IsBigEndianHost())
+            return value;
+        return (value >> 24) | ((value >> 8) & 0xFF00U) | ((value << 8) & 0xFF0000U) | (value << 24);
+    }
+    inline boost::int16_t LittleEndian(boost::int16_t value)
+    {
+        return static_cast<boost::int16_t>(LittleEndian(static_cast<boost::uint16_t>(value)));
+    }
+    inline boost::int32_t LittleEndian(boost::int32_t value)
+    {
+        return static_cast<boost::int32_t>(LittleEndian(static_cast<boost::uint32_t>(value)));
+    }
+}
+
+namespace mgn {
+    namespace terrain {
+
+        using namespace elevation_pyramid;
+
+        namespace {
+            void ConvertByteOrder(FileHeader& header)
+            {
+                header.magic = LittleEndian(header.magic);
+                header.tile_size = LittleEndian(header.tile_size);
+                header.num_levels = LittleEndian(header.num_levels);
+                header.num_entries = LittleEndian(header.num_entries);
+                header.num_blocks = LittleEndian(header.num_blocks);
+                header.samples_offset = LittleEndian(header.samples_offset);
+            }
+            void ConvertByteOrder(LevelHeader& level)
+            {
+                level.lod = LittleEndian(level.lod);
+                level.min_x = LittleEndian(level.min_x);
+                level.min_y = LittleEndian(level.min_y);
+                level.num_x = LittleEndian(level.num_x);
+                level.num_y = LittleEndian(level.num_y);
+                level.first_entry = LittleEndian(level.first_entry);
+            }
+            void ConvertByteOrder(TileEntry& entry)
+            {
+                entry.block = LittleEndian(entry.block);
+                entry.min_height = LittleEndian(entry.min_height);
+                entry.max_height = LittleEndian(entry.max_height);
+            }
+        }
+
+        float DecodeHeightmapPixel(const unsigned char * pixel)
+        {
+            const float kHeightMin = mgn::terrain::GetHeightMin();
+            const float kHeightRange = mgn::terrain::GetHeightRange();
+            unsigned int x = static_cast<unsigned int>(pixel[0]);
+            unsigned int y = static_cast<unsigned int>(pixel[1]);
+            float norm_height = static_cast<float>(255 * x + y) / 65535.0f;
+            return kHeightMin + kHeightRange * norm_height;
+        }
+
+        ElevationPyramid::ElevationPyramid()
+        : header_()
+        , entries_(NULL)
+        , samples_(NULL)
+        , block_size_(0)
+        {
+        }
+        ElevationPyramid::~ElevationPyramid()
+        {
+            Close();
+        }
+        bool ElevationPyramid::Open(const std::string& filename)
+        {
+            Close();
+            try
+            {
+                boost::interprocess::file_mapping mapping(filename.c_str(), boost::interprocess::read_only);
+                region_.reset(new boost::interprocess::mapped_region(mapping, boost::interprocess::read_only));
+            }
+            catch (...)
+            {
+                region_.reset();
+                return false;
+            }
+            const unsigned char * data = static_cast<const unsigned char*>(region_->get_address());
+            const size_t size = region_->get_size();
+
+            // Validate layout before any query may touch it
+            FileHeader header;
+            if (size < sizeof(FileHeader))
+            {
+                Close();
+                return false;
+            }
+            memcpy(&header, data, sizeof(FileHeader));
+            ConvertByteOrder(header);
+            const size_t levels_offset = sizeof(FileHeader);
+            const size_t entries_offset = levels_offset + header.num_levels * sizeof(LevelHeader);
+            const size_t block_size = static_cast<size_t>(header.tile_size) * header.tile_size;
+            if (header.magic != kMagic || header.tile_size < 2 || header.num_levels <= 0 ||
+                entries_offset + header.num_entries * sizeof(TileEntry) > header.samples_offset ||
+                header.samples_offset + header.num_blocks * block_size * sizeof(boost::int16_t) > size)
+            {
+                Close();
+                return false;
+            }
+            header_ = header;
+            levels_.resize(header.num_levels);
+            memcpy(&levels_[0], data + levels_offset, header.num_levels * sizeof(LevelHeader));
+            for (std::vector<LevelHeader>::iterator it = levels_.begin(); it != levels_.end(); ++it)
+                ConvertByteOrder(*it);
+            entries_ = reinterpret_cast<const TileEntry*>(data + entries_offset);
+            samples_ = reinterpret_cast<const boost::int16_t*>(data + header.samples_offset);
+            block_size_ = static_cast<int>(block_size);
+            return true;
+        }
+        void ElevationPyramid::Close()
+        {
+            levels_.clear();
+            entries_ = NULL;
+            samples_ = NULL;
+            block_size_ = 0;
+            region_.reset();
+        }
+        bool ElevationPyramid::IsOpen() const
+        {
+            return !levels_.empty();
+        }
+        bool ElevationPyramid::GetAltitude(double latitude, double longitude, float dxm, double& altitude) const
+        {
+            if (levels_.empty())
+                return false;
+
+            // Point is taken in pixels of the finest LOD, so it's precise enough for any level
+            const int kMaxLod = GetMaxLod();
+            const double kTileResolution = static_cast<double>(GetTileResolution());
+            int pixel_x, pixel_y;
+            Mercator::LatLonToPixelXY(latitude, longitude, kMaxLod, pixel_x, pixel_y);
+            const double meters_per_pixel = Mercator::GroundResolution(latitude, kMaxLod);
+            const int cells = header_.tile_size - 1;
+
+            for (int i = header_.num_levels - 1; i >= 0; --i)
+            {
+                const LevelHeader& level = levels_[i];
+                if (level.lod > kMaxLod)
+                    continue;
+                const double pixels_per_tile = kTileResolution * static_cast<double>(1 << (kMaxLod - level.lod));
+                // Skip levels finer than requested
+                if (dxm > 0.0f && meters_per_pixel * pixels_per_tile / cells < static_cast<double>(dxm))
+                    continue;
+                const double x = static_cast<double>(pixel_x) / pixels_per_tile;
+                const double y = static_cast<double>(pixel_y) / pixels_per_tile;
+                const int tile_x = static_cast<int>(x);
+                const int tile_y = static_cast<int>(y);
+                TileEntry entry;
+                if (!FindEntry(level, tile_x, tile_y, entry))
+                    continue;
+
+                const boost::int16_t * samples = samples_ + static_cast<size_t>(entry.block) * block_size_;
+                const double u = (x - tile_x) * cells;
+                const double v = (y - tile_y) * cells;
+                const int i0 = std::min(static_cast<int>(u), cells - 1);
+                const int j0 = std::min(static_cast<int>(v), cells - 1);
+                const double fu = u - i0;
+                const double fv = v - j0;
+                const boost::int16_t * row0 = samples + j0 * header_.tile_size + i0;
+                const boost::int16_t * row1 = row0 + header_.tile_size;
+                const boost::int16_t h00 = LittleEndian(row0[0]);
+                const boost::int16_t h10 = LittleEndian(row0[1]);
+                const boost::int16_t h01 = LittleEndian(row1[0]);
+                const boost::int16_t h11 = LittleEndian(row1[1]);
+                if (h00 == kNoData || h10 == kNoData || h01 == kNoData || h11 == kNoData)
+                    continue; // partially covered tile, try coarser level
+                const double h0 = h00 + (h10 - h00) * fu;
+                const double h1 = h01 + (h11 - h01) * fu;
+                altitude = h0 + (h1 - h0) * fv;
+                return true;
+            }
+            return false;
+        }
+        bool ElevationPyramid::GetTileBounds(const PackedTileKey& key, float& min_height, float& max_height) const
+        {
+            for (std::vector<LevelHeader>::const_iterator it = levels_.begin(); it != levels_.end(); ++it)
+            {
+                if (it->lod != key.level())
+                    continue;
+                TileEntry entry;
+                if (!FindEntry(*it, key.x(), key.y(), entry))
+                    return false;
+                min_height = static_cast<float>(entry.min_height);
+                max_height = static_cast<float>(entry.max_height);
+                return true;
+            }
+            return false;
+        }
+        int ElevationPyramid::min_lod() const
+        {
+            return (!levels_.empty()) ? levels_.front().lod : -1;
+        }
+        int ElevationPyramid::max_lod() const
+        {
+            return (!levels_.empty()) ? levels_.back().lod : -1;
+        }
+        bool ElevationPyramid::FindEntry(const LevelHeader& level, int tile_x, int tile_y, TileEntry& entry) const
+        {
+            const int i = tile_x - level.min_x;
+            const int j = tile_y - level.min_y;
+            if (i < 0 || j < 0 || i >= level.num_x || j >= level.num_y)
+                return false;
+            entry = entries_[level.first_entry + j * level.num_x + i];
+            ConvertByteOrder(entry);
+            return entry.block != kNoBlock;
+        }
+        double GetAltitude(const ElevationPyramid * pyramid, MercatorProvider * provider,
+            double latitude, double longitude, float dxm)
+        {
+            double altitude;
+            if (pyramid && pyramid->GetAltitude(latitude, longitude, dxm, altitude))
+                return altitude;
+            return provider->GetAltitude(latitude, longitude, NULL, dxm);
+        }
+
+        ElevationPyramidBuilder::ElevationPyramidBuilder(int tile_size)
+        : tile_size_(tile_size)
+        {
+        }
+        bool ElevationPyramidBuilder::AddHeightmap(int lod, int x, int y, const graphics::Image& image)
+        {
+            const int width = image.width();
+            const int height = image.height();
+            const int bpp = image.bpp();
+            if (width < 2 || height < 2 || bpp < 2)
+                return false;
+
+            Samples& samples = tiles_[PackedTileKey(lod, x, y)];
+            samples.resize(tile_size_ * tile_size_);
+            const unsigned char * pixels = image.pixels();
+            for (int j = 0; j < tile_size_; ++j)
+            {
+                // Sample grids of both image and tile include borders
+                const float v = static_cast<float>(j * (height - 1)) / static_cast<float>(tile_size_ - 1);
+                const int j0 = std::min(static_cast<int>(v), height - 2);
+                const float fv = v - static_cast<float>(j0);
+                for (int i = 0; i < tile_size_; ++i)
+                {
+                    const float u = static_cast<float>(i * (width - 1)) / static_cast<float>(tile_size_ - 1);
+                    const int i0 = std::min(static_cast<int>(u), width - 2);
+                    const float fu = u - static_cast<float>(i0);
+                    const unsigned char * p00 = pixels + (j0 * width + i0) * bpp;
+                    const unsigned char * p10 = p00 + bpp;
+                    const unsigned char * p01 = p00 + width * bpp;
+                    const unsigned char * p11 = p01 + bpp;
+                    const float h0 = DecodeHeightmapPixel(p00) + (DecodeHeightmapPixel(p10) - DecodeHeightmapPixel(p00)) * fu;
+                    const float h1 = DecodeHeightmapPixel(p01) + (DecodeHeightmapPixel(p11) - DecodeHeightmapPixel(p01)) * fu;
+                    const float h = h0 + (h1 - h0) * fv;
+                    const float clamped = std::min(std::max(static_cast<float>(floor(h + 0.5f)), -32767.0f), 32767.0f);
+                    samples[j * tile_size_ + i] = static_cast<boost::int16_t>(clamped);
+                }
+            }
+            return true;
+        }
+        void ElevationPyramidBuilder::BuildLevels(int min_lod)
+        {
+            if (tiles_.empty())
+                return;
+            const int cells = tile_size_ - 1;
+            const int max_lod = tiles_.rbegin()->first.level();
+            for (int lod = max_lod; lod > min_lod; --lod)
+            {
+                TileMap::iterator begin = tiles_.lower_bound(PackedTileKey(lod, 0, 0));
+                TileMap::iterator end = tiles_.lower_bound(PackedTileKey(lod + 1, 0, 0));
+                for (TileMap::iterator it = begin; it != end; ++it)
+                {
+                    const PackedTileKey parent_key = it->first.Parent();
+                    TileMap::iterator parent_it = tiles_.find(parent_key);
+                    if (parent_it != tiles_.end() && parent_it->second.size() == it->second.size() &&
+                        std::find(parent_it->second.begin(), parent_it->second.end(), kNoData) == parent_it->second.end())
+                        continue; // complete parent has been added explicitly
+                    if (parent_it == tiles_.end())
+                        parent_it = tiles_.insert(std::make_pair(parent_key, Samples(tile_size_ * tile_size_, kNoData))).first;
+
+                    // Every second sample of child covers a half of parent
+                    Samples& parent = parent_it->second;
+                    const Samples& child = it->second;
+                    const int offset_x = (it->first.x() - 2 * parent_key.x()) * cells;
+                    const int offset_y = (it->first.y() - 2 * parent_key.y()) * cells;
+                    for (int j = 0; j < tile_size_; ++j)
+                    {
+                        const int cj = 2 * j - offset_y;
+                        if (cj < 0 || cj > cells)
+                            continue;
+                        for (int i = 0; i < tile_size_; ++i)
+                        {
+                            const int ci = 2 * i - offset_x;
+                            if (ci < 0 || ci > cells)
+                                continue;
+                            boost::int16_t sample = child[cj * tile_size_ + ci];
+                            if (sample != kNoData)
+                                parent[j * tile_size_ + i] = sample;
+                        }
+                    }
+                }
+            }
+        }
+        bool ElevationPyramidBuilder::Write(const std::string& filename) const
+        {
+            if (tiles_.empty())
+                return false;
+
+            // Collect levels with bounding rectangles
+            std::vector<LevelHeader> levels;
+            for (TileMap::const_iterator it = tiles_.begin(); it != tiles_.end(); ++it)
+            {
+                const PackedTileKey& key = it->first;
+                if (levels.empty() || levels.back().lod != key.level())
+                {
+                    LevelHeader level;
+                    level.lod = key.level();
+                    level.min_x = level.num_x = key.x(); // num is used as max until finished
+                    level.min_y = level.num_y = key.y();
+                    level.first_entry = 0;
+                    levels.push_back(level);
+                }
+                LevelHeader& level = levels.back();
+                level.min_x = std::min<boost::int32_t>(level.min_x, key.x());
+                level.min_y = std::min<boost::int32_t>(level.min_y, key.y());
+                level.num_x = std::max<boost::int32_t>(level.num_x, key.x());
+                level.num_y = std::max<boost::int32_t>(level.num_y, key.y());
+            }
+            boost::uint32_t num_entries = 0;
+            for (std::vector<LevelHeader>::iterator it = levels.begin(); it != levels.end(); ++it)
+            {
+                it->num_x = it->num_x - it->min_x + 1;
+                it->num_y = it->num_y - it->min_y + 1;
+                it->first_entry = num_entries;
+                num_entries += static_cast<boost::uint32_t>(it->num_x * it->num_y);
+            }
+
+            // Fill index, blocks go in the order of tiles
+            TileEntry empty_entry;
+            empty_entry.block = kNoBlock;
+            empty_entry.min_height = empty_entry.max_height = 0;
+            std::vector<TileEntry> entries(num_entries, empty_entry);
+            std::vector<const Samples*> blocks;
+            size_t level_index = 0;
+            for (TileMap::const_iterator it = tiles_.begin(); it != tiles_.end(); ++it)
+            {
+                const PackedTileKey& key = it->first;
+                while (levels[level_index].lod != key.level())
+                    ++level_index;
+                const LevelHeader& level = levels[level_index];
+                boost::int16_t min_height = std::numeric_limits<boost::int16_t>::max();
+                boost::int16_t max_height = std::numeric_limits<boost::int16_t>::min();
+                for (Samples::const_iterator its = it->second.begin(); its != it->second.end(); ++its)
+                {
+                    if (*its == kNoData)
+                        continue;
+                    min_height = std::min(min_height, *its);
+                    max_height = std::max(max_height, *its);
+                }
+                if (min_height > max_height)
+                    continue; // no data at all
+                TileEntry& entry = entries[level.first_entry + (key.y() - level.min_y) * level.num_x + (key.x() - level.min_x)];
+                entry.block = static_cast<boost::uint32_t>(blocks.size());
+                entry.min_height = min_height;
+                entry.max_height = max_height;
+                blocks.push_back(&it->second);
+            }
+
+            FileHeader header;
+            header.magic = kMagic;
+            header.tile_size = tile_size_;
+            header.num_levels = static_cast<boost::int32_t>(levels.size());
+            header.num_entries = num_entries;
+            header.num_blocks = static_cast<boost::uint32_t>(blocks.size());
+            const size_t index_end = sizeof(FileHeader) + levels.size() * sizeof(LevelHeader) + entries.size() * sizeof(TileEntry);
+            header.samples_offset = static_cast<boost::uint32_t>(Align(index_end));
+
+            // File is written in little endian regardless of the host
+            const size_t padding_size = header.samples_offset - index_end;
+            ConvertByteOrder(header);
+            for (std::vector<LevelHeader>::iterator it = levels.begin(); it != levels.end(); ++it)
+                ConvertByteOrder(*it);
+            for (std::vector<TileEntry>::iterator it = entries.begin(); it != entries.end(); ++it)
+                ConvertByteOrder(*it);
+
+            std::FILE * file = std::fopen(filename.c_str(), "wb");
+            if (!file)
+                return false;
+            bool written = std::fwrite(&header, sizeof(header), 1, file) == 1;
+            written = written && std::fwrite(&levels[0], sizeof(LevelHeader), levels.size(), file) == levels.size();
+            written = written && std::fwrite(&entries[0], sizeof(TileEntry), entries.size(), file) == entries.size();
+            const char padding[8] = { 0 };
+            written = written && (padding_size == 0 || std::fwrite(padding, padding_size, 1, file) == 1);
+            Samples block;
+            for (std::vector<const Samples*>::const_iterator it = blocks.begin(); written && it != blocks.end(); ++it)
+            {
+                block.resize((*it)->size());
+                for (size_t i = 0; i < block.size(); ++i)
+                    block[i] = LittleEndian((**it)[i]);
+                written = std::fwrite(&block[0], sizeof(boost::int16_t), block.size(), file) == block.size();
+            }
+            written = (std::fclose(file) == 0) && written;
+            if (!written)
+                std::remove(filename.c_str());
+            return written;
+        }
+
+    } // namespace terrain
+} // namespace mgn
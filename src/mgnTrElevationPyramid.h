@@ -0,0 +1,144 @@
+#pragma once
+#ifndef __MGN_TERRAIN_ELEVATION_PYRAMID_H__
+#define __MGN_TERRAIN_ELEVATION_PYRAMID_H__
+
+#include "mgnTrPackedTileKey.h"
+
+#include <boost/cstdint.hpp>
+#include <boost/scoped_ptr.hpp>
+
+#include <map>
+#include <string>
+#include <vector>
+
+namespace boost {
+    namespace interprocess {
+        class mapped_region;
+    }
+}
+
+namespace mgn {
+    namespace graphics {
+        class Image;
+    }
+
+    namespace terrain {
+
+        class MercatorProvider;
+
+        //! Unpacks height in meters from heightmap image pixel (two bytes of normalized height)
+        float DecodeHeightmapPixel(const unsigned char * pixel);
+
+        /*! Elevation pyramid file structure.
+        ** Elevation is stored in Mercator tiles of (tile_size x tile_size) int16 samples in meters,
+        ** border samples are shared with neighbour tiles. Each level has a dense index over
+        ** bounding rectangle of its tiles, index entries keep per tile min/max heights.
+        ** Sample blocks follow in (lod, Morton) order, so neighbour tiles are close in file.
+        ** All values are little endian.
+        **
+        ** FileHeader | LevelHeader[num_levels] | TileEntry[num_entries] | samples
+        */
+        namespace elevation_pyramid {
+
+            const boost::uint32_t kMagic = 0x3150454D; // 'MEP1'
+            const boost::uint32_t kNoBlock = 0xFFFFFFFFU;
+            const boost::int16_t kNoData = -32768;
+
+            struct FileHeader {
+                boost::uint32_t magic;
+                boost::int32_t tile_size;
+                boost::int32_t num_levels;
+                boost::uint32_t num_entries;
+                boost::uint32_t num_blocks;
+                boost::uint32_t samples_offset;     //!< offset of the first sample block, bytes
+            };
+            struct LevelHeader {
+                boost::int32_t lod;
+                boost::int32_t min_x;
+                boost::int32_t min_y;
+                boost::int32_t num_x;
+                boost::int32_t num_y;
+                boost::uint32_t first_entry;        //!< index of the first entry of this level
+            };
+            struct TileEntry {
+                boost::uint32_t block;              //!< sample block index or kNoBlock
+                boost::int16_t min_height;
+                boost::int16_t max_height;
+            };
+
+        } // namespace elevation_pyramid
+
+        /*! Elevation pyramid reader.
+        ** File is memory mapped, queries don't lock or allocate memory,
+        ** thus may be done from any thread once pyramid is opened.
+        */
+        class ElevationPyramid {
+        public:
+            ElevationPyramid();
+            ~ElevationPyramid();
+
+            bool Open(const std::string& filename);
+            void Close();
+            bool IsOpen() const;
+
+            //! Bilinear altitude at the most detailed level that has data for the point
+            // @param dxm Desired sample spacing in meters, finer levels are skipped. Negative value means any.
+            // @return Returns false if there is no data for the point.
+            bool GetAltitude(double latitude, double longitude, float dxm, double& altitude) const;
+
+            //! Gets height bounds of the tile
+            bool GetTileBounds(const PackedTileKey& key, float& min_height, float& max_height) const;
+
+            int min_lod() const;
+            int max_lod() const;
+
+        private:
+            ElevationPyramid(const ElevationPyramid&);
+            ElevationPyramid& operator=(const ElevationPyramid&);
+
+            //! Returns entry in host byte order
+            bool FindEntry(const elevation_pyramid::LevelHeader& level, int tile_x, int tile_y,
+                elevation_pyramid::TileEntry& entry) const;
+
+            boost::scoped_ptr<boost::interprocess::mapped_region> region_;
+            elevation_pyramid::FileHeader header_;              //!< host byte order copy
+            std::vector<elevation_pyramid::LevelHeader> levels_;  //!< host byte order copies, sorted by LOD
+            const elevation_pyramid::TileEntry * entries_;      //!< mapped, little endian
+            const boost::int16_t * samples_;                    //!< mapped, little endian
+            int block_size_;    //!< number of samples in a block
+        };
+
+        //! Altitude from elevation pyramid when it has data for the point, otherwise from provider
+        // @param pyramid May be NULL or closed, provider is used then.
+        double GetAltitude(const ElevationPyramid * pyramid, MercatorProvider * provider,
+            double latitude, double longitude, float dxm = -1.0f);
+
+        /*! Elevation pyramid converter.
+        ** Collects heightmap tiles in the encoding returned by MercatorProvider::GetHeightmap,
+        ** builds coarser levels and writes pyramid file.
+        */
+        class ElevationPyramidBuilder {
+        public:
+            //! @param tile_size Number of samples per tile side, should be (2^n + 1)
+            explicit ElevationPyramidBuilder(int tile_size);
+
+            //! Adds heightmap image, it's resampled if its size differs from tile size
+            bool AddHeightmap(int lod, int x, int y, const graphics::Image& image);
+
+            //! Makes missing tiles of levels down to min_lod by decimation of finer ones
+            void BuildLevels(int min_lod);
+
+            bool Write(const std::string& filename) const;
+
+        private:
+            typedef std::vector<boost::int16_t> Samples;
+            typedef std::map<PackedTileKey, Samples> TileMap; //!< ordered by LOD, then by Morton code
+
+            int tile_size_;
+            TileMap tiles_;
+        };
+
+    } // namespace terrain
+} // namespace mgn
+
+#endif
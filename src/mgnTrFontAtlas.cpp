@@ -6,58 +6,28 @@
 #include FT_FREETYPE_H
 #include "ftbitmap.h" // for embolden operations
 
+#include <boost/thread/locks.hpp>
+
 #include <algorithm>
+#include <cmath>
 #include <cstring>
 #include <cassert>
 
 namespace {
-    void Bitmap_Allocate(mgnMdBitmap * bitmap, int width, int height, int bytes_per_pixel)
-    {
-        bitmap->mWidth = width;
-        bitmap->mHeight = height;
-        bitmap->mBitsPerPix = bytes_per_pixel << 3;
-        bitmap->mpData = new unsigned char[width * height * bytes_per_pixel];
-    }
-    void Bitmap_FillWithZeroes(mgnMdBitmap * bitmap)
-    {
-        const size_t width = static_cast<size_t>(bitmap->mWidth);
-        const size_t height = static_cast<size_t>(bitmap->mHeight);
-        const size_t bpp = static_cast<size_t>(bitmap->mBitsPerPix >> 3);
-        size_t size = width * height * bpp * sizeof(unsigned char);
-        memset(bitmap->mpData, 0, size);
-    }
-    void Bitmap_SubData(mgnMdBitmap * bitmap, int offset_x, int offset_y, int w, int h, const unsigned char* data)
-    {
-        const int width = static_cast<int>(bitmap->mWidth);
-        const int height = static_cast<int>(bitmap->mHeight);
-        const int bpp = static_cast<int>(bitmap->mBitsPerPix >> 3);
-        unsigned char* pixels = bitmap->mpData;
+    const int kPageSize = 512;              // atlas page is power of two, 1 MB of RGBA
+    const unsigned int kFirstLatinChar = 0x20U;
+    const unsigned int kLastLatinChar = 0x7EU;
+    const int kMaxSearchedPages = 4;        // full pages searched for glyphs of text before the current one
 
-        int max_x = offset_x + w;
-        int max_y = offset_y + h;
-        assert(max_x <= width);
-        assert(max_y <= height);
-
-        // Data should have the same bpp as source
-        for (int y = 0; y < h; ++y)
-        {
-            unsigned char* dst = &pixels[((y + offset_y)*width + offset_x)*bpp];
-            const unsigned char* src = &data[(y*w)*bpp];
-            memcpy(dst, src, w * bpp);
-        }
-    }
-    void Bitmap_SubDataColored(mgnMdBitmap * bitmap, int offset_x, int offset_y, int w, int h,
-        const unsigned char* data, const Color& color)
+    void Pixels_SubDataColored(unsigned char * pixels, int width, int height, int offset_x, int offset_y,
+        int w, int h, const unsigned char* data, const Color& color)
     {
-        const int width = static_cast<int>(bitmap->mWidth);
-        const int height = static_cast<int>(bitmap->mHeight);
-        const int bpp = static_cast<int>(bitmap->mBitsPerPix >> 3);
+        const int bpp = 4;
 
         int max_x = offset_x + w;
         int max_y = offset_y + h;
         assert(max_x <= width);
         assert(max_y <= height);
-        assert(bpp == 4);
 
         unsigned char r = (unsigned char)(color.mR * 255.0f);
         unsigned char g = (unsigned char)(color.mG * 255.0f);
@@ -70,7 +40,7 @@ namespace {
         {
             for (int x = offset_x; x < max_x; ++x)
             {
-                unsigned char* dst = &bitmap->mpData[(y*width + x)*bpp];
+                unsigned char* dst = &pixels[(y*width + x)*bpp];
                 *dst++ = r;
                 *dst++ = g;
                 *dst++ = b;
@@ -78,19 +48,16 @@ namespace {
             }
         }
     }
-    void Bitmap_SubDataAlphaBlend(mgnMdBitmap * bitmap, int offset_x, int offset_y, int w, int h,
-        const unsigned char* data, const Color& color)
+    void Pixels_SubDataAlphaBlend(unsigned char * pixels, int width, int height, int offset_x, int offset_y,
+        int w, int h, const unsigned char* data, const Color& color)
     {
         // Same as above, but using alpha blend for data modification
-        const int width = static_cast<int>(bitmap->mWidth);
-        const int height = static_cast<int>(bitmap->mHeight);
-        const int bpp = static_cast<int>(bitmap->mBitsPerPix >> 3);
+        const int bpp = 4;
 
         int max_x = offset_x + w;
         int max_y = offset_y + h;
         assert(max_x <= width);
         assert(max_y <= height);
-        assert(bpp == 4);
 
         const unsigned char* src = data;
 
@@ -99,7 +66,7 @@ namespace {
         {
             for (int x = offset_x; x < max_x; ++x)
             {
-                unsigned char* dst = &bitmap->mpData[(y*width + x)*bpp];
+                unsigned char* dst = &pixels[(y*width + x)*bpp];
 
                 float base_r = (float)(*(dst  ))/255.0f;
                 float base_g = (float)(*(dst+1))/255.0f;
@@ -121,142 +88,92 @@ namespace {
             }
         }
     }
-    void Bitmap_ChangeChannelsToFour(mgnMdBitmap * bitmap)
+    // Makes distance field of glyph extended by spread on each side, edge is at 128
+    // Distances are found by 8-point sequential Euclidean distance transform.
+    struct SeedOffset {
+        int dx, dy;
+        int DistanceSqr() const { return dx * dx + dy * dy; }
+    };
+    void Propagate(std::vector<SeedOffset>& grid, int width, int x, int y, int offset_x, int offset_y)
     {
-        assert(bitmap->mBitsPerPix == 8);
-        const int width = static_cast<int>(bitmap->mWidth);
-        const int height = static_cast<int>(bitmap->mHeight);
-        const int bpp = 4;
-        unsigned char* pixels = new unsigned char[width * height * bpp];
-
-        unsigned char* src = bitmap->mpData;
-        unsigned char* dst = pixels;
-
-        for (int y = 0; y < height; ++y)
-            for (int x = 0; x < width; ++x)
-            {
-                *dst++ = 0xFF;
-                *dst++ = 0xFF;
-                *dst++ = 0xFF;
-                *dst++ = *src++;
-            }
-        
-        delete[] bitmap->mpData;
-        bitmap->mpData = pixels;
-        bitmap->mBitsPerPix = 32;
+        const int nx = x + offset_x;
+        const int ny = y + offset_y;
+        if (nx < 0 || ny < 0 || nx >= width || ny >= static_cast<int>(grid.size()) / width)
+            return;
+        SeedOffset candidate = grid[ny * width + nx];
+        candidate.dx += offset_x;
+        candidate.dy += offset_y;
+        SeedOffset& current = grid[y * width + x];
+        if (candidate.DistanceSqr() < current.DistanceSqr())
+            current = candidate;
     }
-    void Bitmap_ChangeChannelsToFourAndColorize(mgnMdBitmap * bitmap, const Color& color)
+    void TransformDistance(std::vector<SeedOffset>& grid, int width, int height)
     {
-        assert(bitmap->mBitsPerPix == 8);
-        const int width = static_cast<int>(bitmap->mWidth);
-        const int height = static_cast<int>(bitmap->mHeight);
-        const int bpp = 4;
-        unsigned char* pixels = new unsigned char[width * height * bpp];
-
-        unsigned char* src = bitmap->mpData;
-        unsigned char* dst = pixels;
-
-        unsigned char r = (unsigned char)(color.mR * 255.0f);
-        unsigned char g = (unsigned char)(color.mG * 255.0f);
-        unsigned char b = (unsigned char)(color.mB * 255.0f);
         for (int y = 0; y < height; ++y)
+        {
             for (int x = 0; x < width; ++x)
             {
-                *dst++ = r;
-                *dst++ = g;
-                *dst++ = b;
-                *dst++ = *src++;
+                Propagate(grid, width, x, y, -1, 0);
+                Propagate(grid, width, x, y, 0, -1);
+                Propagate(grid, width, x, y, -1, -1);
+                Propagate(grid, width, x, y, 1, -1);
             }
-
-        delete[] bitmap->mpData;
-        bitmap->mpData = pixels;
-        bitmap->mBitsPerPix = 32;
-    }
-    template <typename T>
-    static T RoundToPowerOfTwo(T x)
-    {
-        T n = 1;
-        while (n < x)
-            n <<= 1;
-        return n;
-    }
-    static int InterpolateColor(int c1, int c2, float alpha)
-    {
-        int a1 = (c1 & 0xff000000) >> 24;
-        int b1 = (c1 & 0xff0000) >> 16;
-        int g1 = (c1 & 0x00ff00) >> 8;
-        int r1 = (c1 & 0x0000ff);
-        int a2 = (c2 & 0xff000000) >> 24;
-        int b2 = (c2 & 0xff0000) >> 16;
-        int g2 = (c2 & 0x00ff00) >> 8;
-        int r2 = (c2 & 0x0000ff);
-        int r = r1 + (int)((r2-r1)*alpha);
-        int g = g1 + (int)((g2-g1)*alpha);
-        int b = b1 + (int)((b2-b1)*alpha);
-        int a = a1 + (int)((a2-a1)*alpha);
-        return (a << 24) | (b << 16) | (g << 8) | r;
+            for (int x = width - 1; x >= 0; --x)
+                Propagate(grid, width, x, y, 1, 0);
+        }
+        for (int y = height - 1; y >= 0; --y)
+        {
+            for (int x = width - 1; x >= 0; --x)
+            {
+                Propagate(grid, width, x, y, 1, 0);
+                Propagate(grid, width, x, y, 0, 1);
+                Propagate(grid, width, x, y, -1, 1);
+                Propagate(grid, width, x, y, 1, 1);
+            }
+            for (int x = 0; x < width; ++x)
+                Propagate(grid, width, x, y, -1, 0);
+        }
     }
-    void Bitmap_MakePotTextureFromNpot(mgnMdBitmap * bitmap, float* scale_x, float* scale_y)
+    void BuildDistanceField(const unsigned char * coverage, int w, int h, int spread,
+        std::vector<unsigned char>& field)
     {
-        const int width = static_cast<int>(bitmap->mWidth);
-        const int height = static_cast<int>(bitmap->mHeight);
-        const int bpp = 4;
-
-        if (((width & (width-1)) != 0) || ((height & (height-1)) != 0))
+        const int width = w + 2 * spread;
+        const int height = h + 2 * spread;
+        const int kFar = 0x3FFF;
+        SeedOffset far_seed = { kFar, kFar };
+        SeedOffset zero_seed = { 0, 0 };
+        std::vector<SeedOffset> to_inside(width * height, far_seed);
+        std::vector<SeedOffset> to_outside(width * height, zero_seed);
+        for (int y = 0; y < h; ++y)
         {
-            // Need to make POT
-            unsigned int * data = reinterpret_cast<unsigned int*>(bitmap->mpData);
-            int w2 = RoundToPowerOfTwo(width);
-            int h2 = RoundToPowerOfTwo(height);
-
-            // Rescale image to power of 2
-            int new_size = w2 * h2;
-            unsigned int * new_data = new unsigned int[new_size];
-            for (int dh2 = 0; dh2 < h2; ++dh2)
+            for (int x = 0; x < w; ++x)
             {
-                float rh = (float)dh2 / (float)h2;
-                float y = rh * (float)height;
-                int dh = (int)y;
-                int dh1 = std::min<int>(dh+1, height-1);
-                float ry = y - (float)dh; // fract part of y
-                for (int dw2 = 0; dw2 < w2; ++dw2)
-                {
-                    float rw = (float)dw2 / (float)w2;
-                    float x = rw * (float)width;
-                    int dw = (int)x;
-                    int dw1 = std::min<int>(dw+1, width-1);
-                    float rx = x - (float)dw; // fract part of x
-
-                    // We will use bilinear interpolation
-                    int sample1 = (int) data[dw +width*dh ];
-                    int sample2 = (int) data[dw1+width*dh ];
-                    int sample3 = (int) data[dw +width*dh1];
-                    int sample4 = (int) data[dw1+width*dh1];
-
-                    int color1 = InterpolateColor(sample1, sample2, rx);
-                    int color2 = InterpolateColor(sample3, sample4, rx);;
-                    int color3 = InterpolateColor(color1, color2, ry);
-                    new_data[dw2+w2*dh2] = (unsigned int)color3;
-                }
+                if (coverage[y * w + x] < 128)
+                    continue;
+                const int index = (y + spread) * width + x + spread;
+                to_inside[index] = zero_seed;
+                to_outside[index] = far_seed;
             }
-            // Finally
-            delete[] bitmap->mpData;
-            bitmap->mpData = reinterpret_cast<unsigned char*>(new_data);
-            bitmap->mWidth = static_cast<unsigned short>(w2);
-            bitmap->mHeight = static_cast<unsigned short>(h2);
-            if (scale_x)
-                *scale_x = (float)w2/(float)width;
-            if (scale_y)
-                *scale_y = (float)h2/(float)height;
         }
-        else
+        TransformDistance(to_inside, width, height);
+        TransformDistance(to_outside, width, height);
+
+        field.resize(width * height);
+        const float kScale = 127.0f / static_cast<float>(spread);
+        for (int i = 0; i < width * height; ++i)
         {
-            if (scale_x)
-                *scale_x = 1.0f;
-            if (scale_y)
-                *scale_y = 1.0f;
+            // Positive inside glyph, edge lies between pixels of different sides
+            float distance = sqrtf(static_cast<float>(to_outside[i].DistanceSqr())) -
+                sqrtf(static_cast<float>(to_inside[i].DistanceSqr()));
+            distance += (distance > 0.0f) ? -0.5f : 0.5f;
+            float value = 128.0f + distance * kScale;
+            field[i] = static_cast<unsigned char>(std::min(std::max(value, 0.0f), 255.0f));
         }
     }
+    boost::uint64_t GlyphKey(int page, unsigned int charcode)
+    {
+        return (static_cast<boost::uint64_t>(page) << 32) | static_cast<boost::uint64_t>(charcode);
+    }
 }
 
 namespace mgn {
@@ -266,49 +183,147 @@ namespace mgn {
             const char* filename, int font_height, const Color& color, float pixel_size)
         {
             Font * font = new Font(renderer, pixel_size);
-            font->Make(filename, font_height, color);
+            if (font->Make(filename, font_height, color))
+                font->Preload(kFirstLatinChar, kLastLatinChar);
             return font;
         }
         Font * Font::CreateWithBorder(graphics::Renderer * renderer,
             const char* filename, int font_height, int border, const Color& color, const Color& border_color, float pixel_size)
         {
             Font * font = new Font(renderer, pixel_size);
-            font->MakeWithBorder(filename, font_height, border, color, border_color);
+            if (font->MakeWithBorder(filename, font_height, border, color, border_color))
+                font->Preload(kFirstLatinChar, kLastLatinChar);
+            return font;
+        }
+        Font * Font::CreateDistanceField(graphics::Renderer * renderer,
+            const char* filename, int font_height, int border, const Color& color, const Color& border_color, float pixel_size)
+        {
+            Font * font = new Font(renderer, pixel_size);
+            if (font->MakeDistanceField(filename, font_height, border, color, border_color))
+                font->Preload(kFirstLatinChar, kLastLatinChar);
             return font;
         }
         Font::Font(graphics::Renderer * renderer, float pixel_size)
             : renderer_(renderer)
-            , texture_(NULL)
             , scale_(pixel_size)
-            , scale_x_(1.0f)
-            , scale_y_(1.0f)
+            , library_(NULL)
+            , face_(NULL)
+            , border_(0)
+            , spread_(0)
+            , color_(0.0f, 0.0f, 0.0f)
+            , border_color_(0.0f, 0.0f, 0.0f)
         {
 
         }
         Font::~Font()
         {
-            if (texture_)
-                renderer_->DeleteTexture(texture_);
+            for (std::vector<Page>::iterator it = pages_.begin(); it != pages_.end(); ++it)
+            {
+                if (it->texture)
+                    renderer_->DeleteTexture(it->texture);
+            }
+            if (face_)
+                FT_Done_Face(face_);
+            if (library_)
+                FT_Done_FreeType(library_);
         }
         const FontCharInfo* Font::info(unsigned int charcode) const
         {
-            InfoMap::const_iterator it = info_map_.find(charcode);
-            if (it != info_map_.end())
-                return &(it->second);
-            else
-                return NULL;
+            boost::lock_guard<boost::mutex> guard(mutex_);
+            const FontCharInfo * glyph = NULL;
+            if (FindGlyph(charcode, glyph) == kPageFull)
+            {
+                AddPage();
+                FindGlyph(charcode, glyph);
+            }
+            return glyph;
+        }
+        int Font::GetGlyphs(const wchar_t* text, std::vector<const FontCharInfo*>& glyphs) const
+        {
+            boost::lock_guard<boost::mutex> guard(mutex_);
+            if (pages_.empty())
+                AddPage();
+
+            // Full pages are searched first, so repeated texts don't duplicate glyphs in the current page
+            const int last_page = static_cast<int>(pages_.size()) - 1;
+            for (int page = last_page - 1; page >= std::max(0, last_page - kMaxSearchedPages); --page)
+            {
+                if (FindGlyphs(page, text, glyphs))
+                    return page;
+            }
+
+            // Glyphs of text are taken from the same page, so label is rendered with one texture.
+            // If the current page gets full, the whole text is placed into a new one.
+            bool is_new_page = false;
+            for (;;)
+            {
+                glyphs.clear();
+                GlyphResult result = kGlyphPlaced;
+                for (const wchar_t* p = text; *p != L'\0'; ++p)
+                {
+                    const FontCharInfo * glyph = NULL;
+                    result = FindGlyph(static_cast<unsigned int>(*p), glyph);
+                    if (result == kPageFull)
+                    {
+                        if (!is_new_page)
+                            break;
+                        // Text doesn't fit into empty page, the rest characters are skipped
+                        result = kGlyphMissing;
+                        continue;
+                    }
+                    if (glyph)
+                        glyphs.push_back(glyph);
+                }
+                if (result != kPageFull)
+                    break;
+                AddPage();
+                is_new_page = true;
+            }
+            return static_cast<int>(pages_.size()) - 1;
+        }
+        void Font::Preload(unsigned int first_charcode, unsigned int last_charcode) const
+        {
+            boost::lock_guard<boost::mutex> guard(mutex_);
+            for (unsigned int charcode = first_charcode; charcode <= last_charcode; ++charcode)
+            {
+                const FontCharInfo * glyph = NULL;
+                if (FindGlyph(charcode, glyph) == kPageFull)
+                {
+                    AddPage();
+                    FindGlyph(charcode, glyph);
+                }
+            }
         }
         const float Font::atlas_width() const
         {
-            return (float)texture_->width();
+            return static_cast<float>(kPageSize);
         }
         const float Font::atlas_height() const
         {
-            return (float)texture_->height();
+            return static_cast<float>(kPageSize);
         }
-        graphics::Texture * Font::texture() const
+        graphics::Texture * Font::texture(int page_index) const
         {
-            return texture_;
+            boost::lock_guard<boost::mutex> guard(mutex_);
+            if (page_index < 0 || page_index >= static_cast<int>(pages_.size()))
+                return NULL;
+            Page& page = pages_[page_index];
+            if (page.texture == NULL)
+            {
+                // Page is updated partially as glyphs are added, so it has no mipmaps to get stale
+                renderer_->CreateTextureFromData(page.texture, kPageSize, kPageSize,
+                    graphics::Image::Format::kRGBA8, graphics::Texture::Filter::kLinear, &page.pixels[0]);
+            }
+            else if (page.dirty_top < page.dirty_bottom)
+            {
+                page.texture->SetData(0, page.dirty_top, kPageSize, page.dirty_bottom - page.dirty_top,
+                    &page.pixels[page.dirty_top * kPageSize * 4]);
+            }
+            page.dirty_top = kPageSize;
+            page.dirty_bottom = 0;
+            if (page.full && page.texture)
+                std::vector<unsigned char>().swap(page.pixels); // nothing will be added to page anymore
+            return page.texture;
         }
         const float Font::scale() const
         {
@@ -316,33 +331,45 @@ namespace mgn {
         }
         const float Font::scale_x() const
         {
-            return scale_x_;
+            return 1.0f; // pages are power of two, so no rescale is needed
         }
         const float Font::scale_y() const
         {
-            return scale_y_;
+            return 1.0f;
+        }
+        bool Font::distance_field() const
+        {
+            return spread_ > 0;
+        }
+        void Font::SetupShader(graphics::Shader * shader) const
+        {
+            if (spread_ == 0)
+                return;
+            // Distances are normalized to 0..1, edge is at 0.5 and spread covers half of the range
+            const float kDistanceScale = 0.5f / static_cast<float>(spread_);
+            shader->Uniform1i("u_distance_field", 1);
+            shader->Uniform4f("u_text_color", color_.mR, color_.mG, color_.mB, 1.0f);
+            shader->Uniform4f("u_outline_color", border_color_.mR, border_color_.mG, border_color_.mB, 1.0f);
+            shader->Uniform1f("u_outline_width", static_cast<float>(border_) * kDistanceScale);
+            // Labels are rendered at atlas resolution, so edge is smoothed over one texel
+            shader->Uniform1f("u_edge_smoothing", 0.5f * kDistanceScale);
         }
-        void Font::Make(const char* filename, int font_height, const Color& color)
+        void Font::ResetShader(graphics::Shader * shader)
+        {
+            shader->Uniform1i("u_distance_field", 0);
+        }
+        bool Font::Make(const char* filename, int font_height, const Color& color)
         {
             // Font scale is an actual scale multiplier for labels rendered with selected font
             // Use 2x increased quality to get finer fonts
             font_height <<= 1;
             scale_ *= 0.5f;
 
-            mgnMdBitmap bitmap;
-            bitmap.mpData = 0;
-
-            if (MakeAtlas(filename, font_height, color, &bitmap))
-            {
-                assert(bitmap.mBitsPerPix == 32);
-                // Create texture from data
-                renderer_->CreateTextureFromData(texture_, bitmap.mWidth, bitmap.mHeight,
-                    graphics::Image::Format::kRGBA8, graphics::Texture::Filter::kTrilinear, bitmap.mpData);
-            }
-            if (bitmap.mpData)
-                delete[] bitmap.mpData;
+            color_ = color;
+            border_ = 0;
+            return LoadFace(filename, font_height);
         }
-        void Font::MakeWithBorder(const char* filename, int font_height, int border, const Color& color, const Color& border_color)
+        bool Font::MakeWithBorder(const char* filename, int font_height, int border, const Color& color, const Color& border_color)
         {
             // Font scale is an actual scale multiplier for labels rendered with selected font
             // Use 2x increased quality to get finer fonts
@@ -350,312 +377,212 @@ namespace mgn {
             border <<= 1;
             scale_ *= 0.5f;
 
-            mgnMdBitmap bitmap;
-            bitmap.mpData = 0;
-
-            if (MakeAtlasWithBorder(filename, font_height, border, color, border_color, &bitmap))
-            {
-                assert(bitmap.mBitsPerPix == 32);
-                LOG_INFO(0, ("creating font %hu x %hu", bitmap.mWidth, bitmap.mHeight));
-                // Create texture from data
-                renderer_->CreateTextureFromData(texture_, bitmap.mWidth, bitmap.mHeight,
-                    graphics::Image::Format::kRGBA8, graphics::Texture::Filter::kTrilinear, bitmap.mpData);
-            }
-            if (bitmap.mpData)
-                delete[] bitmap.mpData;
+            color_ = color;
+            border_color_ = border_color;
+            border_ = border;
+            return LoadFace(filename, font_height);
         }
-        bool Font::MakeAtlas(const char* filename, int font_height, const Color& color, mgnMdBitmap * bitmap)
+        bool Font::MakeDistanceField(const char* filename, int font_height, int border, const Color& color, const Color& border_color)
+        {
+            // Distance field scales well, so it's rasterized at base size without 2x quality increase
+            color_ = color;
+            border_color_ = border_color;
+            border_ = border;
+            spread_ = border + 2; // outline should stay in range with some room for smoothing
+            return LoadFace(filename, font_height);
+        }
+        bool Font::LoadFace(const char* filename, int font_height)
         {
-            FT_Library ft;
-            FT_Face face;
-
             // Initialize library
-            if (FT_Init_FreeType(&ft))
+            if (FT_Init_FreeType(&library_))
             {
                 fprintf(stderr, "FreeType library initialization failed");
+                library_ = NULL;
                 return false;
             }
 
             // Load a font
-            if (FT_New_Face(ft, filename, 0, &face))
+            if (FT_New_Face(library_, filename, 0, &face_))
             {
                 fprintf(stderr, "Failed to load a font %s!\n", filename);
-                FT_Done_FreeType(ft);
+                face_ = NULL;
                 return false;
             }
 
             // Set encoding
-            if (FT_Select_Charmap(face, FT_ENCODING_UNICODE))
+            if (FT_Select_Charmap(face_, FT_ENCODING_UNICODE))
             {
                 fprintf(stderr, "Failed to set encoding\n");
-                FT_Done_FreeType(ft);
+                FT_Done_Face(face_);
+                face_ = NULL;
                 return false;
             }
 
             // Set font height in pixels
-            FT_Set_Pixel_Sizes(face, 0, font_height);
-
-            FT_GlyphSlot g = face->glyph;
-
-            const unsigned int kMaxTextureWidth = 1024U;
-
-            int w,h;
-            int roww = 0;
-            int rowh = 0;
-            w = 0;
-            h = 0;
-
-            FT_ULong charcode;
-            FT_UInt gindex;
-
-            // Find minimum size for a texture holding all visible ASCII characters
-            charcode = FT_Get_First_Char(face, &gindex);
-            while (gindex != 0)
-            {
-                // Load glyph
-                if (FT_Load_Char(face, charcode, FT_LOAD_RENDER)) {
-                    fprintf(stderr, "Loading character %lu failed!\n", charcode);
-                    continue;
-                }
-                if (roww + g->bitmap.width + 1 >= kMaxTextureWidth) {
-                    w = std::max(w, roww);
-                    h += rowh;
-                    roww = 0;
-                    rowh = 0;
-                }
-                roww += g->bitmap.width + 1;
-                rowh = std::max(rowh, g->bitmap.rows);
-                // Goto next charcode
-                charcode = FT_Get_Next_Char(face, charcode, &gindex);
-            }
-
-            w = std::max(w, roww);
-            h += rowh;
-
-            if (w == 0 || h == 0)
-            {
-                FT_Done_FreeType(ft);
-                return false;
-            }
-
-            // Create an image that will be used to hold all ASCII glyphs
-            Bitmap_Allocate(bitmap, w, h, 4);
-            Bitmap_FillWithZeroes(bitmap);
-
-            // Paste all glyph bitmaps into the image, remembering the offset
-            int ox = 0;
-            int oy = 0;
-
-            rowh = 0;
-
-            charcode = FT_Get_First_Char(face, &gindex);
-            while (gindex != 0)
+            FT_Set_Pixel_Sizes(face_, 0, font_height);
+            return true;
+        }
+        bool Font::FindGlyphs(int page, const wchar_t* text, std::vector<const FontCharInfo*>& glyphs) const
+        {
+            glyphs.clear();
+            for (const wchar_t* p = text; *p != L'\0'; ++p)
             {
-                if (FT_Load_Char(face, charcode, FT_LOAD_RENDER)) {
-                    fprintf(stderr, "Loading character %lu failed!\n", charcode);
-                    continue;
-                }
-
-                if (ox + g->bitmap.width + 1 >= kMaxTextureWidth) {
-                    oy += rowh;
-                    rowh = 0;
-                    ox = 0;
-                }
-
-                Bitmap_SubDataColored(bitmap, ox, oy, g->bitmap.width, g->bitmap.rows, g->bitmap.buffer, color);
-
-                unsigned int i = static_cast<unsigned int>(charcode);
-
-                FontCharInfo & info = info_map_[i];
-
-                info.advance_x = static_cast<float>(g->advance.x >> 6);
-                info.advance_y = static_cast<float>(g->advance.y >> 6);
-
-                info.bitmap_width = static_cast<float>(g->bitmap.width);
-                info.bitmap_height = static_cast<float>(g->bitmap.rows);
-
-                info.bitmap_left = static_cast<float>(g->bitmap_left);
-                info.bitmap_top = static_cast<float>(g->bitmap_top);
-
-                info.texcoord_x = ox / (float)w;
-                info.texcoord_y = oy / (float)h;
-
-                rowh = std::max(rowh, g->bitmap.rows);
-                ox += g->bitmap.width + 1;
-
-                // Goto next charcode
-                charcode = FT_Get_Next_Char(face, charcode, &gindex);
+                const unsigned int charcode = static_cast<unsigned int>(*p);
+                InfoMap::const_iterator it = info_map_.find(GlyphKey(page, charcode));
+                if (it != info_map_.end())
+                    glyphs.push_back(&(it->second));
+                else if (missing_chars_.find(charcode) == missing_chars_.end())
+                    return false;
             }
-
-            FT_Done_Face(face);
-
-            FT_Done_FreeType(ft);
-
-            // Rescale texture to power of two
-            Bitmap_MakePotTextureFromNpot(bitmap, &scale_x_, &scale_y_);
-
             return true;
         }
-        bool Font::MakeAtlasWithBorder(const char* filename, int font_height, int border, 
-            const Color& color, const Color& border_color, mgnMdBitmap * bitmap)
+        Font::GlyphResult Font::FindGlyph(unsigned int charcode, const FontCharInfo*& glyph) const
         {
-            FT_Library ft;
-            FT_Face face;
-
-            // Initialize library
-            if (FT_Init_FreeType(&ft))
+            glyph = NULL;
+            if (pages_.empty())
+                AddPage();
+            const int page = static_cast<int>(pages_.size()) - 1;
+            const boost::uint64_t key = GlyphKey(page, charcode);
+            InfoMap::const_iterator it = info_map_.find(key);
+            if (it != info_map_.end())
             {
-                fprintf(stderr, "FreeType library initialization failed");
-                return false;
+                glyph = &(it->second);
+                return kGlyphPlaced;
             }
-
-            // Load a font
-            if (FT_New_Face(ft, filename, 0, &face))
+            if (missing_chars_.find(charcode) != missing_chars_.end())
+                return kGlyphMissing;
+
+            FontCharInfo info;
+            GlyphResult result = RasterizeGlyph(charcode, info);
+            if (result == kGlyphPlaced)
+                glyph = &(info_map_.insert(std::make_pair(key, info)).first->second);
+            else if (result == kGlyphMissing)
+                missing_chars_.insert(charcode);
+            return result;
+        }
+        Font::GlyphResult Font::RasterizeGlyph(unsigned int charcode, FontCharInfo& info) const
+        {
+            if (face_ == NULL)
+                return kGlyphMissing;
+            if (FT_Get_Char_Index(face_, charcode) == 0)
+                return kGlyphMissing;
+            if (FT_Load_Char(face_, charcode, FT_LOAD_RENDER))
             {
-                fprintf(stderr, "Failed to load a font %s!\n", filename);
-                FT_Done_FreeType(ft);
-                return false;
+                fprintf(stderr, "Loading character %u failed!\n", charcode);
+                return kGlyphMissing;
             }
+            FT_GlyphSlot g = face_->glyph;
 
-            // Set encoding
-            if (FT_Select_Charmap(face, FT_ENCODING_UNICODE))
-            {
-                fprintf(stderr, "Failed to set encoding\n");
-                FT_Done_FreeType(ft);
-                return false;
-            }
-
-            // Set font height in pixels
-            FT_Set_Pixel_Sizes(face, 0, font_height);
-
-            FT_GlyphSlot g = face->glyph;
-
-            const unsigned int kMaxTextureWidth = 1024U;
-
-            int w,h;
-            int roww = 0;
-            int rowh = 0;
-            w = 0;
-            h = 0;
-
+            // Copy glyph bitmap to our border bitmap and embolden it
             FT_Bitmap border_bitmap;
             FT_Bitmap_New(&border_bitmap);
-
-            FT_ULong charcode;
-            FT_UInt gindex;
-
-            // Find minimum size for a texture holding all visible ASCII characters
-            charcode = FT_Get_First_Char(face, &gindex);
-            while (gindex != 0)
+            int width = g->bitmap.width;
+            int height = g->bitmap.rows;
+            std::vector<unsigned char> field;
+            if (spread_ > 0)
             {
-                // Load glyph
-                if (FT_Load_Char(face, charcode, FT_LOAD_RENDER)) {
-                    fprintf(stderr, "Loading character %lu failed!\n", charcode);
-                    continue;
-                }
-                // Copy glyph bitmap to our border bitmap and embolden it
-                FT_Bitmap_Copy(ft, &g->bitmap, &border_bitmap);
+                BuildDistanceField(g->bitmap.buffer, width, height, spread_, field);
+                width += 2 * spread_;
+                height += 2 * spread_;
+            }
+            else if (border_ > 0)
+            {
+                FT_Bitmap_Copy(library_, &g->bitmap, &border_bitmap);
                 FT_Bitmap_Embolden(
-                    ft,
+                    library_,
                     &border_bitmap,
-                    FT_Pos(border * 32) * 2, //multiply by 32 because FreeType expects 26.6 values;
-                    FT_Pos(border * 32) * 2);
-                if (roww + border_bitmap.width + 1 >= kMaxTextureWidth) {
-                    w = std::max(w, roww);
-                    h += rowh;
-                    roww = 0;
-                    rowh = 0;
-                }
-                roww += border_bitmap.width + 1;
-                rowh = std::max(rowh, border_bitmap.rows);
-                // Goto next charcode
-                charcode = FT_Get_Next_Char(face, charcode, &gindex);
+                    FT_Pos(border_ * 32) * 2, //multiply by 32 because FreeType expects 26.6 values;
+                    FT_Pos(border_ * 32) * 2);//multiply by 32 because we want it bigger on both sides, not just one
+                width = border_bitmap.width;
+                height = border_bitmap.rows;
             }
-
-            w = std::max(w, roww);
-            h += rowh;
-
-            if (w == 0 || h == 0)
+            if (width + 1 > kPageSize || height + 1 > kPageSize)
             {
-                FT_Done_FreeType(ft);
-                return false;
+                FT_Bitmap_Done(library_, &border_bitmap);
+                return kGlyphMissing;
             }
 
-            // Create an image that will be used to hold all ASCII glyphs
-            Bitmap_Allocate(bitmap, w, h, 4);
-            Bitmap_FillWithZeroes(bitmap);
-
-            // Paste all glyph bitmaps into the image, remembering the offset
-            int ox = 0;
-            int oy = 0;
-
-            rowh = 0;
-
-            charcode = FT_Get_First_Char(face, &gindex);
-            while (gindex != 0)
+            // Find place in page, glyphs are put in rows
+            const int page_index = static_cast<int>(pages_.size()) - 1;
+            Page& page = pages_[page_index];
+            if (page.pen_x + width + 1 >= kPageSize)
             {
-                if (FT_Load_Char(face, charcode, FT_LOAD_RENDER)) {
-                    fprintf(stderr, "Loading character %lu failed!\n", charcode);
-                    continue;
-                }
-
-                // Copy glyph bitmap to our border bitmap and embolden it
-                FT_Bitmap_Copy(ft, &g->bitmap, &border_bitmap);
-                FT_Bitmap_Embolden(
-                    ft,
-                    &border_bitmap,
-                    FT_Pos(border * 32) * 2, //multiply by 32 because FreeType expects 26.6 values;
-                    FT_Pos(border * 32) * 2);//multiply by 32 because we want it bigger on both sides, not just one
-
-                if (ox + border_bitmap.width + 1 >= kMaxTextureWidth) {
-                    oy += rowh;
-                    rowh = 0;
-                    ox = 0;
-                }
-
-                int offset_x = (border_bitmap.width - g->bitmap.width) >> 1;
-                int offset_y = (border_bitmap.rows - g->bitmap.rows) >> 1;
+                page.pen_y += page.row_height;
+                page.row_height = 0;
+                page.pen_x = 0;
+            }
+            if (page.pen_y + height + 1 >= kPageSize)
+            {
+                FT_Bitmap_Done(library_, &border_bitmap);
+                return kPageFull;
+            }
+            const int ox = page.pen_x;
+            const int oy = page.pen_y;
 
-                Bitmap_SubDataColored(bitmap, ox, oy, 
+            int offset_x = 0;
+            int offset_y = 0;
+            if (spread_ > 0)
+            {
+                // Colors are applied by shader
+                offset_x = spread_;
+                offset_y = spread_;
+                Pixels_SubDataColored(&page.pixels[0], kPageSize, kPageSize, ox, oy,
+                    width, height, &field[0], Color(1.0f, 1.0f, 1.0f));
+            }
+            else if (border_ > 0)
+            {
+                offset_x = (border_bitmap.width - g->bitmap.width) >> 1;
+                offset_y = (border_bitmap.rows - g->bitmap.rows) >> 1;
+                Pixels_SubDataColored(&page.pixels[0], kPageSize, kPageSize, ox, oy,
                     border_bitmap.width, border_bitmap.rows, border_bitmap.buffer,
-                    border_color);
-                Bitmap_SubDataAlphaBlend(bitmap, ox + offset_x, oy + offset_y,
+                    border_color_);
+                Pixels_SubDataAlphaBlend(&page.pixels[0], kPageSize, kPageSize, ox + offset_x, oy + offset_y,
                     g->bitmap.width, g->bitmap.rows, g->bitmap.buffer,
-                    color);
-
-                unsigned int i = static_cast<unsigned int>(charcode);
-
-                FontCharInfo & info = info_map_[i];
-
-                info.advance_x = static_cast<float>(g->advance.x >> 6);
-                info.advance_y = static_cast<float>(g->advance.y >> 6);
-
-                info.bitmap_width = static_cast<float>(border_bitmap.width);
-                info.bitmap_height = static_cast<float>(border_bitmap.rows);
-
-                info.bitmap_left = static_cast<float>(g->bitmap_left - offset_x);
-                info.bitmap_top = static_cast<float>(g->bitmap_top - offset_y);
-
-                info.texcoord_x = ox / (float)w;
-                info.texcoord_y = oy / (float)h;
-
-                rowh = std::max(rowh, border_bitmap.rows);
-                ox += border_bitmap.width + 1;
-
-                // Goto next charcode
-                charcode = FT_Get_Next_Char(face, charcode, &gindex);
+                    color_);
+            }
+            else
+            {
+                Pixels_SubDataColored(&page.pixels[0], kPageSize, kPageSize, ox, oy,
+                    g->bitmap.width, g->bitmap.rows, g->bitmap.buffer, color_);
             }
+            FT_Bitmap_Done(library_, &border_bitmap);
 
-            FT_Bitmap_Done(ft, &border_bitmap);
+            info.advance_x = static_cast<float>(g->advance.x >> 6);
+            info.advance_y = static_cast<float>(g->advance.y >> 6);
 
-            FT_Done_Face(face);
+            info.bitmap_width = static_cast<float>(width);
+            info.bitmap_height = static_cast<float>(height);
 
-            FT_Done_FreeType(ft);
+            info.bitmap_left = static_cast<float>(g->bitmap_left - offset_x);
+            if (spread_ > 0) // field is padded by spread above the glyph too
+                info.bitmap_top = static_cast<float>(g->bitmap_top + spread_);
+            else
+                info.bitmap_top = static_cast<float>(g->bitmap_top - offset_y);
 
-            // Rescale texture to power of two
-            Bitmap_MakePotTextureFromNpot(bitmap, &scale_x_, &scale_y_);
+            info.texcoord_x = ox / (float)kPageSize;
+            info.texcoord_y = oy / (float)kPageSize;
+            info.page = page_index;
 
-            return true;
+            page.row_height = std::max(page.row_height, height + 1);
+            page.pen_x += width + 1;
+            page.dirty_top = std::min(page.dirty_top, oy);
+            page.dirty_bottom = std::max(page.dirty_bottom, oy + height);
+            return kGlyphPlaced;
+        }
+        void Font::AddPage() const
+        {
+            if (!pages_.empty())
+                pages_.back().full = true;
+            Page page;
+            page.texture = NULL;
+            page.pen_x = 0;
+            page.pen_y = 0;
+            page.row_height = 0;
+            page.dirty_top = kPageSize;
+            page.dirty_bottom = 0;
+            page.full = false;
+            pages_.push_back(page);
+            pages_.back().pixels.resize(kPageSize * kPageSize * 4, 0);
         }
 
     } // namespace terrain
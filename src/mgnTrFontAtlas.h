@@ -5,9 +5,16 @@
 #include "MapDrawing/Graphics/Renderer.h"
 
 #include "Color.h"
-#include "mgnMdBitmap.h"
 
+#include <boost/cstdint.hpp>
+#include <boost/thread/mutex.hpp>
 #include <boost/unordered_map.hpp>
+#include <boost/unordered_set.hpp>
+
+#include <vector>
+
+struct FT_LibraryRec_;
+struct FT_FaceRec_;
 
 namespace mgn {
     namespace terrain {
@@ -22,6 +29,7 @@ namespace mgn {
             float bitmap_top;
             float texcoord_x;
             float texcoord_y;
+            int page;           //!< atlas page holding glyph bitmap
         };
 
         struct FontGlyphPoint {
@@ -31,7 +39,13 @@ namespace mgn {
             float texcoord_y;
         };
 
-        //! Font class
+        /*! Font class.
+        ** Glyphs are rasterized on first use into atlas pages of fixed size, new page is started
+        ** when the current one is full. Basic Latin set is rasterized on creation.
+        ** Glyphs may be requested from any thread, page textures are updated from render thread.
+        ** Distance field font stores signed distance to glyph edge instead of coverage, so colors
+        ** and outline are applied by billboard shader and atlas stays sharp for any label size.
+        */
         class Font {
         public:
 
@@ -39,40 +53,83 @@ namespace mgn {
                 const char* filename, int font_height, const Color& color, float pixel_size);
             static Font * CreateWithBorder(graphics::Renderer * renderer,
                 const char* filename, int font_height, int border, const Color& color, const Color& border_color, float pixel_size);
+            static Font * CreateDistanceField(graphics::Renderer * renderer,
+                const char* filename, int font_height, int border, const Color& color, const Color& border_color, float pixel_size);
             ~Font();
 
+            //! Returns glyph of character, it's rasterized if needed; NULL if font doesn't present character
             const FontCharInfo* info(unsigned int charcode) const;
+            //! Collects glyphs of text placed in the same page and returns the page
+            // Characters which font doesn't present are skipped.
+            int GetGlyphs(const wchar_t* text, std::vector<const FontCharInfo*>& glyphs) const;
+            //! Rasterizes characters in advance
+            void Preload(unsigned int first_charcode, unsigned int last_charcode) const;
+
             const float atlas_width() const;
             const float atlas_height() const;
-            graphics::Texture * texture() const;
+            //! Texture of atlas page, glyphs rasterized since the last call are uploaded (render thread only)
+            graphics::Texture * texture(int page = 0) const;
             const float scale() const;
             const float scale_x() const;
             const float scale_y() const;
+            bool distance_field() const;
+
+            //! Sets billboard shader parameters for labels of this font
+            void SetupShader(graphics::Shader * shader) const;
+            //! Restores billboard shader parameters for bitmap textures
+            static void ResetShader(graphics::Shader * shader);
 
         protected:
             explicit Font(graphics::Renderer * renderer, float pixel_size);
 
-            void Make(const char* filename, int font_height, const Color& color);
-            void MakeWithBorder(const char* filename, int font_height, int border, const Color& color, const Color& border_color);
-            bool MakeAtlas(const char* filename, int font_height, const Color& color, mgnMdBitmap * bitmap);
-            bool MakeAtlasWithBorder(const char* filename, int font_height, int border, 
-                const Color& color, const Color& border_color, mgnMdBitmap * bitmap);
+            bool Make(const char* filename, int font_height, const Color& color);
+            bool MakeWithBorder(const char* filename, int font_height, int border, const Color& color, const Color& border_color);
+            bool MakeDistanceField(const char* filename, int font_height, int border, const Color& color, const Color& border_color);
+            bool LoadFace(const char* filename, int font_height);
 
             // Don't allow to copy and assign
             Font(const Font&);
             void operator = (const Font&);
 
         private:
+            struct Page {
+                graphics::Texture * texture;
+                std::vector<unsigned char> pixels; //!< released when page is full and uploaded
+                int pen_x;          //!< free space of the current row starts here
+                int pen_y;
+                int row_height;
+                int dirty_top;      //!< rows modified since upload
+                int dirty_bottom;
+                bool full;
+            };
+            typedef boost::unordered_map<boost::uint64_t, FontCharInfo> InfoMap; //!< by page and charcode
+
+            enum GlyphResult { kGlyphPlaced, kGlyphMissing, kPageFull };
+
+            //! Collects glyphs of text if page holds all of them, mutex should be locked
+            bool FindGlyphs(int page, const wchar_t* text, std::vector<const FontCharInfo*>& glyphs) const;
+            //! Finds glyph in the current page or rasterizes it there, mutex should be locked
+            GlyphResult FindGlyph(unsigned int charcode, const FontCharInfo*& glyph) const;
+            GlyphResult RasterizeGlyph(unsigned int charcode, FontCharInfo& info) const;
+            void AddPage() const;
+
             graphics::Renderer * renderer_;
-            graphics::Texture * texture_;
-            typedef boost::unordered_map<unsigned int, FontCharInfo> InfoMap;
-            InfoMap info_map_;
             float scale_; //!< for atlas
-            float scale_x_;
-            float scale_y_;
+
+            FT_LibraryRec_ * library_;
+            FT_FaceRec_ * face_;
+            int border_;
+            int spread_;        //!< range of distance field in pixels, zero for bitmap font
+            Color color_;
+            Color border_color_;
+
+            mutable boost::mutex mutex_;
+            mutable std::vector<Page> pages_;
+            mutable InfoMap info_map_;  //!< elements are never changed once inserted
+            mutable boost::unordered_set<unsigned int> missing_chars_;
         };
 
     } // namespace terrain
 } // namespace mgn
 
-#endif
\ No newline at end of file
+#endif
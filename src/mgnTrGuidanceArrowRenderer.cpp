@@ -1,6 +1,7 @@
 #include "mgnTrGuidanceArrowRenderer.h"
 
 #include "mgnTrConstants.h"
+#include "mgnTrElevationPyramid.h"
 #include "mgnTrMercatorProvider.h"
 
 #include "mgnMdTerrainView.h"
@@ -86,7 +87,7 @@ namespace mgn {
 
                 latitude_ = arrow.point.mLatitude;
                 longitude_ = arrow.point.mLongitude;
-                double altitude = provider->GetAltitude(latitude_, longitude_);
+                double altitude = GetAltitude(terrain_view_->getElevationPyramid(), provider, latitude_, longitude_);
                 terrain_view_->WorldToPixel(latitude_, longitude_, altitude, position_, kMSM);
                 terrain_view_->LocalToPixelDistance(scale, scale_, kMSM);
                 heading_ = arrow.heading;
@@ -322,15 +323,16 @@ namespace mgn {
             // Code taken from DottedLineRenderer
             
             // Fast, but inaccurate computation
+            const ElevationPyramid * pyramid = terrain_view_->getElevationPyramid();
             double d = static_cast<double>(cell_size_local);
             double dlon = d / terrain_view_->getMetersPerLongitude();
             double dlat = d / terrain_view_->getMetersPerLatitude();
             float sx =      
-                (float)provider->GetAltitude(latitude_, longitude_ + dlon, NULL, dxm) - // x+1
-                (float)provider->GetAltitude(latitude_, longitude_ - dlon, NULL, dxm);  // x-1
+                (float)GetAltitude(pyramid, provider, latitude_, longitude_ + dlon, dxm) - // x+1
+                (float)GetAltitude(pyramid, provider, latitude_, longitude_ - dlon, dxm);  // x-1
             float sy =      
-                (float)provider->GetAltitude(latitude_ + dlat, longitude_, NULL, dxm) - // y+1
-                (float)provider->GetAltitude(latitude_ - dlat, longitude_, NULL, dxm);  // y-1
+                (float)GetAltitude(pyramid, provider, latitude_ + dlat, longitude_, dxm) - // y+1
+                (float)GetAltitude(pyramid, provider, latitude_ - dlat, longitude_, dxm);  // y-1
             // assume that tile cell sizes in both directions are the same
             // also swap x and z to convert LHS normal to RHS
             vec3 normal;
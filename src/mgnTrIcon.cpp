@@ -13,13 +13,13 @@ namespace mgn {
     namespace terrain {
 
         Icon::Icon(mgn::graphics::Renderer * renderer, mgnMdTerrainView * terrain_view,
-                graphics::Shader * shader, const IconData& data, int lod)
+                graphics::Shader * shader, const IconData& data, int lod, const TextureRegion& region)
         : Billboard(renderer, terrain_view, shader, 0.001f)
         , mID(data.id)
         , mMapObjectInfo(data.poi_info)
         , mIsPOI(data.is_poi)
         {
-            Create(data, lod);
+            Create(data, lod, region);
             MakeRenderable();
         }
         Icon::~Icon()
@@ -105,7 +105,7 @@ namespace mgn {
 
             renderer_->PopMatrix();
         }
-        void Icon::Create(const IconData& data, int /*lod*/)
+        void Icon::Create(const IconData& data, int /*lod*/, const TextureRegion& region)
         {
             const float kMSM = static_cast<float>(mgn::terrain::GetMapSizeMax());
 
@@ -178,6 +178,12 @@ namespace mgn {
                 vertices[ind++] = 0.0f;
             }
 
+            if (region.texture)
+            {
+                for (unsigned int i = 0; i < num_vertices_; ++i)
+                    region.Map(vertices[i * 5 + 3], vertices[i * 5 + 4]);
+            }
+
             indices[0] = 0;
             indices[1] = 1;
             indices[2] = 2;
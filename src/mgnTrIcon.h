@@ -15,8 +15,10 @@ namespace mgn {
         //! class for rendering icons
         class Icon : public Billboard {
         public:
+            //! Texture coordinates are mapped into region if icon texture is taken from atlas
             explicit Icon(mgn::graphics::Renderer * renderer, mgnMdTerrainView * terrain_view,
-                graphics::Shader * shader, const IconData& data, int lod);
+                graphics::Shader * shader, const IconData& data, int lod,
+                const TextureRegion& region = TextureRegion());
             virtual ~Icon();
 
             void render();
@@ -27,7 +29,7 @@ namespace mgn {
             bool isPOI() const;
 
         private:
-            void Create(const IconData& data, int lod);
+            void Create(const IconData& data, int lod, const TextureRegion& region);
 
             int mID; //!< icon ID for selection
             mgnMdMapObjectInfo mMapObjectInfo; //!< map object info for POI
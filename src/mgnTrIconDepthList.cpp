@@ -0,0 +1,106 @@
+#include "mgnTrIconDepthList.h"
+
+#include "MapDrawing/Graphics/mgnCommonMath.h"
+
+#include <algorithm>
+
+namespace mgn {
+    namespace terrain {
+
+        IconDepthList::IconDepthList()
+        : num_sorted_(0)
+        {
+        }
+        bool IconDepthList::empty() const
+        {
+            return entries_.empty();
+        }
+        size_t IconDepthList::size() const
+        {
+            return entries_.size();
+        }
+        Icon * IconDepthList::operator[](size_t index) const
+        {
+            return entries_[index].icon;
+        }
+        void IconDepthList::Clear()
+        {
+            entries_.clear();
+            num_sorted_ = 0;
+        }
+        void IconDepthList::Add(Owner owner, const std::vector<Icon*>& icons)
+        {
+            for (std::vector<Icon*>::const_iterator it = icons.begin(); it != icons.end(); ++it)
+            {
+                Entry entry;
+                entry.icon = *it;
+                entry.owner = owner;
+                entry.distance_sqr = 0.0f;
+                entries_.push_back(entry);
+            }
+        }
+        void IconDepthList::Remove(std::vector<Owner>& owners)
+        {
+            if (owners.empty())
+                return;
+            std::sort(owners.begin(), owners.end());
+            size_t num_entries = 0;
+            size_t num_sorted = num_sorted_;
+            for (size_t i = 0; i < entries_.size(); ++i)
+            {
+                if (std::binary_search(owners.begin(), owners.end(), entries_[i].owner))
+                {
+                    if (i < num_sorted_)
+                        --num_sorted;
+                    continue;
+                }
+                entries_[num_entries++] = entries_[i];
+            }
+            entries_.resize(num_entries);
+            num_sorted_ = num_sorted;
+        }
+        void IconDepthList::Remove(Owner owner)
+        {
+            std::vector<Owner> owners(1, owner);
+            Remove(owners);
+        }
+        void IconDepthList::Sort(const vec3& camera_position)
+        {
+            for (std::vector<Entry>::iterator it = entries_.begin(); it != entries_.end(); ++it)
+                it->distance_sqr = math::DistanceSqr(it->icon->position(), camera_position);
+
+            // Previous order is mostly valid after camera move, so insertion sort does few moves.
+            // Large jumps fall back to full sort once moves exceed linear bound.
+            const size_t kMaxMovesPerEntry = 8;
+            const size_t max_moves = kMaxMovesPerEntry * num_sorted_;
+            size_t num_moves = 0;
+            for (size_t i = 1; i < num_sorted_; ++i)
+            {
+                Entry entry = entries_[i];
+                size_t j = i;
+                for (; j > 0 && IsFarther(entry, entries_[j - 1]); --j)
+                    entries_[j] = entries_[j - 1];
+                entries_[j] = entry;
+                num_moves += i - j;
+                if (num_moves > max_moves)
+                {
+                    std::sort(entries_.begin(), entries_.begin() + num_sorted_, IsFarther);
+                    break;
+                }
+            }
+
+            // Added icons are sorted separately and merged in
+            if (num_sorted_ < entries_.size())
+            {
+                std::sort(entries_.begin() + num_sorted_, entries_.end(), IsFarther);
+                std::inplace_merge(entries_.begin(), entries_.begin() + num_sorted_, entries_.end(), IsFarther);
+                num_sorted_ = entries_.size();
+            }
+        }
+        bool IconDepthList::IsFarther(const Entry& first, const Entry& second)
+        {
+            return first.distance_sqr > second.distance_sqr; // distant ones should be first
+        }
+
+    } // namespace terrain
+} // namespace mgn
@@ -0,0 +1,54 @@
+#pragma once
+#ifndef __MGN_TERRAIN_ICON_DEPTH_LIST_H__
+#define __MGN_TERRAIN_ICON_DEPTH_LIST_H__
+
+#include "mgnTrIcon.h"
+
+#include <cstddef>
+#include <vector>
+
+namespace mgn {
+    namespace terrain {
+
+        /*! Icon depth list class.
+        ** Icons of tiles ordered from distant to near ones for back to front rendering.
+        ** Order is kept between updates: icons of a tile are added or removed without rebuilding the list,
+        ** and after camera move the nearly sorted list is repaired by insertion sort in linear time.
+        */
+        class IconDepthList {
+        public:
+            typedef const void * Owner; //!< tile owning icons
+
+            IconDepthList();
+
+            bool empty() const;
+            size_t size() const;
+            Icon * operator[](size_t index) const;
+
+            void Clear();
+
+            //! Appends icons of tile, they take their place on next sort
+            void Add(Owner owner, const std::vector<Icon*>& icons);
+            //! Removes icons of all given tiles in one pass, order of the rest is kept
+            void Remove(std::vector<Owner>& owners);
+            void Remove(Owner owner);
+
+            //! Orders icons by distance to camera
+            void Sort(const vec3& camera_position);
+
+        private:
+            struct Entry {
+                Icon * icon;
+                Owner owner;
+                float distance_sqr;
+            };
+            static bool IsFarther(const Entry& first, const Entry& second);
+
+            std::vector<Entry> entries_;
+            size_t num_sorted_; //!< entries before this one have been sorted, the rest are added since
+        };
+
+    } // namespace terrain
+} // namespace mgn
+
+#endif
@@ -0,0 +1,117 @@
+#include "mgnTrIconSelectionIndex.h"
+
+#include <algorithm>
+#include <functional>
+#include <assert.h>
+
+namespace mgn {
+    namespace terrain {
+
+        void IconSelectionIndex::Clear()
+        {
+            entries_.clear();
+            grid_.Clear();
+        }
+        void IconSelectionIndex::Insert(Icon * icon, const math::Matrix4& proj, const math::Matrix4& view,
+            const math::Vector4& viewport)
+        {
+            if (icon->getID() == 0 && !icon->isPOI())
+                return;
+
+            vec4 icon_pos_world(icon->position(), 1.0f);
+            vec4 icon_pos_eye = view * icon_pos_world;
+
+            vec2 icon_size;
+            icon->GetIconSize(icon_size);
+
+            vec4 vertices_eye[4];
+            switch (icon->getOrigin())
+            {
+            case Billboard::kBottomLeft:
+                vertices_eye[0] = icon_pos_eye;
+                break;
+            case Billboard::kBottomMiddle:
+                vertices_eye[0] = icon_pos_eye;
+                vertices_eye[0].x += -0.5f * icon_size.x;
+                break;
+            default:
+                assert(false);
+                break;
+            }
+            vertices_eye[1] = vertices_eye[0];
+            vertices_eye[1].x += icon_size.x;
+            vertices_eye[2] = vertices_eye[0];
+            vertices_eye[2].x += icon_size.x;
+            vertices_eye[2].y -= icon_size.y; // sign "-" because of view matrix scale(1,-1,1)
+            vertices_eye[3] = vertices_eye[0];
+            vertices_eye[3].y -= icon_size.y;
+
+            Entry entry;
+            entry.icon = icon;
+            math::Rect rect;
+            for (int i = 0; i < 4; ++i)
+            {
+                vec4 pos_clip = proj * vertices_eye[i];
+                if (pos_clip.w <= 0.0f)
+                    return; // behind the camera
+                vec3 pos_ndc = pos_clip.xyz() / pos_clip.w;
+
+                entry.vertices[i].x = (pos_ndc.x + 1.0f) * 0.5f * viewport.z + viewport.x;
+                entry.vertices[i].y = (pos_ndc.y + 1.0f) * 0.5f * viewport.w + viewport.y;
+                rect.vertices[i].x = entry.vertices[i].x;
+                rect.vertices[i].y = entry.vertices[i].y;
+            }
+            grid_.Insert(rect, static_cast<int>(entries_.size()));
+            entries_.push_back(entry);
+        }
+        void IconSelectionIndex::SelectIcons(int x, int y, int radius, std::vector<int>& ids)
+        {
+            Select(x, y, radius);
+            for (std::vector<int>::const_iterator it = selected_.begin(); it != selected_.end(); ++it)
+            {
+                const Icon * icon = entries_[*it].icon;
+                if (icon->getID() != 0)
+                    ids.push_back(icon->getID());
+            }
+        }
+        void IconSelectionIndex::SelectPOIs(int x, int y, int radius, TMapObjectsVector& objects)
+        {
+            Select(x, y, radius);
+            for (std::vector<int>::const_iterator it = selected_.begin(); it != selected_.end(); ++it)
+            {
+                const Icon * icon = entries_[*it].icon;
+                if (icon->isPOI())
+                    objects.push_back(new mgnMdMapObjectInfo(icon->getMapObjectInfo()));
+            }
+        }
+        void IconSelectionIndex::Select(int x, int y, int radius)
+        {
+            selected_.clear();
+            if (entries_.empty())
+                return;
+
+            vec2 selection_pos((float)x, (float)y);
+            float selection_radius = (float)radius;
+
+            math::Rect bounds;
+            bounds.vertices[0].x = selection_pos.x - selection_radius;
+            bounds.vertices[0].y = selection_pos.y - selection_radius;
+            bounds.vertices[1].x = selection_pos.x + selection_radius;
+            bounds.vertices[1].y = selection_pos.y - selection_radius;
+            bounds.vertices[2].x = selection_pos.x + selection_radius;
+            bounds.vertices[2].y = selection_pos.y + selection_radius;
+            bounds.vertices[3].x = selection_pos.x - selection_radius;
+            bounds.vertices[3].y = selection_pos.y + selection_radius;
+
+            grid_.Query(bounds, candidates_);
+            for (std::vector<int>::const_iterator it = candidates_.begin(); it != candidates_.end(); ++it)
+            {
+                if (math::CircleRectIntersection2D(selection_pos, selection_radius, entries_[*it].vertices))
+                    selected_.push_back(*it);
+            }
+            // Icons are added from farest to nearest, but we need to select nearest ones first
+            std::sort(selected_.begin(), selected_.end(), std::greater<int>());
+        }
+
+    } // namespace terrain
+} // namespace mgn
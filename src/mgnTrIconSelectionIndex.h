@@ -0,0 +1,49 @@
+#pragma once
+#ifndef __MGN_TERRAIN_ICON_SELECTION_INDEX_H__
+#define __MGN_TERRAIN_ICON_SELECTION_INDEX_H__
+
+#include "mgnTrIcon.h"
+#include "mgnTrScreenGrid.h"
+#include "mgnMdMapObjectsVector.h"
+
+#include <vector>
+
+namespace mgn {
+    namespace terrain {
+
+        /*! Icon selection index class.
+        ** Window space quads of selectable icons rendered in the last frame.
+        ** It's rebuilt once per frame, so selection query projects nothing and tests only icons
+        ** in grid cells around the selection circle.
+        */
+        class IconSelectionIndex {
+        public:
+            void Clear();
+
+            //! Projects icon quad to window coordinates, icons should be added from distant to near ones
+            void Insert(Icon * icon, const math::Matrix4& proj, const math::Matrix4& view,
+                const math::Vector4& viewport);
+
+            //! Collects ids of icons intersecting selection circle, nearest ones first
+            void SelectIcons(int x, int y, int radius, std::vector<int>& ids);
+            //! Collects map objects of POIs intersecting selection circle, nearest ones first
+            void SelectPOIs(int x, int y, int radius, TMapObjectsVector& objects);
+
+        private:
+            struct Entry {
+                Icon * icon;
+                vec2 vertices[4]; //!< quad in window coordinates
+            };
+            //! Fills indices of entries intersecting circle, nearest ones first
+            void Select(int x, int y, int radius);
+
+            std::vector<Entry> entries_;
+            ScreenGrid grid_;
+            std::vector<int> candidates_;   //!< entries intersecting bounds of selection circle
+            std::vector<int> selected_;
+        };
+
+    } // namespace terrain
+} // namespace mgn
+
+#endif
@@ -9,21 +9,24 @@ namespace mgn {
     namespace terrain {
 
         struct LabelData;
+        struct LabelGeometry;
 
         //! class for rendering labels
         class Label : public Billboard {
         public:
+            //! Geometry is built beforehand, so only buffers are created here
+            // Texture coordinates are mapped into region if shield texture is taken from atlas.
             explicit Label(mgn::graphics::Renderer * renderer, mgnMdTerrainView * terrain_view,
-                graphics::Shader * shader, const LabelData &data, int lod);
+                graphics::Shader * shader, const LabelData &data, const LabelGeometry &geometry,
+                const TextureRegion& region = TextureRegion());
             virtual ~Label();
 
             const std::wstring& text() const;
+            unsigned int text_id() const;
 
         protected:
             std::wstring mText; //!< text of label
-
-        private:
-            void Create(const LabelData &data, int lod);
+            unsigned int mTextId; //!< interned text, to detect duplicated labels
         };
 
     } // namespace terrain
@@ -0,0 +1,207 @@
+#include "mgnTrLabelGeometry.h"
+
+#include "mgnTrConstants.h"
+#include "mgnTrFontAtlas.h"
+#include "mgnTrLabelTextTable.h"
+#include "mgnTrMercatorDataInfo.h"
+
+#include "mgnMdTerrainView.h"
+
+#include <algorithm>
+#include <set>
+
+namespace {
+
+    void AddVertex(std::vector<float>& vertices, float x, float y, float s, float t)
+    {
+        // position
+        vertices.push_back(x);
+        vertices.push_back(y);
+        vertices.push_back(0.0f);
+        // texture coordinates (0..1)
+        vertices.push_back(s);
+        vertices.push_back(t);
+    }
+
+} // namespace
+
+namespace mgn {
+    namespace terrain {
+
+        void BuildLabelGeometry(const mgnMdTerrainView * terrain_view, const LabelData& data, int lod,
+            LabelGeometry& geometry)
+        {
+            const float kMSM = static_cast<float>(GetMapSizeMax());
+            const float kCellSize = static_cast<float>(1 << (GetMaxLod() - lod));
+
+            int lod_delta = terrain_view->GetLod() - lod;
+            if (lod_delta < 0) lod_delta = 0;
+            float scale_tex = (float)terrain_view->getPixelScale()/1.5f * (float)(1 << (lod_delta+1));
+
+            // Label size (in meters)
+            float w = kCellSize * data.width / scale_tex;
+            float h = kCellSize * data.height / scale_tex;
+
+            geometry.origin = (data.centered) ? Billboard::kBottomMiddle : Billboard::kBottomLeft;
+            geometry.width = w;
+            geometry.height = h;
+            geometry.texture_page = 0; // own bitmap texture
+
+            // Coordinates of the middle-bottom point of label
+            terrain_view->WorldToPixel(data.latitude, data.longitude, data.altitude,
+                geometry.position, kMSM);
+
+            const float left = data.centered ? (-w/2.0f) : 0.0f;
+            const float right = data.centered ? (w/2.0f) : w;
+            const float lower = data.centered ? (-h/2.0f) : 0.0f;
+            const float upper = data.centered ? (h/2.0f) : h;
+
+            geometry.vertices.clear();
+            geometry.vertices.reserve(4 * 5);
+            AddVertex(geometry.vertices, left, lower, 0.0f, 1.0f);  // bottom-left
+            AddVertex(geometry.vertices, right, lower, 1.0f, 1.0f); // bottom-right
+            AddVertex(geometry.vertices, left, upper, 0.0f, 0.0f);  // upper-left
+            AddVertex(geometry.vertices, right, upper, 1.0f, 0.0f); // upper-right
+
+            geometry.indices.clear();
+            for (unsigned short index = 0; index < 4; ++index)
+                geometry.indices.push_back(index);
+        }
+        void BuildAtlasLabelGeometry(const mgnMdTerrainView * terrain_view, const Font * font,
+            const LabelData& data, int lod, LabelGeometry& geometry)
+        {
+            const float kMSM = static_cast<float>(GetMapSizeMax());
+            const float kCellSize = static_cast<float>(1 << (GetMaxLod() - lod)); // MSM / 2^lod / TileRes
+
+            float scale_tex = (float)terrain_view->getPixelScale()/1.5f * 2.0f;
+
+            // Coefficients to convert from bitmap to tile coordinates (meters)
+            const float kB2WX = kCellSize / scale_tex * font->scale();
+            const float kB2WY = kCellSize / scale_tex * font->scale();
+
+            // Coordinates of the middle-bottom point of label
+            terrain_view->WorldToPixel(data.latitude, data.longitude, data.altitude,
+                geometry.position, kMSM);
+
+            // Compute vertex size of label
+            float offset_x = 0.0f;
+            float offset_y = 0.0f;
+            float min_x = kMSM;
+            float min_y = kMSM;
+            float max_x = -kMSM;
+            float max_y = -kMSM;
+            // Characters which font doesn't present are skipped
+            std::vector<const FontCharInfo*> glyphs;
+            geometry.texture_page = font->GetGlyphs(data.text.c_str(), glyphs);
+            const size_t num_glyphs = glyphs.size();
+            for (size_t i = 0; i < num_glyphs; ++i)
+            {
+                const FontCharInfo* info = glyphs[i];
+
+                float glyph_x = offset_x + info->bitmap_left;
+                float glyph_y = offset_y + info->bitmap_top - info->bitmap_height;
+
+                min_x = std::min(min_x, glyph_x);
+                min_y = std::min(min_y, glyph_y);
+                max_x = std::max(max_x, glyph_x + info->bitmap_width);
+                max_y = std::max(max_y, glyph_y + info->bitmap_height);
+
+                offset_x += info->advance_x;
+                offset_y += info->advance_y;
+            }
+            float size_x = max_x - min_x;
+            float size_y = max_y - min_y;
+
+            geometry.origin = (data.centered) ? Billboard::kBottomMiddle : Billboard::kBottomLeft;
+            geometry.width = size_x * kB2WX;
+            geometry.height = size_y * kB2WY;
+
+            if (data.centered)
+            {
+                offset_x = -0.5f * size_x;
+                offset_y = -0.5f * size_y;
+            }
+            else
+            {
+                offset_x = 0.0f;
+                offset_y = 0.0f;
+            }
+
+            geometry.vertices.clear();
+            geometry.vertices.reserve(num_glyphs * 4 * 5);
+            geometry.indices.clear();
+            geometry.indices.reserve(num_glyphs * 6);
+
+            unsigned short index = 0;
+            for (size_t i = 0; i < num_glyphs; ++i)
+            {
+                const FontCharInfo* info = glyphs[i];
+
+                float glyph_x = offset_x + info->bitmap_left;
+                float glyph_y = offset_y + info->bitmap_top - info->bitmap_height;
+
+                float left = (glyph_x) * kB2WX;
+                float right = (glyph_x + info->bitmap_width) * kB2WX;
+                float lower = (glyph_y) * kB2WY;
+                float upper = (glyph_y + info->bitmap_height) * kB2WY;
+
+                offset_x += info->advance_x;
+                offset_y += info->advance_y;
+
+                float texcoord_right = info->texcoord_x + (info->bitmap_width / font->atlas_width() * font->scale_x());
+                float texcoord_top = info->texcoord_y + (info->bitmap_height / font->atlas_height() * font->scale_y());
+
+                AddVertex(geometry.vertices, left, lower, info->texcoord_x, texcoord_top);  // bottom-left
+                AddVertex(geometry.vertices, right, lower, texcoord_right, texcoord_top);   // bottom-right
+                AddVertex(geometry.vertices, left, upper, info->texcoord_x, info->texcoord_y); // upper-left
+                AddVertex(geometry.vertices, right, upper, texcoord_right, info->texcoord_y);  // upper-right
+
+                if (index != 0) // not the first glyph
+                {
+                    // Add two degenerates
+                    geometry.indices.push_back(index - 1);
+                    geometry.indices.push_back(index);
+                }
+                for (int corner = 0; corner < 4; ++corner)
+                    geometry.indices.push_back(index++);
+            }
+        }
+        void PrepareLabels(const mgnMdTerrainView * terrain_view, const Font * font, int lod,
+            std::vector<LabelData>& labels_data, std::vector<LabelGeometry>& geometries)
+        {
+            geometries.resize(labels_data.size());
+            std::set<unsigned int> shield_hashes;
+            LabelTextTable * text_table = LabelTextTable::GetInstance();
+            for (size_t i = 0; i < labels_data.size(); ++i)
+            {
+                LabelData& data = labels_data[i];
+                geometries[i].text_id = text_table->Intern(data.text);
+                if (!data.centered) // atlas-based label
+                {
+                    BuildAtlasLabelGeometry(terrain_view, font, data, lod, geometries[i]);
+                    continue;
+                }
+
+                BuildLabelGeometry(terrain_view, data, lod, geometries[i]);
+                if (!shield_hashes.insert(data.shield_hash).second)
+                {
+                    std::vector<unsigned char>().swap(data.bitmap_data);
+                    data.bitmap_width = 0;
+                    data.bitmap_height = 0;
+                    continue;
+                }
+                // Atlas pages aren't mipmapped, so bitmap keeps its size
+                data.bitmap_width = data.width;
+                data.bitmap_height = data.height;
+            }
+        }
+        void ReleaseLabels(std::vector<LabelGeometry>& geometries)
+        {
+            LabelTextTable * text_table = LabelTextTable::GetInstance();
+            for (size_t i = 0; i < geometries.size(); ++i)
+                text_table->Release(geometries[i].text_id);
+            geometries.clear();
+        }
+
+    } // namespace terrain
+} // namespace mgn
@@ -0,0 +1,51 @@
+#pragma once
+#ifndef __MGN_TERRAIN_LABEL_GEOMETRY_H__
+#define __MGN_TERRAIN_LABEL_GEOMETRY_H__
+
+#include "mgnTrBillboard.h"
+
+#include <vector>
+
+class mgnMdTerrainView;
+
+namespace mgn {
+    namespace terrain {
+
+        class Font;
+        struct LabelData;
+
+        /*! Label geometry structure.
+        ** CPU side of label billboard: placement and vertex/index data ready for upload.
+        ** It's built by labels tasks on worker thread, so render thread only creates buffers.
+        */
+        struct LabelGeometry {
+            vec3 position;                  //!< 3D position in tile coord system
+            Billboard::OriginType origin;
+            float width;
+            float height;
+            unsigned int text_id;           //!< interned text referenced by geometry, see LabelTextTable
+            int texture_page;               //!< font atlas page of atlas label
+            std::vector<float> vertices;    //!< position (3) and texture coordinates (2) per vertex
+            std::vector<unsigned short> indices; //!< triangle strip
+        };
+
+        //! Builds geometry of shield label textured by its own bitmap
+        void BuildLabelGeometry(const mgnMdTerrainView * terrain_view, const LabelData& data, int lod,
+            LabelGeometry& geometry);
+
+        //! Builds geometry of label textured by font atlas
+        void BuildAtlasLabelGeometry(const mgnMdTerrainView * terrain_view, const Font * font,
+            const LabelData& data, int lod, LabelGeometry& geometry);
+
+        //! Builds geometry for every label and interns its text, the reference is held by geometry
+        // Bitmap of shield repeated in labels is dropped, its texture is created from the first one.
+        void PrepareLabels(const mgnMdTerrainView * terrain_view, const Font * font, int lod,
+            std::vector<LabelData>& labels_data, std::vector<LabelGeometry>& geometries);
+
+        //! Releases interned texts of geometries, labels keep their own references
+        void ReleaseLabels(std::vector<LabelGeometry>& geometries);
+
+    } // namespace terrain
+} // namespace mgn
+
+#endif
@@ -0,0 +1,89 @@
+#include "mgnTrLabelTextTable.h"
+
+#include <boost/thread/locks.hpp>
+
+#include <cassert>
+
+namespace mgn {
+    namespace terrain {
+
+        namespace {
+            // Constructed during static initialization, before any worker thread is started
+            LabelTextTable * const g_label_text_table = LabelTextTable::GetInstance();
+        }
+
+        LabelTextTable * LabelTextTable::GetInstance()
+        {
+            static LabelTextTable instance;
+            return &instance;
+        }
+        LabelTextTable::LabelTextTable()
+        {
+        }
+        unsigned int LabelTextTable::Intern(const std::wstring& text)
+        {
+            boost::lock_guard<boost::mutex> guard(mutex_);
+            IdMap::iterator it = ids_.find(text);
+            if (it != ids_.end())
+            {
+                ++entries_[it->second].ref_count;
+                return it->second;
+            }
+            unsigned int id;
+            if (!free_ids_.empty())
+            {
+                id = free_ids_.back();
+                free_ids_.pop_back();
+            }
+            else
+            {
+                id = static_cast<unsigned int>(entries_.size());
+                entries_.push_back(Entry());
+            }
+            it = ids_.insert(std::make_pair(text, id)).first;
+            // References to keys stay valid on rehashing
+            entries_[id].text = &it->first;
+            entries_[id].ref_count = 1;
+            return id;
+        }
+        void LabelTextTable::AddRef(unsigned int id)
+        {
+            boost::lock_guard<boost::mutex> guard(mutex_);
+            assert(id < entries_.size() && entries_[id].ref_count != 0);
+            ++entries_[id].ref_count;
+        }
+        void LabelTextTable::Release(unsigned int id)
+        {
+            boost::lock_guard<boost::mutex> guard(mutex_);
+            assert(id < entries_.size() && entries_[id].ref_count != 0);
+            Entry& entry = entries_[id];
+            if (--entry.ref_count != 0)
+                return;
+            ids_.erase(ids_.find(*entry.text));
+            entry.text = NULL;
+            free_ids_.push_back(id);
+        }
+
+        bool LabelIdSet::Insert(unsigned int id)
+        {
+            if (id >= flags_.size())
+                flags_.resize(id + 1, 0);
+            if (flags_[id] != 0)
+                return false;
+            flags_[id] = 1;
+            inserted_ids_.push_back(id);
+            return true;
+        }
+        bool LabelIdSet::Contains(unsigned int id) const
+        {
+            return id < flags_.size() && flags_[id] != 0;
+        }
+        void LabelIdSet::Clear()
+        {
+            for (std::vector<unsigned int>::const_iterator it = inserted_ids_.begin(); it != inserted_ids_.end(); ++it)
+                flags_[*it] = 0;
+            inserted_ids_.clear();
+        }
+
+    } // namespace terrain
+} // namespace mgn
@@ -0,0 +1,70 @@
+#pragma once
+#ifndef __MGN_TERRAIN_LABEL_TEXT_TABLE_H__
+#define __MGN_TERRAIN_LABEL_TEXT_TABLE_H__
+
+#include <boost/thread/mutex.hpp>
+#include <boost/unordered_map.hpp>
+
+#include <string>
+#include <vector>
+
+namespace mgn {
+    namespace terrain {
+
+        /*! Label text table class.
+        ** Global table of interned label texts, every distinct text gets id counted from zero.
+        ** Texts are interned once by labels tasks, so duplicated labels are detected by ids.
+        ** Entries are reference counted: text is removed once its last label is released,
+        ** and its id is reused by the next new text, so ids stay dense.
+        */
+        class LabelTextTable {
+        public:
+            static LabelTextTable * GetInstance();
+
+            //! Returns id of the text and adds reference to it, may be called from any thread
+            unsigned int Intern(const std::wstring& text);
+
+            //! Adds reference to interned text
+            void AddRef(unsigned int id);
+
+            //! Removes reference, the text is removed from table with the last one
+            void Release(unsigned int id);
+
+        private:
+            LabelTextTable();
+            LabelTextTable(const LabelTextTable&);
+            LabelTextTable& operator=(const LabelTextTable&);
+
+            typedef boost::unordered_map<std::wstring, unsigned int> IdMap;
+
+            struct Entry {
+                const std::wstring * text; //!< key in ids map, NULL for free id
+                unsigned int ref_count;
+            };
+
+            IdMap ids_;
+            std::vector<Entry> entries_;
+            std::vector<unsigned int> free_ids_;
+            boost::mutex mutex_;
+        };
+
+        /*! Label id set class.
+        ** Bitset of label text ids used in frame, it's cleared in time of number of inserted ids
+        ** and doesn't allocate memory once it has grown to the peak number of interned texts.
+        */
+        class LabelIdSet {
+        public:
+            //! Returns false if id is already in set
+            bool Insert(unsigned int id);
+            bool Contains(unsigned int id) const;
+            void Clear();
+
+        private:
+            std::vector<unsigned char> flags_;
+            std::vector<unsigned int> inserted_ids_;
+        };
+
+    } // namespace terrain
+} // namespace mgn
+
+#endif
@@ -46,18 +46,25 @@ namespace mgn {
             }
         }
         bool Mesh::MakeRenderable()
+        {
+            if (!MakeRenderable(vertices_array_, indices_array_))
+                return false;
+            
+            FreeArrays();
+            
+            return true;
+        }
+        bool Mesh::MakeRenderable(void * vertices, void * indices)
         {
             FillAttributes();
             renderer_->AddVertexFormat(vertex_format_, &attribs_[0], (unsigned int)attribs_.size());
             
-            renderer_->AddVertexBuffer(vertex_buffer_, num_vertices_ * vertex_format_->vertex_size(), vertices_array_, graphics::BufferUsage::kStaticDraw);
+            renderer_->AddVertexBuffer(vertex_buffer_, num_vertices_ * vertex_format_->vertex_size(), vertices, graphics::BufferUsage::kStaticDraw);
             if (vertex_buffer_ == NULL) return false;
             
-            renderer_->AddIndexBuffer(index_buffer_, num_indices_, index_size_, indices_array_, graphics::BufferUsage::kStaticDraw);
+            renderer_->AddIndexBuffer(index_buffer_, num_indices_, index_size_, indices, graphics::BufferUsage::kStaticDraw);
             if (index_buffer_ == NULL) return false;
             
-            FreeArrays();
-
             can_render_ = true;
             
             return true;
@@ -16,6 +16,8 @@ namespace mgn {
             virtual ~Mesh();
             
             bool MakeRenderable();
+            //! Creates buffers from external arrays, which stay owned by caller
+            bool MakeRenderable(void * vertices, void * indices);
             
             void Render();
 
@@ -0,0 +1,107 @@
+#pragma once
+#ifndef __MGN_TERRAIN_PACKED_TILE_KEY_H__
+#define __MGN_TERRAIN_PACKED_TILE_KEY_H__
+
+#include <cstddef>
+
+namespace mgn {
+    namespace terrain {
+
+        /*! Packed tile key shared by terrain tiles and mercator nodes.
+        ** Level is stored in the upper 6 bits, the rest 58 bits hold Morton-interleaved
+        ** x and y (29 bits each, two's complement). Keys of the same level are ordered along
+        ** Z-curve, so neighbouring tiles have close values.
+        */
+        class PackedTileKey {
+        public:
+            typedef unsigned long long ValueType;
+
+            PackedTileKey() : value_(0) {}
+            PackedTileKey(int level, int x, int y) : value_(Encode(level, x, y)) {}
+
+            static ValueType Encode(int level, int x, int y)
+            {
+                return (static_cast<ValueType>(level) << kCoordBits * 2)
+                    | SpreadBits(static_cast<ValueType>(x) & kCoordMask)
+                    | (SpreadBits(static_cast<ValueType>(y) & kCoordMask) << 1);
+            }
+            static PackedTileKey FromValue(ValueType value)
+            {
+                PackedTileKey key;
+                key.value_ = value;
+                return key;
+            }
+
+            ValueType value() const { return value_; }
+            int level() const { return static_cast<int>(value_ >> kCoordBits * 2); }
+            int x() const { return SignExtend(CompactBits(value_)); }
+            int y() const { return SignExtend(CompactBits(value_ >> 1)); }
+
+            //! Key of the tile at previous level that contains this one
+            PackedTileKey Parent() const
+            {
+                return PackedTileKey(level() - 1, x() >> 1, y() >> 1);
+            }
+            //! Key of child tile, index bits: 0 - x offset, 1 - y offset
+            PackedTileKey Child(int index) const
+            {
+                // Interleaved code shifted by one level is just appended with child index
+                const ValueType morton = ((value_ & kMortonMask) << 2 | (index & 3)) & kMortonMask;
+                return FromValue((static_cast<ValueType>(level() + 1) << kCoordBits * 2) | morton);
+            }
+            //! Key of the tile at the same level shifted by (dx, dy)
+            PackedTileKey Neighbour(int dx, int dy) const
+            {
+                return PackedTileKey(level(), x() + dx, y() + dy);
+            }
+
+            bool operator ==(const PackedTileKey& other) const { return value_ == other.value_; }
+            bool operator !=(const PackedTileKey& other) const { return value_ != other.value_; }
+            bool operator < (const PackedTileKey& other) const { return value_ < other.value_; }
+
+        private:
+            static const int kCoordBits = 29;
+            static const ValueType kCoordMask = (1ULL << kCoordBits) - 1;
+            static const ValueType kMortonMask = (1ULL << kCoordBits * 2) - 1;
+
+            //! Inserts zero bit between every bit of 32-bit value
+            static ValueType SpreadBits(ValueType v)
+            {
+                v = (v | (v << 16)) & 0x0000FFFF0000FFFFULL;
+                v = (v | (v <<  8)) & 0x00FF00FF00FF00FFULL;
+                v = (v | (v <<  4)) & 0x0F0F0F0F0F0F0F0FULL;
+                v = (v | (v <<  2)) & 0x3333333333333333ULL;
+                v = (v | (v <<  1)) & 0x5555555555555555ULL;
+                return v;
+            }
+            //! Inverse of SpreadBits, takes every even bit of value
+            static ValueType CompactBits(ValueType v)
+            {
+                v &= 0x5555555555555555ULL & kMortonMask;
+                v = (v | (v >>  1)) & 0x3333333333333333ULL;
+                v = (v | (v >>  2)) & 0x0F0F0F0F0F0F0F0FULL;
+                v = (v | (v >>  4)) & 0x00FF00FF00FF00FFULL;
+                v = (v | (v >>  8)) & 0x0000FFFF0000FFFFULL;
+                v = (v | (v >> 16)) & 0x00000000FFFFFFFFULL;
+                return v;
+            }
+            static int SignExtend(ValueType v)
+            {
+                const ValueType kSignBit = 1ULL << (kCoordBits - 1);
+                return static_cast<int>(static_cast<long long>(v ^ kSignBit) - static_cast<long long>(kSignBit));
+            }
+
+            ValueType value_;
+        };
+
+        inline std::size_t hash_value(const PackedTileKey& key)
+        {
+            // Fibonacci hashing, upper bits are the best mixed ones
+            const PackedTileKey::ValueType hash = key.value() * 0x9E3779B97F4A7C15ULL;
+            return static_cast<std::size_t>(hash ^ (hash >> 32));
+        }
+
+    } // namespace terrain
+} // namespace mgn
+
+#endif
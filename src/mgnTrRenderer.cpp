@@ -86,7 +86,7 @@ namespace mgn {
         // Sizes taken from RenderToolManagerGL.cpp
         const int size3 = static_cast<int>(18.0f /** pixel_scale*/ + 0.5f);
         const int border = static_cast<int>(3.0f /*+ pixel_scale*/ + 0.5f);
-        mFont = Font::CreateWithBorder(renderer, font_path, size3, border,
+        mFont = Font::CreateDistanceField(renderer, font_path, size3, border,
             Color(0.0f, 0.0f, 0.0f), Color(1.0f, 1.0f, 1.0f), pixel_scale);
 
 #ifndef MGNTR_MERCATOR_TILE
@@ -184,6 +184,12 @@ namespace mgn {
         {
             s_timer->Reset();
             LOG_INFO(0, ("FPS: %.2f", mTimeManager->GetFrameRate()));
+#ifdef MGNTR_MERCATOR_TILE
+            const MercatorRenderStats& stats = mMercatorTree->GetRenderStats();
+            LOG_INFO(0, ("Tiles drawn: %d, culled: %d", stats.num_drawn, stats.num_culled));
+            LOG_INFO(0, ("Requests handled: %d in %d us, pending: %d",
+                stats.num_handled_requests, stats.request_time, stats.num_pending_requests));
+#endif
         }
 #endif
 
@@ -486,6 +492,7 @@ namespace mgn {
             {
                 mBillboardShader->Bind();
                 mBillboardShader->Uniform1i("u_texture", 0);
+                mBillboardShader->Uniform1i("u_distance_field", 0);
                 mBillboardShader->Unbind();
             }
         }
@@ -654,12 +661,24 @@ namespace mgn {
     }
     void Renderer::IntersectionWithRay(const math::Vector3& ray, math::Vector3& intersection) const
     {
+#ifdef MGNTR_MERCATOR_TILE
+        // Loaded tiles give intersection without altitude queries to provider
+        const float kMSM = static_cast<float>(mgn::terrain::GetMapSizeMax());
+        math::Vector3 origin;
+        mTerrainView->LocalToPixel(mTerrainView->getCamPosition(), origin, kMSM);
+        float distance = mTerrainView->getLargestCamDistance();
+        mTerrainView->LocalToPixelDistance(distance, distance, kMSM);
+        if (mMercatorTree->IntersectSegment(origin, origin + distance * ray, intersection))
+            return;
+#endif
         mTerrainView->IntersectionWithRayPixel(ray, intersection);
     }
     void Renderer::GetSelectedIcons(int x, int y, int radius, std::vector<int>& ids) const
     {
 #ifndef MGNTR_MERCATOR_TILE
         mTerrainMap->GetSelectedIcons(x, mSizeY - y, radius, ids);
+#else
+        mMercatorTree->GetSelectedIcons(x, mSizeY - y, radius, ids);
 #endif
     }
     void Renderer::GetSelectedTracks(int x, int y, int radius, std::vector<int>& ids) const
@@ -678,6 +697,8 @@ namespace mgn {
     {
 #ifndef MGNTR_MERCATOR_TILE
         mTerrainMap->GetSelectedPOIs(x, mSizeY - y, radius, objects);
+#else
+        mMercatorTree->GetSelectedPOIs(x, mSizeY - y, radius, objects);
 #endif
     }
     void Renderer::UpdatePOISelection(const std::vector<int>& selection)
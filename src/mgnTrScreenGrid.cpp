@@ -0,0 +1,242 @@
+#include "mgnTrScreenGrid.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+    const int kMaxCellsPerRect = 64;
+    const size_t kInitialCellCapacity = 256;
+
+    boost::uint64_t CellKey(int x, int y)
+    {
+        return (static_cast<boost::uint64_t>(static_cast<boost::uint32_t>(x)) << 32) |
+            static_cast<boost::uint64_t>(static_cast<boost::uint32_t>(y));
+    }
+
+    size_t CellHash(boost::uint64_t key)
+    {
+        boost::uint32_t hash = static_cast<boost::uint32_t>(key >> 32) * 0x9E3779B1U ^
+            static_cast<boost::uint32_t>(key) * 0x85EBCA6BU;
+        hash ^= hash >> 15;
+        return static_cast<size_t>(hash);
+    }
+
+    void GetBounds(const math::Rect& rect, float& min_x, float& min_y, float& max_x, float& max_y)
+    {
+        min_x = max_x = rect.vertices[0].x;
+        min_y = max_y = rect.vertices[0].y;
+        for (int i = 1; i < 4; ++i)
+        {
+            min_x = std::min(min_x, rect.vertices[i].x);
+            min_y = std::min(min_y, rect.vertices[i].y);
+            max_x = std::max(max_x, rect.vertices[i].x);
+            max_y = std::max(max_y, rect.vertices[i].y);
+        }
+    }
+
+} // namespace
+
+namespace mgn {
+    namespace terrain {
+
+        ScreenGrid::ScreenGrid()
+        : cell_size_(0.0f)
+        , num_cells_(0)
+        , generation_(1U)
+        , stamp_(0U)
+        {
+        }
+        void ScreenGrid::Clear(float cell_size)
+        {
+            cell_size_ = cell_size;
+            items_.clear();
+            entries_.clear();
+            large_items_.clear();
+            // Cells of previous generations are treated as empty
+            num_cells_ = 0;
+            if (++generation_ == 0U)
+            {
+                for (std::vector<Cell>::iterator it = cells_.begin(); it != cells_.end(); ++it)
+                    it->generation = 0U;
+                generation_ = 1U;
+            }
+        }
+        bool ScreenGrid::empty() const
+        {
+            return items_.empty();
+        }
+        size_t ScreenGrid::size() const
+        {
+            return items_.size();
+        }
+        void ScreenGrid::Insert(const math::Rect& rect, int id)
+        {
+            if (cell_size_ <= 0.0f)
+            {
+                float min_x, min_y, max_x, max_y;
+                GetBounds(rect, min_x, min_y, max_x, max_y);
+                cell_size_ = std::max(max_x - min_x, max_y - min_y);
+                if (cell_size_ <= 0.0f)
+                    cell_size_ = 1.0f;
+            }
+
+            const int index = static_cast<int>(items_.size());
+            Item item;
+            item.rect = rect;
+            item.id = id;
+            item.stamp = stamp_;
+            items_.push_back(item);
+
+            int x0, y0, x1, y1;
+            if (!GetCells(rect, x0, y0, x1, y1))
+            {
+                large_items_.push_back(index);
+                return;
+            }
+            for (int y = y0; y <= y1; ++y)
+            {
+                for (int x = x0; x <= x1; ++x)
+                {
+                    // Entry is pushed to the front of cell's list
+                    Cell * cell = FindCell(CellKey(x, y), true);
+                    Entry entry;
+                    entry.item = index;
+                    entry.next = cell->head;
+                    cell->head = static_cast<int>(entries_.size());
+                    entries_.push_back(entry);
+                }
+            }
+        }
+        bool ScreenGrid::Intersects(const math::Rect& rect)
+        {
+            return Search(rect, NULL);
+        }
+        void ScreenGrid::Query(const math::Rect& rect, std::vector<int>& ids)
+        {
+            ids.clear();
+            Search(rect, &ids);
+        }
+        bool ScreenGrid::GetCells(const math::Rect& rect, int& x0, int& y0, int& x1, int& y1) const
+        {
+            float min_x, min_y, max_x, max_y;
+            GetBounds(rect, min_x, min_y, max_x, max_y);
+            const float num_x = floorf(max_x / cell_size_) - floorf(min_x / cell_size_) + 1.0f;
+            const float num_y = floorf(max_y / cell_size_) - floorf(min_y / cell_size_) + 1.0f;
+            if (!(num_x * num_y <= static_cast<float>(kMaxCellsPerRect))) // also catches NaN
+                return false;
+            x0 = static_cast<int>(floorf(min_x / cell_size_));
+            y0 = static_cast<int>(floorf(min_y / cell_size_));
+            x1 = static_cast<int>(floorf(max_x / cell_size_));
+            y1 = static_cast<int>(floorf(max_y / cell_size_));
+            return true;
+        }
+        ScreenGrid::Cell * ScreenGrid::FindCell(boost::uint64_t key, bool insert)
+        {
+            // Load factor is kept at most a half, so probing always ends at empty cell
+            if (insert && (num_cells_ + 1) * 2 > cells_.size())
+                GrowCells();
+            if (cells_.empty())
+                return NULL;
+            const size_t mask = cells_.size() - 1;
+            for (size_t index = CellHash(key) & mask; ; index = (index + 1) & mask)
+            {
+                Cell& cell = cells_[index];
+                if (cell.generation != generation_)
+                {
+                    if (!insert)
+                        return NULL;
+                    cell.key = key;
+                    cell.head = -1;
+                    cell.generation = generation_;
+                    ++num_cells_;
+                    return &cell;
+                }
+                if (cell.key == key)
+                    return &cell;
+            }
+        }
+        void ScreenGrid::GrowCells()
+        {
+            std::vector<Cell> old_cells;
+            old_cells.swap(cells_);
+            Cell empty_cell;
+            empty_cell.key = 0;
+            empty_cell.head = -1;
+            empty_cell.generation = 0U;
+            cells_.resize(old_cells.empty() ? kInitialCellCapacity : old_cells.size() * 2, empty_cell);
+            num_cells_ = 0;
+            for (std::vector<Cell>::const_iterator it = old_cells.begin(); it != old_cells.end(); ++it)
+            {
+                if (it->generation == generation_)
+                    FindCell(it->key, true)->head = it->head;
+            }
+        }
+        bool ScreenGrid::TestItem(int index, const math::Rect& rect)
+        {
+            Item& item = items_[index];
+            // Rectangle may be referenced from several cells of the query
+            if (item.stamp == stamp_)
+                return false;
+            item.stamp = stamp_;
+            return math::RectRectIntersection2D(rect, item.rect);
+        }
+        bool ScreenGrid::Search(const math::Rect& rect, std::vector<int> * ids)
+        {
+            if (items_.empty())
+                return false;
+            ++stamp_;
+
+            bool found = false;
+            for (std::vector<int>::const_iterator it = large_items_.begin(); it != large_items_.end(); ++it)
+            {
+                if (TestItem(*it, rect))
+                {
+                    if (ids == NULL)
+                        return true;
+                    ids->push_back(items_[*it].id);
+                    found = true;
+                }
+            }
+
+            int x0, y0, x1, y1;
+            if (!GetCells(rect, x0, y0, x1, y1))
+            {
+                // Query is too large for cells, test every item
+                for (int index = 0; index < static_cast<int>(items_.size()); ++index)
+                {
+                    if (TestItem(index, rect))
+                    {
+                        if (ids == NULL)
+                            return true;
+                        ids->push_back(items_[index].id);
+                        found = true;
+                    }
+                }
+                return found;
+            }
+            for (int y = y0; y <= y1; ++y)
+            {
+                for (int x = x0; x <= x1; ++x)
+                {
+                    const Cell * cell = FindCell(CellKey(x, y), false);
+                    if (cell == NULL)
+                        continue;
+                    for (int entry = cell->head; entry != -1; entry = entries_[entry].next)
+                    {
+                        const int index = entries_[entry].item;
+                        if (TestItem(index, rect))
+                        {
+                            if (ids == NULL)
+                                return true;
+                            ids->push_back(items_[index].id);
+                            found = true;
+                        }
+                    }
+                }
+            }
+            return found;
+        }
+
+    } // namespace terrain
+} // namespace mgn
@@ -0,0 +1,77 @@
+#pragma once
+#ifndef __MGN_TERRAIN_SCREEN_GRID_H__
+#define __MGN_TERRAIN_SCREEN_GRID_H__
+
+#include "MapDrawing/Graphics/mgnCommonMath.h"
+
+#include <boost/cstdint.hpp>
+
+#include <vector>
+
+namespace mgn {
+    namespace terrain {
+
+        /*! Screen grid class.
+        ** Uniform grid over 2D rectangles in eye space, it's cleared and refilled every frame.
+        ** Rectangle is referenced from every cell touched by its bounds, so insertion and overlap query
+        ** cost O(1) amortized for rectangles of similar size. Touched cells are kept in open addressing
+        ** table stamped with generation of frame, so clearing doesn't free memory and is O(1).
+        ** Cell size is taken from the first inserted rectangle unless it's given explicitly.
+        */
+        class ScreenGrid {
+        public:
+            ScreenGrid();
+
+            //! Removes all rectangles, memory is kept for the next frame
+            void Clear(float cell_size = 0.0f);
+
+            bool empty() const;
+            size_t size() const;
+
+            void Insert(const math::Rect& rect, int id);
+
+            //! Checks if rectangle intersects any inserted one
+            bool Intersects(const math::Rect& rect);
+
+            //! Collects ids of inserted rectangles intersecting given one, every id is reported once
+            void Query(const math::Rect& rect, std::vector<int>& ids);
+
+        private:
+            struct Item {
+                math::Rect rect;
+                int id;
+                unsigned int stamp; //!< last query which has tested the item
+            };
+            struct Entry {
+                int item;
+                int next; //!< next entry of the same cell, -1 terminates
+            };
+            struct Cell {
+                boost::uint64_t key;
+                int head; //!< first entry of the cell
+                unsigned int generation; //!< cell is empty unless it matches grid generation
+            };
+
+            //! Returns false if rectangle covers too many cells to be stored in them
+            bool GetCells(const math::Rect& rect, int& x0, int& y0, int& x1, int& y1) const;
+            //! Returns cell of key, NULL if it's empty and insertion isn't requested
+            Cell * FindCell(boost::uint64_t key, bool insert);
+            void GrowCells();
+            bool TestItem(int index, const math::Rect& rect);
+            //! Stops at the first intersection unless ids are collected
+            bool Search(const math::Rect& rect, std::vector<int> * ids);
+
+            float cell_size_;
+            std::vector<Item> items_;
+            std::vector<Entry> entries_;
+            std::vector<int> large_items_; //!< items spanning too many cells, tested linearly
+            std::vector<Cell> cells_; //!< power of two sized table, linear probing
+            size_t num_cells_; //!< cells of the current generation
+            unsigned int generation_;
+            unsigned int stamp_;
+        };
+
+    } // namespace terrain
+} // namespace mgn
+
+#endif
@@ -648,8 +648,8 @@ namespace mgn {
             mBillboardShader->Bind();
 
             // Draw labels
-            mUsedLabels.clear();
-            mLabelBoundingBoxes.clear();
+            mUsedLabels.Clear();
+            mLabelGrid.Clear();
             for (size_t i=0; i<renderedTiles.size(); ++i)
             {
                 TerrainTile * tile = renderedTiles[i];
@@ -657,7 +657,7 @@ namespace mgn {
 
                 renderer_->PushMatrix();
                 renderer_->Translate(tile->position());
-                tile->drawLabelsMesh(mUsedLabels, mLabelBoundingBoxes);
+                tile->drawLabelsMesh(mUsedLabels, mLabelGrid);
                 renderer_->PopMatrix();
             }
             // Draw point user meshes
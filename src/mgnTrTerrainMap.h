@@ -1,6 +1,8 @@
 #pragma once  
 
 #include "mgnTrTerrainTile.h"
+#include "mgnTrLabelTextTable.h"
+#include "mgnTrScreenGrid.h"
 #include "mgnMdMapObjectsVector.h"
 
 namespace mgn {
@@ -28,8 +30,8 @@ namespace mgn {
             std::list<Icon*> mIconList; //!< list of icons (any billboard objects) for rendering
             mgnCSHandle mIconListCriticalSection;
 
-            std::vector<math::Rect> mLabelBoundingBoxes;
-            boost::unordered_set<std::wstring> mUsedLabels;
+            ScreenGrid mLabelGrid;
+            LabelIdSet mUsedLabels;
 
             mutable int mFrameCount;
 
@@ -4,9 +4,12 @@
 #include "mgnTrIcon.h"
 #include "mgnTrLabel.h"
 #include "mgnTrAtlasLabel.h"
+#include "mgnTrBitmapResample.h"
 #include "mgnTrHeightmap.h"
 #include "mgnTrHighlightTrackRenderer.h"
+#include "mgnTrLabelTextTable.h"
 #include "mgnTrPassiveHighlightTrackRenderer.h"
+#include "mgnTrScreenGrid.h"
 
 #include "mgnMdBitmap.h"
 
@@ -21,65 +24,12 @@ static T roundToPowerOfTwo(T x)
     return n;
 }
 
-static int interpolateColor(int c1, int c2, float alpha)
-{
-    int a1 = (c1 & 0xff000000) >> 24;
-    int b1 = (c1 & 0xff0000) >> 16;
-    int g1 = (c1 & 0x00ff00) >> 8;
-    int r1 = (c1 & 0x0000ff);
-    int a2 = (c2 & 0xff000000) >> 24;
-    int b2 = (c2 & 0xff0000) >> 16;
-    int g2 = (c2 & 0x00ff00) >> 8;
-    int r2 = (c2 & 0x0000ff);
-    int r = r1 + (int)((r2-r1)*alpha);
-    int g = g1 + (int)((g2-g1)*alpha);
-    int b = b1 + (int)((b2-b1)*alpha);
-    int a = a1 + (int)((a2-a1)*alpha);
-    return (a << 24) | (b << 16) | (g << 8) | r;
-}
-
 static void MakePotTextureFromNpot(int& width, int& height, std::vector<unsigned char>& vdata)
 {
-    if (((width & (width-1)) != 0) || ((height & (height-1)) != 0))
+    int w2, h2;
+    std::vector<unsigned char> new_vdata;
+    if (mgn::terrain::MakePotBitmap(width, height, vdata, w2, h2, new_vdata))
     {
-        // Need to make POT
-        unsigned int * data = reinterpret_cast<unsigned int*>(&vdata[0]);
-        int w2 = roundToPowerOfTwo(width);
-        int h2 = roundToPowerOfTwo(height);
-
-        // Rescale image to power of 2
-        int new_size = w2 * h2;
-        std::vector<unsigned char> new_vdata;
-        new_vdata.resize(new_size*4);
-        unsigned int * new_data = reinterpret_cast<unsigned int*>(&new_vdata[0]);
-        for (int dh2 = 0; dh2 < h2; ++dh2)
-        {
-            float rh = (float)dh2 / (float)h2;
-            float y = rh * (float)height;
-            int dh = (int)y;
-            int dh1 = std::min<int>(dh+1, height-1);
-            float ry = y - (float)dh; // fract part of y
-            for (int dw2 = 0; dw2 < w2; ++dw2)
-            {
-                float rw = (float)dw2 / (float)w2;
-                float x = rw * (float)width;
-                int dw = (int)x;
-                int dw1 = std::min<int>(dw+1, width-1);
-                float rx = x - (float)dw; // fract part of x
-
-                // We will use bilinear interpolation
-                int sample1 = (int) data[dw +width*dh ];
-                int sample2 = (int) data[dw1+width*dh ];
-                int sample3 = (int) data[dw +width*dh1];
-                int sample4 = (int) data[dw1+width*dh1];
-
-                int color1 = interpolateColor(sample1, sample2, rx);
-                int color2 = interpolateColor(sample3, sample4, rx);;
-                int color3 = interpolateColor(color1, color2, ry);
-                new_data[dw2+w2*dh2] = (unsigned int)color3;
-            }
-        }
-        // Finally
         width = w2;
         height = h2;
         vdata.swap(new_vdata);
@@ -464,52 +414,22 @@ namespace mgn {
                 // Rescale image if it's not power of two 
                 // (thus generateMipmaps isn't working on iOS devices with NPOT textures)
                 graphics::Texture *tex = 0;
+                unsigned short tex_w = w;
+                unsigned short tex_h = h;
                 if (((w & (w-1)) != 0) || ((h & (h-1)) != 0))
                 {
-                    unsigned short w2 = roundToPowerOfTwo(w);
-                    unsigned short h2 = roundToPowerOfTwo(h);
+                    tex_w = roundToPowerOfTwo(w);
+                    tex_h = roundToPowerOfTwo(h);
 
                     // Rescale image to power of 2
-                    unsigned int new_size = w2 * h2;
-                    unsigned int * new_data = new unsigned int[new_size];
-                    for (unsigned short dh2 = 0; dh2 < h2; ++dh2)
-                    {
-                        float rh = (float)dh2 / (float)h2;
-                        float y = rh * (float)h;
-                        unsigned short dh = (unsigned short)y;
-                        unsigned short dh1 = std::min<unsigned short>(dh+1, h-1);
-                        float ry = y - (float)dh; // fract part of y
-                        for (unsigned short dw2 = 0; dw2 < w2; ++dw2)
-                        {
-                            float rw = (float)dw2 / (float)w2;
-                            float x = rw * (float)w;
-                            unsigned short dw = (unsigned short)x;
-                            unsigned short dw1 = std::min<unsigned short>(dw+1, w-1);
-                            float rx = x - (float)dw; // fract part of x
-                            
-                            // We will use bilinear interpolation
-                            int sample1 = (int) data[dw +w*dh ];
-                            int sample2 = (int) data[dw1+w*dh ];
-                            int sample3 = (int) data[dw +w*dh1];
-                            int sample4 = (int) data[dw1+w*dh1];
-
-                            int color1 = interpolateColor(sample1, sample2, rx);
-                            int color2 = interpolateColor(sample3, sample4, rx);;
-                            int color3 = interpolateColor(color1, color2, ry);
-                            new_data[dw2+w2*dh2] = (unsigned int)color3;
-                        }
-                    }
-                    unsigned char * udata = reinterpret_cast<unsigned char*>(new_data);
-                    mOwner->renderer_->CreateTextureFromData(tex, w2, h2,
-                        graphics::Image::Format::kRGBA8, graphics::Texture::Filter::kTrilinear, udata);
-                    delete[] new_data;
-                }
-                else
-                {
-                    unsigned char * udata = reinterpret_cast<unsigned char*>(&data[0]);
-                    mOwner->renderer_->CreateTextureFromData(tex, w, h,
-                        graphics::Image::Format::kRGBA8, graphics::Texture::Filter::kTrilinear, udata);
+                    std::vector<unsigned int> new_data(tex_w * tex_h);
+                    ResampleBitmap(reinterpret_cast<const unsigned char*>(&data[0]), w, h,
+                        reinterpret_cast<unsigned char*>(&new_data[0]), tex_w, tex_h);
+                    data.swap(new_data);
                 }
+                unsigned char * udata = reinterpret_cast<unsigned char*>(&data[0]);
+                mOwner->renderer_->CreateTextureFromData(tex, tex_w, tex_h,
+                    graphics::Image::Format::kRGBA8, graphics::Texture::Filter::kTrilinear, udata);
                 
                 mOwner->mIconTextureCache.insert(std::make_pair<size_t, graphics::Texture*>(bitmap_hash, tex));
                 
@@ -662,16 +582,13 @@ namespace mgn {
             }
         }
 
-        void TerrainTile::drawLabelsMesh(boost::unordered_set<std::wstring>& used_labels, std::vector<math::Rect>& bboxes)
+        void TerrainTile::drawLabelsMesh(LabelIdSet& used_labels, ScreenGrid& label_grid)
         {
             for (size_t i=0; i<mLabelMeshes.size(); ++i)
             {
                 Label * label = mLabelMeshes[i];
-                if(used_labels.find(label->text()) == used_labels.end())
-                {
+                if (used_labels.Insert(label->text_id()))
                     label->render();
-                    used_labels.insert(label->text());
-                }
             }
 
             const math::Matrix4& view = mOwner->renderer_->view_matrix();
@@ -680,21 +597,11 @@ namespace mgn {
                 AtlasLabel * label = mAtlasLabelMeshes[i];
                 math::Rect bbox;
                 label->GetBoundingBox(view, bbox);
-                bool intersection_found = false;
-                for (size_t j = 0; j < bboxes.size(); ++j) //
-                {
-                    const math::Rect& checked_bbox = bboxes[j];
-                    if (math::RectRectIntersection2D(bbox, checked_bbox))
-                    {
-                        intersection_found = true;
-                        break;
-                    }
-                }
-                if(!intersection_found && used_labels.find(label->text()) == used_labels.end())
+                if (!used_labels.Contains(label->text_id()) && !label_grid.Intersects(bbox))
                 {
                     label->render();
-                    used_labels.insert(label->text());
-                    bboxes.push_back(bbox);
+                    used_labels.Insert(label->text_id());
+                    label_grid.Insert(bbox, static_cast<int>(label_grid.size()));
                 }
             }
         }
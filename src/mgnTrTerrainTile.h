@@ -32,6 +32,8 @@ namespace mgn {
         class Label;
         class AtlasLabel;
         class Icon;
+        class ScreenGrid;
+        class LabelIdSet;
 
         class TerrainTile : public mgnMdIUserDataDrawContext
         {
@@ -150,7 +152,7 @@ namespace mgn {
             void drawSegments(const math::Frustum& frustum);
             void drawTileMesh(const math::Frustum& frustum, graphics::Shader * shader);
             void drawLabelsMesh(
-                boost::unordered_set<std::wstring>& used_labels, std::vector<math::Rect>& bboxes);
+                LabelIdSet& used_labels, ScreenGrid& label_grid);
             void drawUserObjects();
         };
 
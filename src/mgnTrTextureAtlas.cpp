@@ -0,0 +1,245 @@
+#include "mgnTrTextureAtlas.h"
+
+#include "MapDrawing/Graphics/Renderer.h"
+
+#include <algorithm>
+#include <cstring>
+#include <assert.h>
+
+namespace {
+    const int kPadding = 1; // edge pixels are repeated around bitmap, so filtering doesn't take neighbours
+}
+
+namespace mgn {
+    namespace terrain {
+
+        TextureRegion::TextureRegion()
+        : texture(NULL)
+        , u0(0.0f), v0(0.0f)
+        , u1(1.0f), v1(1.0f)
+        {
+        }
+        void TextureRegion::Map(float& u, float& v) const
+        {
+            u = u0 + u * (u1 - u0);
+            v = v0 + v * (v1 - v0);
+        }
+
+        TextureAtlas::TextureAtlas(graphics::Renderer * renderer, int page_size, int max_pages)
+        : renderer_(renderer)
+        , page_size_(page_size)
+        , max_pages_(max_pages)
+        {
+        }
+        TextureAtlas::~TextureAtlas()
+        {
+            Clear();
+        }
+        bool TextureAtlas::Acquire(Key key, TextureRegion& region)
+        {
+            RegionMap::iterator it = regions_.find(key);
+            if (it == regions_.end())
+                return false;
+            Region& found = it->second;
+            if (found.ref_count == 0)
+                unused_.erase(found.unused_it);
+            ++found.ref_count;
+            GetRegion(found, region);
+            return true;
+        }
+        bool TextureAtlas::Insert(Key key, int width, int height, const unsigned char * data, TextureRegion& region)
+        {
+            if (Acquire(key, region))
+                return true;
+
+            Region inserted;
+            if (!Allocate(width + 2 * kPadding, height + 2 * kPadding, inserted.slot))
+                return false;
+            inserted.width = width;
+            inserted.height = height;
+            inserted.ref_count = 1;
+            ++pages_[inserted.slot.page].num_regions;
+            Upload(inserted.slot, width, height, data);
+            regions_.insert(std::make_pair(key, inserted));
+            GetRegion(inserted, region);
+            return true;
+        }
+        void TextureAtlas::Release(Key key)
+        {
+            RegionMap::iterator it = regions_.find(key);
+            assert(it != regions_.end() && it->second.ref_count > 0);
+            if (it == regions_.end())
+                return;
+            Region& found = it->second;
+            if (--found.ref_count == 0)
+                found.unused_it = unused_.insert(unused_.end(), key);
+        }
+        void TextureAtlas::Clear()
+        {
+            assert(unused_.size() == regions_.size());
+            for (std::vector<Page>::iterator it = pages_.begin(); it != pages_.end(); ++it)
+            {
+                if (it->texture)
+                    renderer_->DeleteTexture(it->texture);
+            }
+            pages_.clear();
+            free_slots_.clear();
+            regions_.clear();
+            unused_.clear();
+        }
+        int TextureAtlas::num_pages() const
+        {
+            return static_cast<int>(pages_.size());
+        }
+        bool TextureAtlas::Allocate(int width, int height, Slot& slot)
+        {
+            if (width > page_size_ || height > page_size_)
+                return false;
+            for (;;)
+            {
+                if (AllocateFree(width, height, slot))
+                    return true;
+                for (size_t i = 0; i < pages_.size(); ++i)
+                {
+                    if (AllocateShelf(static_cast<int>(i), width, height, slot))
+                        return true;
+                }
+                // New page is added while limit allows, then space is taken from unused bitmaps
+                if (static_cast<int>(pages_.size()) < max_pages_)
+                {
+                    if (!AddPage())
+                        return false;
+                }
+                else if (!EvictRegion())
+                    return false;
+            }
+        }
+        bool TextureAtlas::AllocateFree(int width, int height, Slot& slot)
+        {
+            // Best fit among slots of evicted bitmaps
+            int best = -1;
+            int best_area = 0;
+            for (size_t i = 0; i < free_slots_.size(); ++i)
+            {
+                const Slot& free_slot = free_slots_[i];
+                if (free_slot.width < width || free_slot.height < height)
+                    continue;
+                int area = free_slot.width * free_slot.height;
+                if (best < 0 || area < best_area)
+                {
+                    best = static_cast<int>(i);
+                    best_area = area;
+                }
+            }
+            if (best < 0)
+                return false;
+            slot = free_slots_[best];
+            free_slots_[best] = free_slots_.back();
+            free_slots_.pop_back();
+            return true;
+        }
+        bool TextureAtlas::AllocateShelf(int page_index, int width, int height, Slot& slot)
+        {
+            Page& page = pages_[page_index];
+
+            // The lowest shelf which bitmap fits in
+            Shelf * best = NULL;
+            for (std::vector<Shelf>::iterator it = page.shelves.begin(); it != page.shelves.end(); ++it)
+            {
+                if (it->height < height || it->x + width > page_size_)
+                    continue;
+                if (best == NULL || it->height < best->height)
+                    best = &*it;
+            }
+            if (best == NULL)
+            {
+                if (page.top + height > page_size_)
+                    return false;
+                Shelf shelf;
+                shelf.y = page.top;
+                shelf.height = height;
+                shelf.x = 0;
+                page.shelves.push_back(shelf);
+                page.top += height;
+                best = &page.shelves.back();
+            }
+            slot.page = page_index;
+            slot.x = best->x;
+            slot.y = best->y;
+            slot.width = width;
+            slot.height = best->height;
+            best->x += width;
+            return true;
+        }
+        bool TextureAtlas::AddPage()
+        {
+            Page page;
+            page.texture = NULL;
+            page.top = 0;
+            page.num_regions = 0;
+            std::vector<unsigned char> data(page_size_ * page_size_ * 4, 0);
+            renderer_->CreateTextureFromData(page.texture, page_size_, page_size_,
+                graphics::Image::Format::kRGBA8, graphics::Texture::Filter::kLinear, &data[0]);
+            if (!page.texture)
+                return false;
+            pages_.push_back(page);
+            return true;
+        }
+        bool TextureAtlas::EvictRegion()
+        {
+            if (unused_.empty())
+                return false;
+            RegionMap::iterator it = regions_.find(unused_.front());
+            assert(it != regions_.end());
+            const Slot slot = it->second.slot;
+            regions_.erase(it);
+            unused_.pop_front();
+
+            Page& page = pages_[slot.page];
+            if (--page.num_regions == 0)
+            {
+                // Page is empty, its free slots are merged back into shelf space
+                page.shelves.clear();
+                page.top = 0;
+                size_t num_slots = 0;
+                for (size_t i = 0; i < free_slots_.size(); ++i)
+                {
+                    if (free_slots_[i].page != slot.page)
+                        free_slots_[num_slots++] = free_slots_[i];
+                }
+                free_slots_.resize(num_slots);
+            }
+            else
+                free_slots_.push_back(slot);
+            return true;
+        }
+        void TextureAtlas::Upload(const Slot& slot, int width, int height, const unsigned char * data)
+        {
+            const int padded_width = width + 2 * kPadding;
+            const int padded_height = height + 2 * kPadding;
+            upload_buffer_.resize(padded_width * padded_height * 4);
+            for (int y = 0; y < padded_height; ++y)
+            {
+                const int src_y = std::min(std::max(y - kPadding, 0), height - 1);
+                const unsigned char * src = data + src_y * width * 4;
+                unsigned char * dst = &upload_buffer_[y * padded_width * 4];
+                for (int x = 0; x < kPadding; ++x)
+                    memcpy(dst + x * 4, src, 4);
+                memcpy(dst + kPadding * 4, src, width * 4);
+                for (int x = kPadding + width; x < padded_width; ++x)
+                    memcpy(dst + x * 4, src + (width - 1) * 4, 4);
+            }
+            pages_[slot.page].texture->SetData(slot.x, slot.y, padded_width, padded_height, &upload_buffer_[0]);
+        }
+        void TextureAtlas::GetRegion(const Region& found, TextureRegion& region) const
+        {
+            const float scale = 1.0f / static_cast<float>(page_size_);
+            region.texture = pages_[found.slot.page].texture;
+            region.u0 = static_cast<float>(found.slot.x + kPadding) * scale;
+            region.v0 = static_cast<float>(found.slot.y + kPadding) * scale;
+            region.u1 = static_cast<float>(found.slot.x + kPadding + found.width) * scale;
+            region.v1 = static_cast<float>(found.slot.y + kPadding + found.height) * scale;
+        }
+
+    } // namespace terrain
+} // namespace mgn
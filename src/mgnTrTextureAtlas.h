@@ -0,0 +1,103 @@
+#pragma once
+#ifndef __MGN_TERRAIN_TEXTURE_ATLAS_H__
+#define __MGN_TERRAIN_TEXTURE_ATLAS_H__
+
+#include <boost/cstdint.hpp>
+#include <boost/unordered_map.hpp>
+
+#include <list>
+#include <vector>
+
+namespace mgn {
+    namespace graphics {
+        class Renderer;
+        class Texture;
+    }
+
+    namespace terrain {
+
+        //! Part of texture used by billboard, texture coordinates are in 0..1 range
+        struct TextureRegion {
+            TextureRegion();
+
+            //! Maps texture coordinates of the whole bitmap into the region
+            void Map(float& u, float& v) const;
+
+            graphics::Texture * texture;
+            float u0, v0; //!< upper left corner
+            float u1, v1; //!< lower right corner
+        };
+
+        /*! Texture atlas class.
+        ** Packs small RGBA bitmaps (icons, shields) into shared pages with shelf allocator.
+        ** Bitmaps are referenced by billboards using them, unreferenced ones stay in atlas
+        ** until space is needed and then are evicted, least recently used first.
+        ** Number of pages is limited, so memory used by bitmaps is capped.
+        */
+        class TextureAtlas {
+        public:
+            typedef boost::uint64_t Key; //!< bitmap hash
+
+            TextureAtlas(graphics::Renderer * renderer, int page_size, int max_pages);
+            ~TextureAtlas();
+
+            //! Finds bitmap and references it, returns false if bitmap isn't in atlas
+            bool Acquire(Key key, TextureRegion& region);
+            //! Packs bitmap into atlas and references it, returns false if there is no space left
+            bool Insert(Key key, int width, int height, const unsigned char * data, TextureRegion& region);
+            //! Drops reference obtained by Acquire or Insert
+            void Release(Key key);
+
+            //! Deletes all pages, no bitmap should be referenced
+            void Clear();
+
+            int num_pages() const;
+
+        private:
+            struct Slot {
+                int page;
+                int x, y;           //!< position in page including padding
+                int width, height;  //!< size including padding
+            };
+            struct Shelf {
+                int y;
+                int height;
+                int x;              //!< free space starts here
+            };
+            struct Page {
+                graphics::Texture * texture;
+                std::vector<Shelf> shelves;
+                int top;            //!< free space under shelves starts here
+                int num_regions;
+            };
+            struct Region {
+                Slot slot;
+                int width, height;  //!< size of bitmap
+                int ref_count;
+                std::list<Key>::iterator unused_it; //!< valid if region isn't referenced
+            };
+            typedef boost::unordered_map<Key, Region> RegionMap;
+
+            bool Allocate(int width, int height, Slot& slot);
+            bool AllocateFree(int width, int height, Slot& slot);
+            bool AllocateShelf(int page_index, int width, int height, Slot& slot);
+            bool AddPage();
+            //! Evicts the least recently used region, returns false if every region is referenced
+            bool EvictRegion();
+            void Upload(const Slot& slot, int width, int height, const unsigned char * data);
+            void GetRegion(const Region& found, TextureRegion& region) const;
+
+            graphics::Renderer * renderer_;
+            const int page_size_;
+            const int max_pages_;
+            std::vector<Page> pages_;
+            std::vector<Slot> free_slots_;  //!< slots of evicted regions
+            RegionMap regions_;
+            std::list<Key> unused_;         //!< unreferenced regions, least recently used first
+            std::vector<unsigned char> upload_buffer_;
+        };
+
+    } // namespace terrain
+} // namespace mgn
+
+#endif
@@ -9,7 +9,7 @@ namespace mgn {
         {
             while (!mTiles.empty())
             {
-                std::map<mgnTileKey, TerrainTile*>::iterator it = mTiles.begin();
+                TileMap::iterator it = mTiles.begin();
                 delete it->second;
                 mTiles.erase(it);
             }
@@ -17,7 +17,7 @@ namespace mgn {
 
         TerrainTile * TileCache::getTile(const mgnTileKey &key)
         {
-            std::map<mgnTileKey, TerrainTile*>::iterator tile_it = mTiles.find(key);
+            TileMap::iterator tile_it = mTiles.find(key);
             if (tile_it != mTiles.end())
                 return tile_it->second;
             else
@@ -42,11 +42,11 @@ namespace mgn {
             if (mTiles.size() <= mCapacity*1.2)
                 return;
 
-            static std::vector<std::pair<int, mgnTileKey> > keys;
+            static std::vector<std::pair<int, PackedTileKey> > keys;
             keys.clear();
             // fill array "keys"
             {
-                std::map<mgnTileKey, TerrainTile*>::iterator it;
+                TileMap::iterator it;
                 for (it = mTiles.begin(); it != mTiles.end(); ++it)
                 {
                     TerrainTile *tile = it->second;
@@ -59,15 +59,15 @@ namespace mgn {
 
             // remove array tail
             {
-                std::vector<std::pair<int, mgnTileKey> >::iterator it;
+                std::vector<std::pair<int, PackedTileKey> >::iterator it;
                 for (it = keys.begin() + mCapacity; it != keys.end(); ++it)
                 {
                     if (it->first == 1 || it->first==0)
                     {
                         continue;
                     }
-                    mgnTileKey key = it->second;
-                    std::map<mgnTileKey, TerrainTile*>::iterator tile_it = mTiles.find(key);
+                    PackedTileKey key = it->second;
+                    TileMap::iterator tile_it = mTiles.find(key);
                     if(fetcher->removeTile(tile_it->second))
                     {
                         delete tile_it->second;
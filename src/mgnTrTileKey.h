@@ -1,6 +1,8 @@
 #pragma once
 
-#include <map>
+#include "mgnTrPackedTileKey.h"
+
+#include <boost/unordered_map.hpp>
 
 namespace mgn {
     namespace terrain {
@@ -8,8 +10,11 @@ namespace mgn {
         struct mgnTileKey
         {
             mgnTileKey (unsigned short magIndex_, int x_, int y_) : magIndex(magIndex_), x(x_), y(y_) {}
+            explicit mgnTileKey (const PackedTileKey& key) : magIndex(static_cast<unsigned short>(key.level())), x(key.x()), y(key.y()) {}
             unsigned short magIndex;
             int x, y;
+
+            operator PackedTileKey() const { return PackedTileKey(magIndex, x, y); }
         };
 
         inline bool operator<(const mgnTileKey& a, const mgnTileKey &b)
@@ -22,7 +27,7 @@ namespace mgn {
         }
 
         class TerrainTile;
-        typedef std::map<mgnTileKey, TerrainTile*> TileMap;
+        typedef boost::unordered_map<PackedTileKey, TerrainTile*> TileMap;
 
     } // namespace terrain
-} // namespace mgn
\ No newline at end of file
+} // namespace mgn
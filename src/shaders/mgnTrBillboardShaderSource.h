@@ -42,6 +42,13 @@ precision highp float;
                                                                                                            \r\n\
 uniform sampler2D u_texture;                                                                               \r\n\
                                                                                                            \r\n\
+// Distance field font parameters, texture alpha holds distance to glyph edge                              \r\n\
+uniform bool u_distance_field;                                                                             \r\n\
+uniform vec4 u_text_color;                                                                                 \r\n\
+uniform vec4 u_outline_color;                                                                              \r\n\
+uniform float u_outline_width;                                                                             \r\n\
+uniform float u_edge_smoothing;                                                                            \r\n\
+                                                                                                           \r\n\
 // Fog parameters                                                                                          \r\n\
 uniform float u_fog_modifier;                                                                              \r\n\
 uniform float u_z_far;                                                                                     \r\n\
@@ -64,6 +71,15 @@ varying vec3 v_view_position;
 void main()                                                                                                \r\n\
 {                                                                                                          \r\n\
     vec4 color = texture2D(u_texture, v_texcoord);                                                         \r\n\
+    if (u_distance_field)                                                                                  \r\n\
+    {                                                                                                      \r\n\
+        float dist = color.a;                                                                              \r\n\
+        float text_alpha = smoothstep(0.5 - u_edge_smoothing, 0.5 + u_edge_smoothing, dist);               \r\n\
+        float outline_edge = 0.5 - u_outline_width;                                                        \r\n\
+        float outline_alpha = smoothstep(outline_edge - u_edge_smoothing, outline_edge + u_edge_smoothing, dist);\r\n\
+        color = mix(u_outline_color, u_text_color, text_alpha);                                            \r\n\
+        color.a *= outline_alpha;                                                                          \r\n\
+    }                                                                                                      \r\n\
     float view_length = length(v_view_position);                                                           \r\n\
     float fog_distance = view_length / u_z_far;                                                            \r\n\
     const float kFogBegin = 0.6;                                                                           \r\n\